@@ -1,480 +1,263 @@
+// AVX2 tile rasterization kernels (8 pixels per step);
+// must be included after SoftTileRenderer.h
 #include "SoftMath.h"
 
-static inline
-void RasterizeTriangle_AVX(
-						   const XVertex& v1, const XVertex& v2, const XVertex& v3,
-						   const SoftRenderContext& context
-						   )
-{
-	mxPROFILE_SCOPE("Rasterize Triangle");
-
-
-	const int W = context.W;	// viewport width
-	//const int H = context.H;	// viewport height
-
-
-	const F4 fX1 = v1.P.x;
-	const F4 fX2 = v2.P.x;
-	const F4 fX3 = v3.P.x;
-
-	const F4 fY1 = v1.P.y;
-	const F4 fY2 = v2.P.y;
-	const F4 fY3 = v3.P.y;
-
-	const F4 fZ1 = v1.P.z;
-	const F4 fZ2 = v2.P.z;
-	const F4 fZ3 = v3.P.z;
-
-	// NOTE: these are actually inverses of W (because of perspective division 1/w in ProjectVertex(), after vertex shader).
-	const F4 fInvW1 = v1.P.w;
-	const F4 fInvW2 = v2.P.w;
-	const F4 fInvW3 = v3.P.w;
-
-	/* excerpt from "A Parallel Algorithm for Polygon Rasterization" by Juan Pineda
-	(Computer Graphics, Volume 22, Number 4, August 1988).
-
-	Typically in  3D graphics rendering, polygon vertices are in floating
-	point  format  after  3D  transformation  and  projection.  Some
-	implementations  round  the  X  and  Y floating  point  ordinates to
-	integer  values, so that  simple  integer  line  algorithms can be used
-	compute the  triangle  edges.  This rounding can leave  gaps on the
-	order of 1/2 pixel wide between adjacent polygons that do not share
-	common vertices.  Gaps also occur as a result of the  finite precision
-	used in specifying the endpoints, but these gaps are much narrower. 
-	Some implementations attempt to eUminate these gaps by growing the 
-	edges of triangles to insure  overlap, but these  solutions cause other
-	artifacts. 
-	In order to minimize these artifacts, it is desirable to render triangle 
-	edges as close as possible to the real line between two vertices.  This
-	is  conveniently  done  with  this  algorithm  by  performing  the 
-	interpolator  setup computations in floating point, and converting to 
-	fixed point at the end: 
-	*/
-	// 28.4 fixed-point coordinates
-	// (12 bit resolution, enough for a 4096x4096 color buffer)
-	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
-	// 
-	const INT32 X1 = iround( 16.0f * fX1 );
-	const INT32 X2 = iround( 16.0f * fX2 );
-	const INT32 X3 = iround( 16.0f * fX3 );
-
-	const INT32 Y1 = iround( 16.0f * fY1 );
-	const INT32 Y2 = iround( 16.0f * fY2 );
-	const INT32 Y3 = iround( 16.0f * fY3 );
-
-	//const INT32 Z1 = iround( 16.0f * fZ1 );
-	//const INT32 Z2 = iround( 16.0f * fZ2 );
-	//const INT32 Z3 = iround( 16.0f * fZ3 );
-
-	//const INT32 W1 = iround( 16.0f * fInvW1 );
-	//const INT32 W2 = iround( 16.0f * fInvW2 );
-	//const INT32 W3 = iround( 16.0f * fInvW3 );
-	// 
-	// deltas
-	const INT32 DeltaX12 = X1 - X2;
-	const INT32 DeltaX23 = X2 - X3;
-	const INT32 DeltaX31 = X3 - X1;
-
-	const INT32 DeltaY12 = Y1 - Y2;
-	const INT32 DeltaY23 = Y2 - Y3;
-	const INT32 DeltaY31 = Y3 - Y1;
-
-
-	//// back-face culling
-
-	//// calculate signed area of triangle in screen space
-	//// this is actually twice the area
-	//const int nArea = DeltaX12 * DeltaY31 - DeltaY12 * DeltaX31;
-	//(void)nArea;
-
-	//if( CULL_MODE == Cull_CW && nArea <= 0 )
-	//{
-	//	return;
-	//}
-	//else if( CULL_MODE == Cull_CCW && nArea >= 0 )
-	//{
-	//	return;
-	//}
-
-
-	// 24.8 Fixed-point deltas
-	const INT32 FDX12 = DeltaX12 << 4;
-	const INT32 FDX23 = DeltaX23 << 4;
-	const INT32 FDX31 = DeltaX31 << 4;
-
-	const INT32 FDY12 = DeltaY12 << 4;
-	const INT32 FDY23 = DeltaY23 << 4;
-	const INT32 FDY31 = DeltaY31 << 4;
+#if SOFT_RENDER_USE_AVX
 
+namespace SoftRenderer
+{
 
+mxSTATIC_ASSERT( TILE_SIZE_X % AVX_REG_WIDTH == 0 );
 
+template< EDepthFormat FORMAT >
+static inline
+void RasterizeFullyCoveredTile_AVX2( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
 
+	const int W = context.W;	// viewport width
 
-	// Compute interpolation data
-	//const F4 fDeltaX12 = fX1 - fX2;
-	//const F4 fDeltaX23 = fX2 - fX3;
-	const F4 fDeltaX31 = fX3 - fX1;
+	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
+	typename DEPTH::Elem *	depthBufferStart = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
 
-	//const F4 fDeltaY12 = fY1 - fY2;
-	//const F4 fDeltaY23 = fY2 - fY3;
-	const F4 fDeltaY31 = fY3 - fY1;
+	// interpolants at the first row of 8 pixels and their increments along X and Y
+	srPlanes_AVX	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, AVX_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
 
-	const F4 fDeltaZ21 = fZ2 - fZ1;
-	const F4 fDeltaZ31 = fZ3 - fZ1;
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		srPlanes_AVX	planes = planesRow;
 
-	// NOTE: these are actually inverses of W (because of perspective division 1/w in ProjectVertex(), after vertex shader).
-	const F4 fDeltaInvW21 = fInvW2 - fInvW1;
-	const F4 fDeltaInvW31 = fInvW3 - fInvW1;
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += AVX_REG_WIDTH )
+		{
+			typename DEPTH::Elem* depth = (depthBufferStart + iX);
 
-	const F4 fDeltaX21 = fX2 - fX1;
-	const F4 fDeltaY21 = fY2 - fY1;
+			//#######[LOAD] load previous depth
+			const __m256 qfOldDepth = DEPTH::Load_AVX2( depth );
+			const __m256 qfNewDepth = DEPTH::Encode_AVX2( planes.z );
 
-	const F4 INTERP_C = fDeltaX21 * fDeltaY31 - fDeltaX31 * fDeltaY21;
+			// perform depth testing
+			const __m256 qfDepthMask = DEPTH::LessEqual_AVX2( qfNewDepth, qfOldDepth );
+			const UINT mask = _mm256_movemask_ps( qfDepthMask );
 
+			// skip these 8 pixels if they are occluded
+			if( mask )
+			{
+				//$$$@@@[STORE] write depth to framebuffer
+				DEPTH::Store_AVX2( depth, _mm256_blendv_ps( qfOldDepth, qfNewDepth, qfDepthMask ) );
 
-	// compute gradient for interpolating depth (aka Z)
+				// shade pixels which passed the depth test
+				ShadeTileRow_AVX2( planes, mask, colorBufferStart + iX, context );
+			}
 
-	mxSIMDALIGNED Vec2D	vZ;
+			planes.Add( stepX );
 
-	ComputeGradient_FPU(
-		INTERP_C,
-		fDeltaZ21, fDeltaZ31,
-		fDeltaX21, fDeltaX31,
-		fDeltaY21, fDeltaY31,
-		vZ.x, vZ.y
-		);
+		}//for x
 
-	// to calculate perspective correct u:
-	// 1. For every vertex: calculate u' = u / w and w' = 1 / w (which can be linearly interpolated in screen space)
-	// 2. For every pixel: linearly interpolate u' _and_ w' and calculate perspective correct u ( interpolated u' / interpolated w' ).
-	// When dividing a value through the w component it can be properly interpolated in image space.
-	// We can then recover the w component at any position we want through inversion.
-	// This is also why the pseudodepth for depth-testing is not affected by the aforementioned problem. It has already been divided by w during homogenization.
+		planesRow.Add( stepY );
 
-	// Setup inverse W (for interpolating W)
+		colorBufferStart += W;
+		depthBufferStart += W;
+	}//for y
 
-	mxSIMDALIGNED Vec2D	vInvW;
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
 
-	ComputeGradient_FPU(
-		INTERP_C,
-		fDeltaInvW21, fDeltaInvW31,
-		fDeltaX21, fDeltaX31,
-		fDeltaY21, fDeltaY31,
-		vInvW.x, vInvW.y
-		);
+// see ShadeFullyCoveredTile_FPU(), 8 pixels at a time (also used in AVX-512 mode)
+static inline
+void ShadeFullyCoveredTile_AVX2( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	const int W = context.W;	// viewport width
 
+	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
 
-	// Cache perspective correct varyings for the first vertex (for interpolation)
-	FLOAT	vars1[ NUM_VARYINGS ];
+	srPlanes_AVX	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, AVX_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
 
-	for( UINT i = 0; i < NUM_VARYINGS; i++ )
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
 	{
-		vars1[i] = v1.vars[i] * fInvW1;
-	}
-
+		srPlanes_AVX	planes = planesRow;
 
-	// varyings multiplied by inverse W (they can be linearly interpolated in screen space)
-	mxSIMDALIGNED Vec2D	varsOverW[ NUM_VARYINGS ];
-
-	// setup varyings for interpolation
-	for( UINT i = 0; i < NUM_VARYINGS; i++ )
-	{
-		const F4 v1v = v1.vars[i] * fInvW1;
-		const F4 v2v = v2.vars[i] * fInvW2;
-		const F4 v3v = v3.vars[i] * fInvW3;
-
-		ComputeGradient_FPU(
-			INTERP_C,
-			v2v - v1v, v3v - v1v,
-			fDeltaX21, fDeltaX31,
-			fDeltaY21, fDeltaY31,
-			varsOverW[i].x, varsOverW[i].y
-			);
-	}
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += AVX_REG_WIDTH )
+		{
+			ShadeTileRow_AVX2( planes, 0xFF, colorBufferStart + iX, context );
 
-	// Block size, standard 8x8 (must be power of two)
-	// NOTE: should be 8, must be small enough so that accumulative errors don't grow too much
-	//enum { BLOCK_SIZE = 8 };	//enum { BLOCK_SIZE_LOG2 = 3 };
-	//enum { BLOCK_SIZE = 16 };
-	//enum { BLOCK_SIZE = 32 };
-	//enum { BLOCK_SIZE = 4 };
-	//enum { BLOCK_SIZE = 2 };
-	// 
+			planes.Add( stepX );
+		}//for x
 
-	enum { BLOCK_SIZE_X = 8 };
-	enum { BLOCK_SIZE_Y = 4 };
+		planesRow.Add( stepY );
 
+		colorBufferStart += W;
+	}//for y
 
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
 
-	// "A Parallel Algorithm for Polygon Rasterization":
-	// Since the edge function is linear,  it is possible to compute the value 
-	// of the  edge function for a pixel an arbitrary distance L away from a 
-	// given point (x,y) :
+// rasterizes the pixels of the rectangle [iStartX, iEndX) x [iStartY, iEndY) inside the triangle
+template< EDepthFormat FORMAT >
+static FORCEINLINE
+void RasterizeTriangleRect_AVX2( const XTriangle& face, UINT iStartX, UINT iStartY, UINT iEndX, UINT iEndY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
 
-	// Half-edge constants in 28.4
-	INT32 C1 = DeltaY12 * X1 - DeltaX12 * Y1;
-	INT32 C2 = DeltaY23 * X2 - DeltaX23 * Y2;
-	INT32 C3 = DeltaY31 * X3 - DeltaX31 * Y3;
+	const int W = context.W;	// viewport width
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
 
-	// correct for top-left fill convention
-	if( DeltaY12 < 0 || (DeltaY12 == 0 && DeltaX12 > 0) ) {
-		++C1;
-	}
-	if( DeltaY23 < 0 || (DeltaY23 == 0 && DeltaX23 > 0) ) {
-		++C2;
-	}
-	if( DeltaY31 < 0 || (DeltaY31 == 0 && DeltaX31 > 0) ) {
-		++C3;
-	}
+	// 28.4 fixed-point
+	const INT32 X1 = face.FPX[0];
+	const INT32 X2 = face.FPX[1];
+	const INT32 X3 = face.FPX[2];
 
+	const INT32 Y1 = face.FPY[0];
+	const INT32 Y2 = face.FPY[1];
+	const INT32 Y3 = face.FPY[2];
 
-	// Bounding rectangle of this triangle in screen space
+	// deltas
+	const INT32 DeltaX12 = X1 - X2;
+	const INT32 DeltaX23 = X2 - X3;
+	const INT32 DeltaX31 = X3 - X1;
 
-	// Adding 0xF and shifting right 4 bits is the equivalent of a ceil() function for the 28.4 fixed-point format.
-	// The first pixel to be filled is the one strictly to the right of the first edge,
-	// so that's why a ceil() operation is used (the fill convention for colorBuffer spot on the edge is taken care of a few lines lower).
+	const INT32 DeltaY12 = Y1 - Y2;
+	const INT32 DeltaY23 = Y2 - Y3;
+	const INT32 DeltaY31 = Y3 - Y1;
 
-#if 0
-	INT32 nMinX = Clamp( (Min3(X1, X2, X3) + 0xF) >> 4, 0, W );
-	INT32 nMaxX = Clamp( (Max3(X1, X2, X3) + 0xF) >> 4, 0, W );
-	INT32 nMinY = Clamp( (Min3(Y1, Y2, Y3) + 0xF) >> 4, 0, H );
-	INT32 nMaxY = Clamp( (Max3(Y1, Y2, Y3) + 0xF) >> 4, 0, H );
-#else
-	INT32 nMinX = (Min3(X1, X2, X3) + 0xF) >> 4;
-	INT32 nMaxX = (Max3(X1, X2, X3) + 0xF) >> 4;
-	INT32 nMinY = (Min3(Y1, Y2, Y3) + 0xF) >> 4;
-	INT32 nMaxY = (Max3(Y1, Y2, Y3) + 0xF) >> 4;
-#endif
+	// 24.8 Fixed-point deltas
+	const INT32 FDX12 = DeltaX12 << FP_SHIFT;
+	const INT32 FDX23 = DeltaX23 << FP_SHIFT;
+	const INT32 FDX31 = DeltaX31 << FP_SHIFT;
 
+	const INT32 FDY12 = DeltaY12 << FP_SHIFT;
+	const INT32 FDY23 = DeltaY23 << FP_SHIFT;
+	const INT32 FDY31 = DeltaY31 << FP_SHIFT;
 
-	//const INT32 iArea = (imaxx - iminx) * (imaxy - iminy);
-	//if( iArea == 0 ) {
-	//	return;
-	//}
+	SoftPixel* pixels = context.colorBuffer + iStartY * W;	// color buffer
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, iStartY );	// depth buffer
 
+	// top-left corner of the rectangle in 28.4 fixed-point
+	const UINT FStartX = (iStartX << FP_SHIFT);
+	const UINT FStartY = (iStartY << FP_SHIFT);
 
-	// Start in corner of 8x8 block
-	nMinX &= ~(BLOCK_SIZE_X - 1);
-	nMinY &= ~(BLOCK_SIZE_Y - 1);
+	// in 28.4
+	INT32 CY1 = face.C1 + DeltaX12 * FStartY - DeltaY12 * FStartX;
+	INT32 CY2 = face.C2 + DeltaX23 * FStartY - DeltaY23 * FStartX;
+	INT32 CY3 = face.C3 + DeltaX31 * FStartY - DeltaY31 * FStartX;
 
+	const __m256i qi76543210 = _mm256_set_epi32( 7, 6, 5, 4, 3, 2, 1, 0 );
 
+	const __m256i qiOffsetDY12 = _mm256_mullo_epi32( _mm256_set1_epi32( FDY12 ), qi76543210 );
+	const __m256i qiOffsetDY23 = _mm256_mullo_epi32( _mm256_set1_epi32( FDY23 ), qi76543210 );
+	const __m256i qiOffsetDY31 = _mm256_mullo_epi32( _mm256_set1_epi32( FDY31 ), qi76543210 );
 
-	//const UINT stride = W * sizeof SoftPixel;	// aka 'pitch'
-	SoftPixel* startPixels = context.colorBuffer + nMinY * W;	// color buffer
-	ZBufElem* startZBuffer = context.depthBuffer + nMinY * W;	// depth buffer
+	const __m256i qiFDY12_8 = _mm256_set1_epi32( FDY12 * AVX_REG_WIDTH );
+	const __m256i qiFDY23_8 = _mm256_set1_epi32( FDY23 * AVX_REG_WIDTH );
+	const __m256i qiFDY31_8 = _mm256_set1_epi32( FDY31 * AVX_REG_WIDTH );
 
+	const __m256i qiZero = _mm256_setzero_si256();
 
+	// interpolants at the first row of 8 pixels and their increments along X and Y
+	srPlanes_AVX	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iStartX, iStartY );
+	stepX.SetStep( face, AVX_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
 
-	SPixelShaderParameters	pixelShaderArgs;
-	pixelShaderArgs.globals = context.globals;
+	for( UINT iY = iStartY; iY < iEndY; iY++ )
+	{
+		__m256i qiCX1 = _mm256_sub_epi32( _mm256_set1_epi32( CY1 ), qiOffsetDY12 );
+		__m256i qiCX2 = _mm256_sub_epi32( _mm256_set1_epi32( CY2 ), qiOffsetDY23 );
+		__m256i qiCX3 = _mm256_sub_epi32( _mm256_set1_epi32( CY3 ), qiOffsetDY31 );
 
+		srPlanes_AVX	planes = planesRow;
 
-	for( UINT iBlockY = nMinY; iBlockY < nMaxY; iBlockY += BLOCK_SIZE_Y )
-	{
-		for( UINT iBlockX = nMinX; iBlockX < nMaxX; iBlockX += BLOCK_SIZE_X )
+		for( UINT iX = iStartX; iX < iEndX; iX += AVX_REG_WIDTH )
 		{
-			// Corners of block in 28.4 fixed-point (4 bits of sub-pixel accuracy)
-			const UINT FBlockX0 = (iBlockX << 4);
-			const UINT FBlockX1 = (iBlockX + (BLOCK_SIZE_X - 1)) << 4;
-			const UINT FBlockY0 = (iBlockY << 4);
-			const UINT FBlockY1 = (iBlockY + (BLOCK_SIZE_Y - 1)) << 4;
-
-			// Evaluate half-space functions in the 4 corners of the block
-
-			//OPTIMIZED: extract sign bit instead of converting to bool
-		#if 0
-			const bool a00 = (C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0) < 0;
-			const bool a10 = (C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX1) < 0;
-			const bool a01 = (C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX0) < 0;
-			const bool a11 = (C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX1) < 0;
-			const UINT a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);	// compose mask for all four corners
-
-			const bool b00 = (C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0) < 0;
-			const bool b10 = (C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX1) < 0;
-			const bool b01 = (C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX0) < 0;
-			const bool b11 = (C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX1) < 0;
-			const UINT b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);	// compose mask for all four corners
-
-			const bool c00 = (C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0) < 0;
-			const bool c10 = (C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX1) < 0;
-			const bool c01 = (C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX0) < 0;
-			const bool c11 = (C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX1) < 0;
-			const UINT c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);	// compose mask for all four corners
-		#else
-			const UINT a00 = INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0 );
-			const UINT a10 = INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX1 );
-			const UINT a01 = INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX0 );
-			const UINT a11 = INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX1 );
-			const UINT a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);	// compose 4-bit mask for all four corners
-
-			const UINT b00 = INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0 );
-			const UINT b10 = INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX1 );
-			const UINT b01 = INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX0 );
-			const UINT b11 = INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX1 );
-			const UINT b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);	// compose 4-bit mask for all four corners
-
-			const UINT c00 = INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0 );
-			const UINT c10 = INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX1 );
-			const UINT c01 = INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX0 );
-			const UINT c11 = INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX1 );
-			const UINT c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);	// compose 4-bit mask for all four corners
-		#endif
-
-
-			// Skip block when outside an edge => outside the triangle
-
-			//OPTIMIZED: replaced logical 'or' (3 jmps) with bitwise ops and one comparison
-		#if 0
-			if( a == 0 || b == 0 || c == 0 ) {
-				continue;
-			}
-		#else
-			const UINT mask = ((~0U << 24) | (a << 16) | (b << 8) | (c));
+			const __m256i qiEdgeMask = _mm256_and_si256(
+				_mm256_cmpgt_epi32( qiCX1, qiZero ),
+				_mm256_and_si256( _mm256_cmpgt_epi32( qiCX2, qiZero ), _mm256_cmpgt_epi32( qiCX3, qiZero ) )
+			);
 
-			#define has_nullbyte_(x) ((x - 0x01010101) & ~x & 0x80808080)
-			if( has_nullbyte_( mask ) )
+			// skip these 8 pixels if they are outside the triangle
+			if( !_mm256_testz_si256( qiEdgeMask, qiEdgeMask ) )
 			{
-				continue;
-			}
-		#endif
-
-
-			SoftPixel* pixels = startPixels;
-			ZBufElem* zbuffer = startZBuffer;
-
+				typename DEPTH::Elem* depth = (zbuffer + iX);
 
+				//#######[LOAD] load previous depth
+				const __m256 qfOldDepth = DEPTH::Load_AVX2( depth );
+				const __m256 qfNewDepth = DEPTH::Encode_AVX2( planes.z );
 
+				// perform depth testing of covered pixels
+				const __m256 qfDepthMask = DEPTH::LessEqual_AVX2( qfNewDepth, qfOldDepth );
+				const __m256 qfColorMask = _mm256_and_ps( qfDepthMask, _mm256_castsi256_ps( qiEdgeMask ) );
+				const UINT mask = _mm256_movemask_ps( qfColorMask );
 
-
-			// Accept whole block when totally covered (all four corners are inside triangle and their coverage masks are (1|2|4|8) = 15)
-
-			//OPTIMIZED: replaced 'and' with sum
-		#if 0
-			if( a == 0xF && b == 0xF && c == 0xF )
-		#elif 0
-			if( a + b + c == (0xF + 0xF + 0xF) )
-		#else
-			if( mask == 0xFF0F0F0F )
-		#endif
-			{
-				for( UINT iY = iBlockY; iY < iBlockY + BLOCK_SIZE_Y; iY++ )
-				{
-					for( UINT iX = iBlockX; iX < iBlockX + BLOCK_SIZE_X; iX++ )
-					{
-						const F4 fStartDX = (F4)iX - fX1;	//<= conversion int => float is slow!
-						const F4 fStartDY = (F4)iY - fY1;	//<= conversion int => float is slow!
-
-						// interpolate depth
-						const F4 Z = fZ1 + vZ.x * fStartDX + vZ.y * fStartDY;
-
-						const ZBufElem thisDepth = FloatDepthToZBufferValue( Z );
-						const ZBufElem prevDepth = zbuffer[ iX ];
-						if( thisDepth < prevDepth )
-						{
-							// depth test passed
-							zbuffer[ iX ] = thisDepth;
-
-							// compute inverse W
-							const F4 invW = fInvW1 + vInvW.x * fStartDX + vInvW.y * fStartDY;
-							// calculate perspectively-correct varyings
-							for( UINT i = 0; i < NUM_VARYINGS; i++ )
-							{
-								const F4 varOverW = vars1[i] + varsOverW[i].x * fStartDX + varsOverW[i].y * fStartDY;
-								pixelShaderArgs.vars[i] = varOverW / invW; // <= perspective correction via division
-							}
-							pixelShaderArgs.depth = Z;
-							pixelShaderArgs.pixel = pixels + iX;
-
-							// execute pixel shader
-							(*context.pixelShader)( pixelShaderArgs );
-						}//if depth test passed
-
-					}//for x
-
-					pixels += W;
-					zbuffer += W;
-				}//for y
-
-				SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, FBlockX0 >> 4, FBlockY0 >> 4, BLOCK_SIZE_X, BLOCK_SIZE_Y );
-
-				// (end of fully covered block)
-			}
-			else // Partially covered block
-			{
-				//Assert(!( a == 0xF && b == 0xF && c == 0xF ));
-
-				// in 28.4
-				INT32 CY1 = C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0;
-				INT32 CY2 = C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0;
-				INT32 CY3 = C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0;
-
-				for( UINT iY = iBlockY; iY < iBlockY + BLOCK_SIZE_X; iY++ )
+				// skip these 8 pixels if they are occluded
+				if( mask )
 				{
-					INT32 CX1 = CY1;
-					INT32 CX2 = CY2;
-					INT32 CX3 = CY3;
-
-					for( UINT iX = iBlockX; iX < iBlockX + BLOCK_SIZE_X; iX++ )
-					{
-						// no tiny dots and holes between polygons if we use less or equal
-						if( CX1 <= 0 && CX2 <= 0 && CX3 <= 0 )
-						//if( CX1 < 0 && CX2 < 0 && CX3 < 0 )
-						{
-							// inside triangle
-
-							const F4 fStartDX = (F4)iX - fX1;	//<= conversion int => float is slow!
-							const F4 fStartDY = (F4)iY - fY1;	//<= conversion int => float is slow!
+					//$$$@@@[STORE] write depth to framebuffer
+					DEPTH::Store_AVX2( depth, _mm256_blendv_ps( qfOldDepth, qfNewDepth, qfColorMask ) );
 
-							// interpolate depth
-							const F4 Z = fZ1 + vZ.x * fStartDX + vZ.y * fStartDY;
+					// shade covered pixels which passed the depth test
+					ShadeTileRow_AVX2( planes, mask, pixels + iX, context );
+				}
+			}
 
-							const ZBufElem thisDepth = FloatDepthToZBufferValue( Z );
-							const ZBufElem prevDepth = zbuffer[ iX ];
-							if( thisDepth < prevDepth )
-							{
-								// depth test passed
-								zbuffer[ iX ] = thisDepth;
+			qiCX1 = _mm256_sub_epi32( qiCX1, qiFDY12_8 );
+			qiCX2 = _mm256_sub_epi32( qiCX2, qiFDY23_8 );
+			qiCX3 = _mm256_sub_epi32( qiCX3, qiFDY31_8 );
 
-								// compute inverse W
-								const F4 invW = fInvW1 + vInvW.x * fStartDX + vInvW.y * fStartDY;
-								// calculate perspectively-correct varyings
-								for( UINT i = 0; i < NUM_VARYINGS; i++ )
-								{
-									const F4 varOverW = vars1[i] + varsOverW[i].x * fStartDX + varsOverW[i].y * fStartDY;
-									pixelShaderArgs.vars[i] = varOverW / invW; // <= perspective correction via division
-								}
-								pixelShaderArgs.depth = Z;
-								pixelShaderArgs.pixel = pixels + iX;
+			planes.Add( stepX );
 
-								// execute pixel shader
-								(*context.pixelShader)( pixelShaderArgs );
-							}
+		}//for x
 
-						}//if depth test passed
+		CY1 += FDX12;
+		CY2 += FDX23;
+		CY3 += FDX31;
 
-						CX1 -= FDY12;
-						CX2 -= FDY23;
-						CX3 -= FDY31;
+		planesRow.Add( stepY );
 
-					}//for x
+		pixels += W;
+		zbuffer += W;
+	}//for y
 
-					CY1 += FDX12;
-					CY2 += FDX23;
-					CY3 += FDX31;
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
 
-					pixels += W;
-					zbuffer += W;
-				}//for y
+template< EDepthFormat FORMAT >
+static inline
+void RasterizePartiallyCoveredTile_AVX2( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	RasterizeTriangleRect_AVX2< FORMAT >( face, iBlockX, iBlockY, iBlockX + TILE_SIZE_X, iBlockY + TILE_SIZE_Y, context );
+}
 
-				SoftRenderer::Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, FBlockX0 >> 4, FBlockY0 >> 4, BLOCK_SIZE_X, BLOCK_SIZE_Y );
+// rasterizes a small triangle (see IsSmallTriangle()) inside its bounding rectangle:
+// only the rows of 8 pixels which overlap the rectangle are visited
+template< EDepthFormat FORMAT >
+static inline
+void RasterizeSmallTriangle_AVX2( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
 
-			}//Partially covered block
+	// bounding rectangle in pixels (the tile contains it), starts at a multiple of 8 pixels
+	const INT32 FP_ROUND = (1 << FP_SHIFT) - 1;
+	const UINT nStartX = largest( (Min3(face.FPX[0], face.FPX[1], face.FPX[2]) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockX ) & ~(AVX_REG_WIDTH - 1);
+	const UINT nStartY = largest( (Min3(face.FPY[0], face.FPY[1], face.FPY[2]) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockY );
+	const UINT nEndX = face.maxX;
+	const UINT nEndY = face.maxY;
+	Assert( nEndX <= iBlockX + TILE_SIZE_X && nEndY <= iBlockY + TILE_SIZE_Y );
 
-		}//for each block on X axis
+	RasterizeTriangleRect_AVX2< FORMAT >( face, nStartX, nStartY, nEndX, nEndY, context );
+}
 
-		startPixels += W * BLOCK_SIZE_Y;
-		startZBuffer += W * BLOCK_SIZE_Y;
+}//namespace SoftRenderer
 
-	}//for each block on Y axis
-}
+#endif // SOFT_RENDER_USE_AVX
 
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
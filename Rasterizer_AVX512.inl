@@ -0,0 +1,221 @@
+// AVX-512 tile rasterization kernels (a whole 16-pixel tile row per step);
+// coverage and depth test results are kept in mask registers,
+// depth is merged into the framebuffer with masked stores;
+// must be included after SoftTileRenderer.h
+#include "SoftMath.h"
+
+#if SOFT_RENDER_USE_AVX512
+
+namespace SoftRenderer
+{
+
+enum { AVX512_REG_WIDTH = 16 };
+
+mxSTATIC_ASSERT( TILE_SIZE_X % AVX512_REG_WIDTH == 0 );
+
+// joins the interpolated values of two adjacent groups of 8 pixels
+static FORCEINLINE
+__m512 Combine_AVX512( __m256 lo, __m256 hi )
+{
+	return _mm512_castpd_ps( _mm512_insertf64x4( _mm512_castpd256_pd512( _mm256_castps_pd( lo ) ), _mm256_castps_pd( hi ), 1 ) );
+}
+
+template< EDepthFormat FORMAT >
+static inline
+void RasterizeFullyCoveredTile_AVX512( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
+
+	const int W = context.W;	// viewport width
+
+	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
+	typename DEPTH::Elem *	depthBufferStart = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
+
+	// interpolants at the first 8 pixels of the row and their increments along X and Y
+	srPlanes_AVX	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, AVX_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
+
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		srPlanes_AVX	lo = planesRow;
+
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += AVX512_REG_WIDTH )
+		{
+			srPlanes_AVX	hi = lo;
+			hi.Add( stepX );
+
+			typename DEPTH::Elem* depth = (depthBufferStart + iX);
+
+			//#######[LOAD] load previous depth
+			const __m512 qfOldDepth = DEPTH::Load_AVX512( 0xFFFF, depth );
+
+			// perform depth testing
+			const __m512 qfZ = DEPTH::Encode_AVX512( Combine_AVX512( lo.z, hi.z ) );
+			const __mmask16 kDepthMask = DEPTH::LessEqual_AVX512( 0xFFFF, qfZ, qfOldDepth );
+
+			// skip this row if it is occluded
+			if( kDepthMask )
+			{
+				//$$$@@@[STORE] write depth to framebuffer
+				DEPTH::Store_AVX512( depth, kDepthMask, qfZ );
+
+				// shade pixels which passed the depth test, eight pixels at a time
+				ShadeTileRow_AVX2( lo, kDepthMask & 0xFF, colorBufferStart + iX, context );
+				ShadeTileRow_AVX2( hi, kDepthMask >> AVX_REG_WIDTH, colorBufferStart + iX + AVX_REG_WIDTH, context );
+			}
+
+			lo = hi;
+			lo.Add( stepX );
+
+		}//for x
+
+		planesRow.Add( stepY );
+
+		colorBufferStart += W;
+		depthBufferStart += W;
+	}//for y
+
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
+
+template< EDepthFormat FORMAT >
+static inline
+void RasterizePartiallyCoveredTile_AVX512( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
+
+	const int W = context.W;	// viewport width
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	// 28.4 fixed-point
+	const INT32 X1 = face.FPX[0];
+	const INT32 X2 = face.FPX[1];
+	const INT32 X3 = face.FPX[2];
+
+	const INT32 Y1 = face.FPY[0];
+	const INT32 Y2 = face.FPY[1];
+	const INT32 Y3 = face.FPY[2];
+
+	// deltas
+	const INT32 DeltaX12 = X1 - X2;
+	const INT32 DeltaX23 = X2 - X3;
+	const INT32 DeltaX31 = X3 - X1;
+
+	const INT32 DeltaY12 = Y1 - Y2;
+	const INT32 DeltaY23 = Y2 - Y3;
+	const INT32 DeltaY31 = Y3 - Y1;
+
+	// 24.8 Fixed-point deltas
+	const INT32 FDX12 = DeltaX12 << FP_SHIFT;
+	const INT32 FDX23 = DeltaX23 << FP_SHIFT;
+	const INT32 FDX31 = DeltaX31 << FP_SHIFT;
+
+	const INT32 FDY12 = DeltaY12 << FP_SHIFT;
+	const INT32 FDY23 = DeltaY23 << FP_SHIFT;
+	const INT32 FDY31 = DeltaY31 << FP_SHIFT;
+
+	SoftPixel* pixels = context.colorBuffer + iBlockY * W;	// color buffer
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
+
+	// Corners of block in 28.4 fixed-point (4 bits of sub-pixel accuracy)
+	const UINT FBlockX0 = (iBlockX << FP_SHIFT);
+	const UINT FBlockY0 = (iBlockY << FP_SHIFT);
+
+	// in 28.4
+	INT32 CY1 = face.C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0;
+	INT32 CY2 = face.C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0;
+	INT32 CY3 = face.C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0;
+
+	const __m512i qiOffsetX = _mm512_set_epi32( 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 );
+
+	const __m512i qiOffsetDY12 = _mm512_mullo_epi32( _mm512_set1_epi32( FDY12 ), qiOffsetX );
+	const __m512i qiOffsetDY23 = _mm512_mullo_epi32( _mm512_set1_epi32( FDY23 ), qiOffsetX );
+	const __m512i qiOffsetDY31 = _mm512_mullo_epi32( _mm512_set1_epi32( FDY31 ), qiOffsetX );
+
+	const __m512i qiFDY12_16 = _mm512_set1_epi32( FDY12 * AVX512_REG_WIDTH );
+	const __m512i qiFDY23_16 = _mm512_set1_epi32( FDY23 * AVX512_REG_WIDTH );
+	const __m512i qiFDY31_16 = _mm512_set1_epi32( FDY31 * AVX512_REG_WIDTH );
+
+	const __m512i qiZero = _mm512_setzero_si512();
+
+	// interpolants at the first 8 pixels of the row and their increments along X and Y
+	srPlanes_AVX	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, AVX_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
+
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		__m512i qiCX1 = _mm512_sub_epi32( _mm512_set1_epi32( CY1 ), qiOffsetDY12 );
+		__m512i qiCX2 = _mm512_sub_epi32( _mm512_set1_epi32( CY2 ), qiOffsetDY23 );
+		__m512i qiCX3 = _mm512_sub_epi32( _mm512_set1_epi32( CY3 ), qiOffsetDY31 );
+
+		srPlanes_AVX	lo = planesRow;
+
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += AVX512_REG_WIDTH )
+		{
+			srPlanes_AVX	hi = lo;
+			hi.Add( stepX );
+
+			// each compare is masked by the result of the previous one
+			__mmask16 kEdgeMask = _mm512_cmpgt_epi32_mask( qiCX1, qiZero );
+			kEdgeMask = _mm512_mask_cmpgt_epi32_mask( kEdgeMask, qiCX2, qiZero );
+			kEdgeMask = _mm512_mask_cmpgt_epi32_mask( kEdgeMask, qiCX3, qiZero );
+
+			qiCX1 = _mm512_sub_epi32( qiCX1, qiFDY12_16 );
+			qiCX2 = _mm512_sub_epi32( qiCX2, qiFDY23_16 );
+			qiCX3 = _mm512_sub_epi32( qiCX3, qiFDY31_16 );
+
+			// skip these pixels if they are outside the triangle
+			if( kEdgeMask )
+			{
+				typename DEPTH::Elem* depth = (zbuffer + iX);
+
+				//#######[LOAD] load previous depth (only of covered pixels)
+				const __m512 qfOldDepth = DEPTH::Load_AVX512( kEdgeMask, depth );
+
+				// perform depth testing of covered pixels
+				const __m512 qfZ = DEPTH::Encode_AVX512( Combine_AVX512( lo.z, hi.z ) );
+				const __mmask16 kColorMask = DEPTH::LessEqual_AVX512( kEdgeMask, qfZ, qfOldDepth );
+
+				// skip these pixels if they are occluded
+				if( kColorMask )
+				{
+					//$$$@@@[STORE] write depth to framebuffer
+					DEPTH::Store_AVX512( depth, kColorMask, qfZ );
+
+					// shade covered pixels which passed the depth test, eight pixels at a time
+					ShadeTileRow_AVX2( lo, kColorMask & 0xFF, pixels + iX, context );
+					ShadeTileRow_AVX2( hi, kColorMask >> AVX_REG_WIDTH, pixels + iX + AVX_REG_WIDTH, context );
+				}
+			}
+
+			lo = hi;
+			lo.Add( stepX );
+
+		}//for x
+
+		CY1 += FDX12;
+		CY2 += FDX23;
+		CY3 += FDX31;
+
+		planesRow.Add( stepY );
+
+		pixels += W;
+		zbuffer += W;
+	}//for y
+
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
+
+}//namespace SoftRenderer
+
+#endif // SOFT_RENDER_USE_AVX512
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
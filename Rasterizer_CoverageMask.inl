@@ -0,0 +1,291 @@
+// Coverage-mask tile rasterization kernels:
+// coverage of each 8x8 block of a partially covered tile is computed up front
+// into a 64-bit mask (bit index = row * 8 + column) with SIMD edge tests,
+// then only the non-empty rows and quads of the mask are depth-tested and shaded;
+// must be included after SoftTileRenderer.h
+#include "SoftMath.h"
+
+namespace SoftRenderer
+{
+
+enum { MASK_BLOCK_SIZE = 8 };	// coverage masks are built for 8x8 blocks
+
+mxSTATIC_ASSERT( TILE_SIZE_X % MASK_BLOCK_SIZE == 0 );
+mxSTATIC_ASSERT( TILE_SIZE_Y == MASK_BLOCK_SIZE );
+
+// half-edge functions at the top-left pixel of a block and their increments
+struct srBlockEdges
+{
+	INT32	C[3];	// edge function values at the top-left pixel (28.4)
+	INT32	FDX[3];	// added when stepping down one row
+	INT32	FDY[3];	// subtracted when stepping right one pixel
+
+public:
+	FORCEINLINE void Setup( const XTriangle& face, UINT iStartX, UINT iStartY, UINT FP_SHIFT )
+	{
+		const INT32 DeltaX12 = face.FPX[0] - face.FPX[1];
+		const INT32 DeltaX23 = face.FPX[1] - face.FPX[2];
+		const INT32 DeltaX31 = face.FPX[2] - face.FPX[0];
+
+		const INT32 DeltaY12 = face.FPY[0] - face.FPY[1];
+		const INT32 DeltaY23 = face.FPY[1] - face.FPY[2];
+		const INT32 DeltaY31 = face.FPY[2] - face.FPY[0];
+
+		// top-left corner of the block in 28.4 fixed-point
+		const UINT FStartX = (iStartX << FP_SHIFT);
+		const UINT FStartY = (iStartY << FP_SHIFT);
+
+		C[0] = face.C1 + DeltaX12 * FStartY - DeltaY12 * FStartX;
+		C[1] = face.C2 + DeltaX23 * FStartY - DeltaY23 * FStartX;
+		C[2] = face.C3 + DeltaX31 * FStartY - DeltaY31 * FStartX;
+
+		FDX[0] = DeltaX12 << FP_SHIFT;
+		FDX[1] = DeltaX23 << FP_SHIFT;
+		FDX[2] = DeltaX31 << FP_SHIFT;
+
+		FDY[0] = DeltaY12 << FP_SHIFT;
+		FDY[1] = DeltaY23 << FP_SHIFT;
+		FDY[2] = DeltaY31 << FP_SHIFT;
+	}
+};
+
+// computes the 64-bit coverage mask of an 8x8 block, two quads per row
+static FORCEINLINE
+UINT64 CalcCoverageMask_SSE( const srBlockEdges& edges )
+{
+	__m128i qiCX[3][2];	// edge functions of the left and the right quad of the row
+
+	for( UINT iEdge = 0; iEdge < 3; iEdge++ )
+	{
+		const INT32 FDY = edges.FDY[iEdge];
+		qiCX[iEdge][0] = _mm_sub_epi32( _mm_set1_epi32( edges.C[iEdge] ), _mm_set_epi32( FDY * 3, FDY * 2, FDY * 1, FDY * 0 ) );
+		qiCX[iEdge][1] = _mm_sub_epi32( qiCX[iEdge][0], _mm_set1_epi32( FDY * SSE_REG_WIDTH ) );
+	}
+
+	const __m128i qiFDX12 = _mm_set1_epi32( edges.FDX[0] );
+	const __m128i qiFDX23 = _mm_set1_epi32( edges.FDX[1] );
+	const __m128i qiFDX31 = _mm_set1_epi32( edges.FDX[2] );
+
+	const __m128i qiZero = _mm_setzero_si128();
+
+	UINT64	coverage = 0;
+
+	for( UINT iRow = 0; iRow < MASK_BLOCK_SIZE; iRow++ )
+	{
+		UINT	rowMask = 0;
+
+		for( UINT iQuad = 0; iQuad < 2; iQuad++ )
+		{
+			const __m128i qiEdgeMask = _mm_and_si128(
+				_mm_cmpgt_epi32( qiCX[0][iQuad], qiZero ),
+				_mm_and_si128( _mm_cmpgt_epi32( qiCX[1][iQuad], qiZero ), _mm_cmpgt_epi32( qiCX[2][iQuad], qiZero ) )
+			);
+			rowMask |= _mm_movemask_ps( _mm_castsi128_ps( qiEdgeMask ) ) << (iQuad * SSE_REG_WIDTH);
+
+			qiCX[0][iQuad] = _mm_add_epi32( qiCX[0][iQuad], qiFDX12 );
+			qiCX[1][iQuad] = _mm_add_epi32( qiCX[1][iQuad], qiFDX23 );
+			qiCX[2][iQuad] = _mm_add_epi32( qiCX[2][iQuad], qiFDX31 );
+		}
+
+		coverage |= (UINT64)rowMask << (iRow * MASK_BLOCK_SIZE);
+	}
+
+	return coverage;
+}
+
+// depth-tests and shades the pixels of the quad selected by the four lowest bits of the coverage mask
+template< EDepthFormat FORMAT >
+static FORCEINLINE
+void ShadeCoveredQuad_SSE( const srPlanes_SSE& planes, UINT coverage, typename srDepthFormat< FORMAT >::Elem* depth, SoftPixel* pixels, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
+
+	// expand the coverage bits into lanes
+	const __m128i qiBits = _mm_set_epi32( 8, 4, 2, 1 );
+	const __m128 qfEdgeMask = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( _mm_set1_epi32( coverage ), qiBits ), qiBits ) );
+
+	//#######[LOAD] load previous depth
+	const __m128 qfOldDepth = DEPTH::Load_SSE( depth );
+	const __m128 qfNewDepth = DEPTH::Encode_SSE( planes.z );
+
+	// perform depth testing of covered pixels
+	const __m128 qfColorMask = _mm_and_ps( DEPTH::LessEqual_SSE( qfNewDepth, qfOldDepth ), qfEdgeMask );
+	const UINT mask = _mm_movemask_ps( qfColorMask );
+
+	// skip this quad if it's occluded
+	if( mask )
+	{
+		//$$$@@@[STORE] write depth to framebuffer
+		DEPTH::Store_SSE( depth, _mm_or_ps( _mm_and_ps( qfColorMask, qfNewDepth ), _mm_andnot_ps( qfColorMask, qfOldDepth ) ) );
+
+		// shade covered pixels which passed the depth test
+		ShadeTileQuad_SSE( planes, mask, pixels, context );
+	}
+}
+
+template< EDepthFormat FORMAT >
+static
+void RasterizePartiallyCoveredTile_Masks_SSE( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	const int W = context.W;	// viewport width
+
+	srPlanes_SSE	stepX, stepY;
+	stepX.SetStep( face, SSE_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
+
+	for( UINT iStartX = iBlockX; iStartX < iBlockX + TILE_SIZE_X; iStartX += MASK_BLOCK_SIZE )
+	{
+		srBlockEdges	edges;
+		edges.Setup( face, iStartX, iBlockY, context.subPixelBits );
+
+		// 8 bits per row, 4 bits per quad
+		UINT64	coverage = CalcCoverageMask_SSE( edges );
+
+		SoftPixel* pixels = context.colorBuffer + iBlockY * W + iStartX;	// color buffer
+		typename srDepthFormat< FORMAT >::Elem* zbuffer = GetDepthAddress< FORMAT >( context, iStartX, iBlockY );	// depth buffer
+
+		srPlanes_SSE	planesRow;
+		planesRow.Evaluate( face, iStartX, iBlockY );
+
+		// visit rows until no covered pixels are left in the block
+		while( coverage )
+		{
+			const UINT rowMask = (UINT)coverage & 0xFF;
+
+			// skip empty rows and quads without any depth or edge tests
+			if( rowMask & 0xF )
+			{
+				ShadeCoveredQuad_SSE< FORMAT >( planesRow, rowMask, zbuffer, pixels, context );
+			}
+			if( rowMask >> SSE_REG_WIDTH )
+			{
+				srPlanes_SSE	planes = planesRow;
+				planes.Add( stepX );
+				ShadeCoveredQuad_SSE< FORMAT >( planes, rowMask >> SSE_REG_WIDTH, zbuffer + SSE_REG_WIDTH, pixels + SSE_REG_WIDTH, context );
+			}
+
+			coverage >>= MASK_BLOCK_SIZE;
+
+			planesRow.Add( stepY );
+
+			pixels += W;
+			zbuffer += W;
+		}
+	}
+}
+
+#if SOFT_RENDER_USE_AVX
+
+// computes the 64-bit coverage mask of an 8x8 block, one row per step
+static FORCEINLINE
+UINT64 CalcCoverageMask_AVX2( const srBlockEdges& edges )
+{
+	const __m256i qi76543210 = _mm256_set_epi32( 7, 6, 5, 4, 3, 2, 1, 0 );
+
+	__m256i qiCX1 = _mm256_sub_epi32( _mm256_set1_epi32( edges.C[0] ), _mm256_mullo_epi32( _mm256_set1_epi32( edges.FDY[0] ), qi76543210 ) );
+	__m256i qiCX2 = _mm256_sub_epi32( _mm256_set1_epi32( edges.C[1] ), _mm256_mullo_epi32( _mm256_set1_epi32( edges.FDY[1] ), qi76543210 ) );
+	__m256i qiCX3 = _mm256_sub_epi32( _mm256_set1_epi32( edges.C[2] ), _mm256_mullo_epi32( _mm256_set1_epi32( edges.FDY[2] ), qi76543210 ) );
+
+	const __m256i qiFDX12 = _mm256_set1_epi32( edges.FDX[0] );
+	const __m256i qiFDX23 = _mm256_set1_epi32( edges.FDX[1] );
+	const __m256i qiFDX31 = _mm256_set1_epi32( edges.FDX[2] );
+
+	const __m256i qiZero = _mm256_setzero_si256();
+
+	UINT64	coverage = 0;
+
+	for( UINT iRow = 0; iRow < MASK_BLOCK_SIZE; iRow++ )
+	{
+		const __m256i qiEdgeMask = _mm256_and_si256(
+			_mm256_cmpgt_epi32( qiCX1, qiZero ),
+			_mm256_and_si256( _mm256_cmpgt_epi32( qiCX2, qiZero ), _mm256_cmpgt_epi32( qiCX3, qiZero ) )
+		);
+		const UINT rowMask = _mm256_movemask_ps( _mm256_castsi256_ps( qiEdgeMask ) );
+
+		coverage |= (UINT64)rowMask << (iRow * MASK_BLOCK_SIZE);
+
+		qiCX1 = _mm256_add_epi32( qiCX1, qiFDX12 );
+		qiCX2 = _mm256_add_epi32( qiCX2, qiFDX23 );
+		qiCX3 = _mm256_add_epi32( qiCX3, qiFDX31 );
+	}
+
+	return coverage;
+}
+
+template< EDepthFormat FORMAT >
+static inline
+void RasterizePartiallyCoveredTile_Masks_AVX2( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
+
+	const int W = context.W;	// viewport width
+
+	const __m256i qiBits = _mm256_set_epi32( 128, 64, 32, 16, 8, 4, 2, 1 );
+
+	srPlanes_AVX	stepY;
+	stepY.SetStep( face, 0, 1 );
+
+	for( UINT iStartX = iBlockX; iStartX < iBlockX + TILE_SIZE_X; iStartX += MASK_BLOCK_SIZE )
+	{
+		srBlockEdges	edges;
+		edges.Setup( face, iStartX, iBlockY, context.subPixelBits );
+
+		// 8 bits per row
+		UINT64	coverage = CalcCoverageMask_AVX2( edges );
+
+		SoftPixel* pixels = context.colorBuffer + iBlockY * W + iStartX;	// color buffer
+		typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, iStartX, iBlockY );	// depth buffer
+
+		srPlanes_AVX	planes;
+		planes.Evaluate( face, iStartX, iBlockY );
+
+		// visit rows until no covered pixels are left in the block
+		while( coverage )
+		{
+			const UINT rowMask = (UINT)coverage & 0xFF;
+
+			// skip empty rows without any depth or edge tests
+			if( rowMask )
+			{
+				// expand the coverage bits into lanes
+				const __m256 qfEdgeMask = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( rowMask ), qiBits ), qiBits ) );
+
+				//#######[LOAD] load previous depth
+				const __m256 qfOldDepth = DEPTH::Load_AVX2( zbuffer );
+				const __m256 qfNewDepth = DEPTH::Encode_AVX2( planes.z );
+
+				// perform depth testing of covered pixels
+				const __m256 qfColorMask = _mm256_and_ps( DEPTH::LessEqual_AVX2( qfNewDepth, qfOldDepth ), qfEdgeMask );
+				const UINT mask = _mm256_movemask_ps( qfColorMask );
+
+				// skip these 8 pixels if they are occluded
+				if( mask )
+				{
+					//$$$@@@[STORE] write depth to framebuffer
+					DEPTH::Store_AVX2( zbuffer, _mm256_blendv_ps( qfOldDepth, qfNewDepth, qfColorMask ) );
+
+					// shade covered pixels which passed the depth test
+					ShadeTileRow_AVX2( planes, mask, pixels, context );
+				}
+			}
+
+			coverage >>= MASK_BLOCK_SIZE;
+
+			planes.Add( stepY );
+
+			pixels += W;
+			zbuffer += W;
+		}
+	}
+
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+}
+
+#endif // SOFT_RENDER_USE_AVX
+
+}//namespace SoftRenderer
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
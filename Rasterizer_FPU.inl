@@ -53,15 +53,18 @@ void RasterizeTriangle_FPU(
 	*/
 	// 28.4 fixed-point coordinates
 	// (12 bit resolution, enough for a 4096x4096 color buffer)
-	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
+	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer,
+	// the precision is lowered on larger viewports)
 	// 
-	const INT32 X1 = iround( 16.0f * fX1 );
-	const INT32 X2 = iround( 16.0f * fX2 );
-	const INT32 X3 = iround( 16.0f * fX3 );
+	const UINT SHIFT = context.subPixelBits;
 
-	const INT32 Y1 = iround( 16.0f * fY1 );
-	const INT32 Y2 = iround( 16.0f * fY2 );
-	const INT32 Y3 = iround( 16.0f * fY3 );
+	const INT32 X1 = iround( F4(1<<SHIFT) * fX1 );
+	const INT32 X2 = iround( F4(1<<SHIFT) * fX2 );
+	const INT32 X3 = iround( F4(1<<SHIFT) * fX3 );
+
+	const INT32 Y1 = iround( F4(1<<SHIFT) * fY1 );
+	const INT32 Y2 = iround( F4(1<<SHIFT) * fY2 );
+	const INT32 Y3 = iround( F4(1<<SHIFT) * fY3 );
 
 	//const INT32 Z1 = iround( 16.0f * fZ1 );
 	//const INT32 Z2 = iround( 16.0f * fZ2 );
@@ -99,13 +102,13 @@ void RasterizeTriangle_FPU(
 
 
 	// 24.8 Fixed-point deltas
-	const INT32 FDX12 = DeltaX12 << 4;
-	const INT32 FDX23 = DeltaX23 << 4;
-	const INT32 FDX31 = DeltaX31 << 4;
+	const INT32 FDX12 = DeltaX12 << SHIFT;
+	const INT32 FDX23 = DeltaX23 << SHIFT;
+	const INT32 FDX31 = DeltaX31 << SHIFT;
 
-	const INT32 FDY12 = DeltaY12 << 4;
-	const INT32 FDY23 = DeltaY23 << 4;
-	const INT32 FDY31 = DeltaY31 << 4;
+	const INT32 FDY12 = DeltaY12 << SHIFT;
+	const INT32 FDY23 = DeltaY23 << SHIFT;
+	const INT32 FDY31 = DeltaY31 << SHIFT;
 
 
 
@@ -231,20 +234,21 @@ void RasterizeTriangle_FPU(
 
 	// Bounding rectangle of this triangle in screen space
 
-	// Adding 0xF and shifting right 4 bits is the equivalent of a ceil() function for the 28.4 fixed-point format.
+	// Adding 0xF and shifting right 4 bits is the equivalent of a ceil() function for the 28.4 fixed-point format
+	// (in general, adding (1 << SHIFT) - 1 and shifting right SHIFT bits).
 	// The first pixel to be filled is the one strictly to the right of the first edge,
 	// so that's why a ceil() operation is used (the fill convention for colorBuffer spot on the edge is taken care of a few lines lower).
 
 #if 0
-	INT32 nMinX = Clamp( (Min3(X1, X2, X3) + 0xF) >> 4, 0, W );
-	INT32 nMaxX = Clamp( (Max3(X1, X2, X3) + 0xF) >> 4, 0, W );
-	INT32 nMinY = Clamp( (Min3(Y1, Y2, Y3) + 0xF) >> 4, 0, H );
-	INT32 nMaxY = Clamp( (Max3(Y1, Y2, Y3) + 0xF) >> 4, 0, H );
+	INT32 nMinX = Clamp( (Min3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT, 0, W );
+	INT32 nMaxX = Clamp( (Max3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT, 0, W );
+	INT32 nMinY = Clamp( (Min3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT, 0, H );
+	INT32 nMaxY = Clamp( (Max3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT, 0, H );
 #else
-	INT32 nMinX = (Min3(X1, X2, X3) + 0xF) >> 4;
-	INT32 nMaxX = (Max3(X1, X2, X3) + 0xF) >> 4;
-	INT32 nMinY = (Min3(Y1, Y2, Y3) + 0xF) >> 4;
-	INT32 nMaxY = (Max3(Y1, Y2, Y3) + 0xF) >> 4;
+	INT32 nMinX = (Min3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT;
+	INT32 nMaxX = (Max3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT;
+	INT32 nMinY = (Min3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT;
+	INT32 nMaxY = (Max3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT;
 #endif
 
 
@@ -262,7 +266,7 @@ void RasterizeTriangle_FPU(
 
 	//const UINT stride = W * sizeof SoftPixel;	// aka 'pitch'
 	SoftPixel* startPixels = context.colorBuffer + nMinY * W;	// color buffer
-	ZBufElem* startZBuffer = context.depthBuffer + nMinY * W;	// depth buffer
+	ZBufElem* startZBuffer = (ZBufElem*) context.depthBuffer + nMinY * W;	// depth buffer
 
 
 
@@ -275,10 +279,10 @@ void RasterizeTriangle_FPU(
 		for( UINT iBlockX = nMinX; iBlockX < nMaxX; iBlockX += BLOCK_SIZE_X )
 		{
 			// Corners of block in 28.4 fixed-point (4 bits of sub-pixel accuracy)
-			const UINT FBlockX0 = (iBlockX << 4);
-			const UINT FBlockX1 = (iBlockX + (BLOCK_SIZE_X - 1)) << 4;
-			const UINT FBlockY0 = (iBlockY << 4);
-			const UINT FBlockY1 = (iBlockY + (BLOCK_SIZE_Y - 1)) << 4;
+			const UINT FBlockX0 = (iBlockX << SHIFT);
+			const UINT FBlockX1 = (iBlockX + (BLOCK_SIZE_X - 1)) << SHIFT;
+			const UINT FBlockY0 = (iBlockY << SHIFT);
+			const UINT FBlockY1 = (iBlockY + (BLOCK_SIZE_Y - 1)) << SHIFT;
 
 			// Evaluate half-space functions in the 4 corners of the block
 
@@ -396,7 +400,7 @@ void RasterizeTriangle_FPU(
 					zbuffer += W;
 				}//for y
 
-				SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, FBlockX0 >> 4, FBlockY0 >> 4, BLOCK_SIZE_X, BLOCK_SIZE_Y );
+				SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, FBlockX0 >> SHIFT, FBlockY0 >> SHIFT, BLOCK_SIZE_X, BLOCK_SIZE_Y );
 
 				// (end of fully covered block)
 			}
@@ -467,7 +471,7 @@ void RasterizeTriangle_FPU(
 					zbuffer += W;
 				}//for y
 
-				SoftRenderer::Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, FBlockX0 >> 4, FBlockY0 >> 4, BLOCK_SIZE_X, BLOCK_SIZE_Y );
+				SoftRenderer::Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, FBlockX0 >> SHIFT, FBlockY0 >> SHIFT, BLOCK_SIZE_X, BLOCK_SIZE_Y );
 
 			}//Partially covered block
 
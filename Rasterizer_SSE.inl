@@ -11,9 +11,9 @@ void RasterizeTriangleImmediateColorOnly_SSE(
 {
 	mxPROFILE_SCOPE("Rasterize Triangle");
 
-	// 28.4 fixed-point coordinates
-	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
-	enum { SHIFT = 4 };
+	// 28.4 fixed-point coordinates on viewports up to 2048x2048
+	// (sub-pixel precision is lowered on larger viewports)
+	const UINT SHIFT = context.subPixelBits;
 
 
 	const ARGB32 COLOR = ARGB8_WHITE;
@@ -87,16 +87,16 @@ void RasterizeTriangleImmediateColorOnly_SSE(
 
 
 	// Bounding rectangle of this triangle in screen space
-	const INT32 nMinX = ((Min3(X1, X2, X3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
-	const INT32 nMaxX = ((Max3(X1, X2, X3) + 0xF) >> SHIFT);
-	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
-	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + 0xF) >> SHIFT);
+	const INT32 nMinX = ((Min3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
+	const INT32 nMaxX = ((Max3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT);
+	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
+	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT);
 
 
 
 	//const UINT stride = W * sizeof SoftPixel;	// aka 'pitch'
 	SoftPixel* startPixels = context.colorBuffer + nMinY * W;	// color buffer
-	ZBufElem* startZBuffer = context.depthBuffer + nMinY * W;	// depth buffer
+	ZBufElem* startZBuffer = (ZBufElem*) context.depthBuffer + nMinY * W;	// depth buffer
 
 
 	SPixelShaderParameters	pixelShaderArgs;
@@ -178,7 +178,7 @@ void RasterizeTriangleImmediateColorOnly_SSE(
 					zbuffer += W;
 				}//for y
 
-				SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, FBlockX0 >> 4, FBlockY0 >> 4, BLOCK_SIZE_X, BLOCK_SIZE_Y );
+				SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, FBlockX0 >> SHIFT, FBlockY0 >> SHIFT, BLOCK_SIZE_X, BLOCK_SIZE_Y );
 				// End of fully covered block
 			}
 			else // Partially covered block
@@ -255,9 +255,9 @@ void RasterizeTriangleImmediateDepthOnly_SSE(
 {
 	mxPROFILE_SCOPE("Rasterize Triangle");
 
-	// 28.4 fixed-point coordinates
-	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
-	enum { SHIFT = 4 };
+	// 28.4 fixed-point coordinates on viewports up to 2048x2048
+	// (sub-pixel precision is lowered on larger viewports)
+	const UINT SHIFT = context.subPixelBits;
 
 
 
@@ -347,7 +347,6 @@ void RasterizeTriangleImmediateDepthOnly_SSE(
 		);
 
 
-	mxSTATIC_ASSERT( SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER );
 
 
 
@@ -369,16 +368,16 @@ void RasterizeTriangleImmediateDepthOnly_SSE(
 
 
 	// Bounding rectangle of this triangle in screen space
-	const INT32 nMinX = ((Min3(X1, X2, X3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
-	const INT32 nMaxX = ((Max3(X1, X2, X3) + 0xF) >> SHIFT);
-	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
-	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + 0xF) >> SHIFT);
+	const INT32 nMinX = ((Min3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
+	const INT32 nMaxX = ((Max3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT);
+	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
+	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT);
 
 
 
 	//const UINT stride = W * sizeof SoftPixel;	// aka 'pitch'
 	SoftPixel* startPixels = context.colorBuffer + nMinY * W;	// color buffer
-	ZBufElem* startZBuffer = context.depthBuffer + nMinY * W;	// depth buffer
+	ZBufElem* startZBuffer = (ZBufElem*) context.depthBuffer + nMinY * W;	// depth buffer
 
 
 	SPixelShaderParameters	pixelShaderArgs;
@@ -572,9 +571,9 @@ void RasterizeTriangleImmediateUserShader_SSE(
 {
 	mxPROFILE_SCOPE("Rasterize Triangle");
 
-	// 28.4 fixed-point coordinates
-	// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
-	enum { SHIFT = 4 };
+	// 28.4 fixed-point coordinates on viewports up to 2048x2048
+	// (sub-pixel precision is lowered on larger viewports)
+	const UINT SHIFT = context.subPixelBits;
 
 
 
@@ -664,7 +663,6 @@ void RasterizeTriangleImmediateUserShader_SSE(
 		);
 
 
-	mxSTATIC_ASSERT( SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER );
 
 
 
@@ -686,10 +684,10 @@ void RasterizeTriangleImmediateUserShader_SSE(
 
 
 	// Bounding rectangle of this triangle in screen space
-	const INT32 nMinX = ((Min3(X1, X2, X3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
-	const INT32 nMaxX = ((Max3(X1, X2, X3) + 0xF) >> SHIFT);
-	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + 0xF) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
-	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + 0xF) >> SHIFT);
+	const INT32 nMinX = ((Min3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
+	const INT32 nMaxX = ((Max3(X1, X2, X3) + ((1 << SHIFT) - 1)) >> SHIFT);
+	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
+	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + ((1 << SHIFT) - 1)) >> SHIFT);
 
 
 
@@ -700,7 +698,7 @@ void RasterizeTriangleImmediateUserShader_SSE(
 
 	//const UINT stride = W * sizeof SoftPixel;	// aka 'pitch'
 	SoftPixel* startPixels = context.colorBuffer + nMinY * W;	// color buffer
-	ZBufElem* startZBuffer = context.depthBuffer + nMinY * W;	// depth buffer
+	ZBufElem* startZBuffer = (ZBufElem*) context.depthBuffer + nMinY * W;	// depth buffer
 
 
 	SPixelShaderParameters	pixelShaderArgs;
@@ -1,13 +1,24 @@
 #include "SoftRender_PCH.h"
 #pragma hdrstop
+#include <Base/JobSystem/ThreadPool.h>
 #include "SoftFrameBuffer.h"
 
 SoftFrameBuffer::SoftFrameBuffer()
 {
 	m_colorBuffer = nil;
 	m_depthBuffer = nil;
+	m_depthFormat = DepthFormat_F32;
+	m_tiledColorBuffer = nil;
+	m_tiledLayout = false;
+	m_tileFlags = nil;
+	m_clearColor = 0;
+	m_depthPlanes = nil;
 	m_viewportWidth = 0;
 	m_viewportHeight = 0;
+	m_subPixelBits = SOFT_RENDER_MAX_SUBPIXEL_BITS;
+	m_tileMaxDepth = nil;
+	m_numDepthTilesX = 0;
+	m_numDepthTilesY = 0;
 }
 
 SoftFrameBuffer::~SoftFrameBuffer()
@@ -19,25 +30,65 @@ bool SoftFrameBuffer::Initialize( UINT width, UINT height, SoftPixel* pixels )
 {
 	CHK_VRET_FALSE_IF_NOT(width > 1);
 	CHK_VRET_FALSE_IF_NOT(height > 1);
+	CHK_VRET_FALSE_IF_NOT(width <= SOFT_RENDER_MAX_WINDOW_WIDTH);
+	CHK_VRET_FALSE_IF_NOT(height <= SOFT_RENDER_MAX_WINDOW_HEIGHT);
 	CHK_VRET_FALSE_IF_NIL(pixels);
 
 	Shutdown();
 
-	DEVOUT("FrameBuffer::Initialize: %ux%u, color: %u KiB, depth: color: %u KiB\n",
+	m_subPixelBits = GetSubPixelBits( width, height );
+
+	DEVOUT("FrameBuffer::Initialize: %ux%u, color: %u KiB, depth: color: %u KiB, sub-pixel bits: %u\n",
 		width,
 		height,
 		(width*height*sizeof m_colorBuffer[0])/mxKIBIBYTE,
-		(width*height*sizeof m_depthBuffer[0])/mxKIBIBYTE
+		(width*height*GetDepthElementSize( m_depthFormat ))/mxKIBIBYTE,
+		m_subPixelBits
 		);
 
 	m_viewportWidth = width;
 	m_viewportHeight = height;
 	m_colorBuffer = pixels;
-	m_depthBuffer = (ZBufElem*) mxAlloc( m_viewportWidth * m_viewportHeight * sizeof m_depthBuffer[0] );
+
+	m_numDepthTilesX = (width + HIZ_TILE_SIZE_X - 1) / HIZ_TILE_SIZE_X;
+	m_numDepthTilesY = (height + HIZ_TILE_SIZE_Y - 1) / HIZ_TILE_SIZE_Y;
+	m_tileMaxDepth = (F4*) mxAlloc( m_numDepthTilesX * m_numDepthTilesY * sizeof m_tileMaxDepth[0] );
+
+	// room for whole tiles, so that the layout can be switched later
+	m_depthBuffer = mxAlloc( GetNumTiledPixels() * GetDepthElementSize( m_depthFormat ) );
+
+	m_tileFlags = (BYTE*) mxAlloc( m_numDepthTilesX * m_numDepthTilesY * sizeof m_tileFlags[0] );
+	MemSet( m_tileFlags, 0, m_numDepthTilesX * m_numDepthTilesY * sizeof m_tileFlags[0] );
+
+	m_tiledLayout = false;
 
 	return true;
 }
 
+UINT SoftFrameBuffer::GetNumTiledPixels() const
+{
+	return m_numDepthTilesX * m_numDepthTilesY * MEMORY_TILE_PIXELS;
+}
+
+UINT SoftFrameBuffer::GetSubPixelBits( UINT width, UINT height )
+{
+	// edge function values are bounded by 2^(2*(N+S)+1),
+	// where N is the number of integer bits and S - the number of fractional bits of screen coordinates
+	enum { MAX_COORD_BITS = 15 };
+
+	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_WIDTH <= (1 << (MAX_COORD_BITS - SOFT_RENDER_MIN_SUBPIXEL_BITS)) );
+	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_HEIGHT <= (1 << (MAX_COORD_BITS - SOFT_RENDER_MIN_SUBPIXEL_BITS)) );
+
+	const UINT maxSize = largest( width, height );
+
+	UINT subPixelBits = SOFT_RENDER_MAX_SUBPIXEL_BITS;
+	while( subPixelBits > SOFT_RENDER_MIN_SUBPIXEL_BITS && maxSize > (1U << (MAX_COORD_BITS - subPixelBits)) )
+	{
+		subPixelBits--;
+	}
+	return subPixelBits;
+}
+
 void SoftFrameBuffer::Shutdown()
 {
 	m_viewportWidth = 0;
@@ -48,45 +99,425 @@ void SoftFrameBuffer::Shutdown()
 		mxFree( m_depthBuffer );
 		m_depthBuffer = nil;
 	}
+	if( m_tiledColorBuffer != nil )
+	{
+		mxFree( m_tiledColorBuffer );
+		m_tiledColorBuffer = nil;
+	}
+	if( m_tileFlags != nil )
+	{
+		mxFree( m_tileFlags );
+		m_tileFlags = nil;
+	}
+	if( m_depthPlanes != nil )
+	{
+		mxFree( m_depthPlanes );
+		m_depthPlanes = nil;
+	}
+	m_tiledLayout = false;
+	if( m_tileMaxDepth != nil )
+	{
+		mxFree( m_tileMaxDepth );
+		m_tileMaxDepth = nil;
+	}
+	m_numDepthTilesX = 0;
+	m_numDepthTilesY = 0;
 }
 
 void SoftFrameBuffer::ClearDepthOnly()
 {
 	mxPROFILE_SCOPE("Clear depth buffer");
 
-	// Clear depth buffer.
+	// the whole screen is empty;
+	// depth values are written when tiles are rendered to
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+	for( UINT iTile = 0; iTile < numTiles; iTile++ )
+	{
+		if( m_depthPlanes != nil )
+		{
+			// with depth compression cleared tiles are constant planes
+			DepthPlane & plane = m_depthPlanes[ iTile ];
+			plane.z0 = SOFT_MAX_DEPTH;
+			plane.dzdx = 0.0f;
+			plane.dzdy = 0.0f;
+			m_tileFlags[ iTile ] = (m_tileFlags[ iTile ] & ~TILE_DEPTH_CLEARED) | TILE_DEPTH_PLANE;
+		}
+		else
+		{
+			m_tileFlags[ iTile ] = (m_tileFlags[ iTile ] & ~TILE_DEPTH_PLANE) | TILE_DEPTH_CLEARED;
+		}
+		m_tileMaxDepth[ iTile ] = SOFT_MAX_DEPTH;
+	}
+}
+
+void SoftFrameBuffer::ClearColor( SoftPixel color )
+{
+	m_clearColor = color;
+
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+	for( UINT iTile = 0; iTile < numTiles; iTile++ )
+	{
+		m_tileFlags[ iTile ] = (m_tileFlags[ iTile ] & ~TILE_COLOR_IN_USER_BUFFER) | TILE_COLOR_CLEARED;
+	}
+}
+
+// fills a rectangle with a repeated 32-bit value (colors, 16- and 32-bit depth values);
+// pitch and row size are in bytes
+static void FillRows( void* dst, UINT pitch, UINT rowSize, UINT numRows, UINT32 value )
+{
+	const __m128i qiValue = _mm_set1_epi32( value );
+
+	BYTE* row = (BYTE*) dst;
+
+	for( UINT iY = 0; iY < numRows; iY++ )
+	{
+		UINT iByte = 0;
+		for( ; iByte + 16 <= rowSize; iByte += 16 ) {
+			_mm_storeu_si128( (__m128i*) (row + iByte), qiValue );
+		}
+		for( ; iByte + 4 <= rowSize; iByte += 4 ) {
+			*(UINT32*) (row + iByte) = value;
+		}
+		if( iByte < rowSize ) {
+			*(UINT16*) (row + iByte) = (UINT16) value;
+		}
+		row += pitch;
+	}
+}
+
+// copies a rectangle of 16- or 32-bit elements; pitches and row size are in bytes
+static void CopyRows( void* dst, UINT dstPitch, const void* src, UINT srcPitch, UINT rowSize, UINT numRows )
+{
+	BYTE* dstRow = (BYTE*) dst;
+	const BYTE* srcRow = (const BYTE*) src;
+
+	for( UINT iY = 0; iY < numRows; iY++ )
+	{
+		UINT iByte = 0;
+		for( ; iByte + 16 <= rowSize; iByte += 16 ) {
+			_mm_storeu_si128( (__m128i*) (dstRow + iByte), _mm_loadu_si128( (const __m128i*) (srcRow + iByte) ) );
+		}
+		for( ; iByte < rowSize; iByte += 2 ) {
+			*(UINT16*) (dstRow + iByte) = *(const UINT16*) (srcRow + iByte);
+		}
+		dstRow += dstPitch;
+		srcRow += srcPitch;
+	}
+}
+
+void SoftFrameBuffer::GetTileRect( UINT iTile, UINT &x, UINT &y, UINT &numColumns, UINT &numRows ) const
+{
+	x = (iTile % m_numDepthTilesX) * MEMORY_TILE_SIZE_X;
+	y = (iTile / m_numDepthTilesX) * MEMORY_TILE_SIZE_Y;
+	numColumns = smallest( (UINT)MEMORY_TILE_SIZE_X, m_viewportWidth - x );
+	numRows = smallest( (UINT)MEMORY_TILE_SIZE_Y, m_viewportHeight - y );
+}
+
+void SoftFrameBuffer::CopyTiles( void* linear, void* tiled, UINT elementSize, bool bToLinear ) const
+{
+	const UINT linearPitch = m_viewportWidth * elementSize;
+	const UINT tilePitch = MEMORY_TILE_SIZE_X * elementSize;
+
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+	for( UINT iTile = 0; iTile < numTiles; iTile++ )
+	{
+		UINT x, y, numColumns, numRows;
+		GetTileRect( iTile, x, y, numColumns, numRows );
+
+		BYTE* rect = (BYTE*) linear + (y * m_viewportWidth + x) * elementSize;
+		BYTE* tile = (BYTE*) tiled + iTile * MEMORY_TILE_PIXELS * elementSize;
+
+		if( bToLinear ) {
+			CopyRows( rect, linearPitch, tile, tilePitch, numColumns * elementSize, numRows );
+		} else {
+			CopyRows( tile, tilePitch, rect, linearPitch, numColumns * elementSize, numRows );
+		}
+	}
+}
+
+void SoftFrameBuffer::ApplyTileFlags( UINT iTile )
+{
+	const UINT flags = m_tileFlags[ iTile ];
+
+	UINT x, y, numColumns, numRows;
+	GetTileRect( iTile, x, y, numColumns, numRows );
+
+	const UINT depthSize = GetDepthElementSize( m_depthFormat );
+
+	SoftPixel* userPixels = m_colorBuffer + y * m_viewportWidth + x;
+
+	// memory of the tile
+	BYTE* depth;
+	SoftPixel* color;
+	UINT pitch;	// in pixels
+	if( m_tiledLayout )
+	{
+		depth = (BYTE*) m_depthBuffer + iTile * MEMORY_TILE_PIXELS * depthSize;
+		color = m_tiledColorBuffer + iTile * MEMORY_TILE_PIXELS;
+		pitch = MEMORY_TILE_SIZE_X;
+	}
+	else
+	{
+		depth = (BYTE*) m_depthBuffer + (y * m_viewportWidth + x) * depthSize;
+		color = userPixels;
+		pitch = m_viewportWidth;
+	}
+
+	if( flags & TILE_DEPTH_CLEARED )
+	{
+		FillRows( depth, pitch * depthSize, numColumns * depthSize, numRows, GetDepthClearValue( m_depthFormat ) );
+	}
+	else if( flags & TILE_DEPTH_PLANE )
+	{
+		this->ExpandDepthPlane( iTile, (F4*) depth, pitch, numColumns, numRows );
+	}
+	if( flags & TILE_COLOR_CLEARED )
+	{
+		FillRows( color, pitch * SOFT_STRIDE, numColumns * SOFT_STRIDE, numRows, m_clearColor );
+	}
+	else if( flags & TILE_COLOR_IN_USER_BUFFER )
+	{
+		Assert( m_tiledLayout );
+		CopyRows( color, pitch * SOFT_STRIDE, userPixels, m_viewportWidth * SOFT_STRIDE, numColumns * SOFT_STRIDE, numRows );
+	}
+
+	m_tileFlags[ iTile ] = 0;
+}
+
+void SoftFrameBuffer::ResolveTile( UINT iTile )
+{
+	const UINT flags = m_tileFlags[ iTile ];
+
+	UINT x, y, numColumns, numRows;
+	GetTileRect( iTile, x, y, numColumns, numRows );
+
+	SoftPixel* userPixels = m_colorBuffer + y * m_viewportWidth + x;
+
+	if( flags & TILE_COLOR_CLEARED )
+	{
+		// the tile has not been rendered to since the clear
+		FillRows( userPixels, m_viewportWidth * SOFT_STRIDE, numColumns * SOFT_STRIDE, numRows, m_clearColor );
+	}
+	else if( m_tiledLayout && !(flags & TILE_COLOR_IN_USER_BUFFER) )
+	{
+		const SoftPixel* tile = m_tiledColorBuffer + iTile * MEMORY_TILE_PIXELS;
+		CopyRows( userPixels, m_viewportWidth * SOFT_STRIDE, tile, MEMORY_TILE_SIZE_X * SOFT_STRIDE, numColumns * SOFT_STRIDE, numRows );
+	}
+
+	// in tiled layout the user's buffer now holds the pixels
+	// (and the user may change them before the next frame)
+	m_tileFlags[ iTile ] = (flags & ~TILE_COLOR_CLEARED) | (m_tiledLayout ? TILE_COLOR_IN_USER_BUFFER : 0);
+}
+
+void SoftFrameBuffer::ApplyAllTileFlags()
+{
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+	for( UINT iTile = 0; iTile < numTiles; iTile++ )
+	{
+		this->PrepareTile( iTile );
+	}
+}
+
+void SoftFrameBuffer::SetTiledLayout( bool bTiled )
+{
+	if( m_tiledLayout == bTiled || !m_depthBuffer ) {
+		return;
+	}
+
+	const UINT numTiledPixels = GetNumTiledPixels();
+	const UINT depthSize = GetDepthElementSize( m_depthFormat );
+
+	// rearrange depth values (tiles with pending clears are flagged in both layouts)
+	void* newDepthBuffer = mxAlloc( numTiledPixels * depthSize );
 
-#if 0
-	for( UINT y = 0; y < m_viewportHeight; y++ )
+	if( bTiled )
 	{
-		for( UINT x = 0; x < m_viewportWidth; x++ )
+		this->CopyTiles( m_depthBuffer, newDepthBuffer, depthSize, false );
+
+		m_tiledColorBuffer = (SoftPixel*) mxAlloc( numTiledPixels * sizeof m_tiledColorBuffer[0] );
+		m_tiledLayout = true;
+		this->SwizzleColor();
+	}
+	else
+	{
+		this->CopyTiles( newDepthBuffer, m_depthBuffer, depthSize, true );
+
+		this->ResolveColor();
+		mxFree( m_tiledColorBuffer );
+		m_tiledColorBuffer = nil;
+		m_tiledLayout = false;
+
+		const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+		for( UINT iTile = 0; iTile < numTiles; iTile++ )
 		{
-			m_depthBuffer[ y * m_viewportWidth + x ] = SOFT_MAX_DEPTH;
+			m_tileFlags[ iTile ] &= ~TILE_COLOR_IN_USER_BUFFER;
 		}
 	}
-#else
 
-	mxSTATIC_ASSERT( SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER );
+	mxFree( m_depthBuffer );
+	m_depthBuffer = newDepthBuffer;
+}
+
+void SoftFrameBuffer::SetDepthFormat( EDepthFormat depthFormat )
+{
+	if( m_depthFormat == depthFormat || !m_depthBuffer ) {
+		m_depthFormat = depthFormat;
+		return;
+	}
+
+	// only floating-point depth can be compressed
+	if( depthFormat != DepthFormat_F32 && m_depthPlanes != nil )
+	{
+		mxFree( m_depthPlanes );
+		m_depthPlanes = nil;
+	}
+
+	mxFree( m_depthBuffer );
+	m_depthFormat = depthFormat;
+	m_depthBuffer = mxAlloc( GetNumTiledPixels() * GetDepthElementSize( m_depthFormat ) );
+
+	// the old contents are lost
+	this->ClearDepthOnly();
+}
 
-	_flint	u;
-	u.f = SOFT_MAX_DEPTH;
+void SoftFrameBuffer::SetDepthCompression( bool bEnable )
+{
+	if( (m_depthPlanes != nil) == bEnable || !m_depthBuffer ) {
+		return;
+	}
 
-#if 0
-	const __m128i qiMaxDepth = _mm_set1_epi32( u.i );
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
 
-	for( UINT y = 0; y < m_viewportHeight; y++ )
+	if( bEnable )
 	{
-		for( UINT x = 0; x < m_viewportWidth; x+=4 )
+		Assert( m_depthFormat == DepthFormat_F32 );
+		// tiles become compressed when they are cleared or fully covered by a triangle
+		m_depthPlanes = (DepthPlane*) mxAlloc( numTiles * sizeof m_depthPlanes[0] );
+	}
+	else
+	{
+		for( UINT iTile = 0; iTile < numTiles; iTile++ )
 		{
-			__m128i* dest = (__m128i*) &m_depthBuffer[ y * m_viewportWidth + x ];
+			if( m_tileFlags[ iTile ] & TILE_DEPTH_PLANE ) {
+				this->ApplyTileFlags( iTile );
+			}
+		}
+		mxFree( m_depthPlanes );
+		m_depthPlanes = nil;
+	}
+}
 
-			_mm_store_si128( dest, qiMaxDepth );
+void SoftFrameBuffer::ExpandDepthPlane( UINT iTile, F4* depth, UINT pitch, UINT numColumns, UINT numRows ) const
+{
+	const DepthPlane& plane = m_depthPlanes[ iTile ];
+
+	for( UINT iY = 0; iY < numRows; iY++ )
+	{
+		for( UINT iX = 0; iX < numColumns; iX += 4 )
+		{
+			const __m128 qfZ = EvaluateDepthPlane_SSE( plane, iX, iY );
+			if( iX + 4 <= numColumns ) {
+				_mm_storeu_ps( depth + iX, qfZ );
+			} else {
+				mxSIMDALIGNED F4 z[4];
+				_mm_store_ps( z, qfZ );
+				for( UINT i = iX; i < numColumns; i++ ) {
+					depth[i] = z[ i - iX ];
+				}
+			}
+		}
+		depth += pitch;
+	}
+}
+
+F4 SoftFrameBuffer::GetDepthPlaneMax( UINT iTile ) const
+{
+	const DepthPlane& plane = m_depthPlanes[ iTile ];
+
+	// the same values as in the expanded tile (including the pixels outside the viewport)
+	__m128 qfMaxDepth = EvaluateDepthPlane_SSE( plane, 0, 0 );
+	for( UINT iY = 0; iY < MEMORY_TILE_SIZE_Y; iY++ )
+	{
+		for( UINT iX = 0; iX < MEMORY_TILE_SIZE_X; iX += 4 )
+		{
+			qfMaxDepth = _mm_max_ps( qfMaxDepth, EvaluateDepthPlane_SSE( plane, iX, iY ) );
 		}
 	}
-#else
-	MemSet( m_depthBuffer, u.i, m_viewportHeight * m_viewportWidth * sizeof m_depthBuffer[0] );
-#endif
+	qfMaxDepth = _mm_max_ps( qfMaxDepth, _mm_shuffle_ps( qfMaxDepth, qfMaxDepth, _MM_SHUFFLE(1,0,3,2) ) );
+	qfMaxDepth = _mm_max_ps( qfMaxDepth, _mm_shuffle_ps( qfMaxDepth, qfMaxDepth, _MM_SHUFFLE(2,3,0,1) ) );
+	return _mm_cvtss_f32( qfMaxDepth );
+}
+
+void SoftFrameBuffer::SwizzleColor()
+{
+	if( m_tiledLayout )
+	{
+		// cleared tiles are not loaded
+		const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+		for( UINT iTile = 0; iTile < numTiles; iTile++ )
+		{
+			if( !(m_tileFlags[ iTile ] & TILE_COLOR_CLEARED) ) {
+				m_tileFlags[ iTile ] |= TILE_COLOR_IN_USER_BUFFER;
+			}
+		}
+	}
+}
+
+// resolves a contiguous range of tiles
+struct ResolveTilesJob : AsyncJob
+{
+	SoftFrameBuffer *	m_frameBuffer;
+	UINT	m_firstTile;
+	UINT	m_numTiles;
 
+public:
+	ResolveTilesJob()
+	{
+		m_frameBuffer = nil;
+		m_firstTile = 0;
+		m_numTiles = 0;
+	}
+	virtual void Run( const AsyncJob::Context& context ) override
+	{
+		const UINT lastTile = m_firstTile + m_numTiles;
+		for( UINT iTile = m_firstTile; iTile < lastTile; iTile++ )
+		{
+			m_frameBuffer->ResolveTile( iTile );
+		}
+	}
+};
+
+void SoftFrameBuffer::ResolveColor()
+{
+	mxPROFILE_SCOPE("Resolve color buffer");
+
+	const UINT numTiles = m_numDepthTilesX * m_numDepthTilesY;
+
+	if( !SoftRenderer::bDbg_EnableThreading )
+	{
+		for( UINT iTile = 0; iTile < numTiles; iTile++ )
+		{
+			this->ResolveTile( iTile );
+		}
+		return;
+	}
+
+	enum { MAX_RESOLVE_JOBS = 32 };
+	ResolveTilesJob	jobs[ MAX_RESOLVE_JOBS ];
+
+	ThreadPool& threads = SoftRenderer::GetThreadPool();
+
+	const UINT tilesPerJob = (numTiles + MAX_RESOLVE_JOBS - 1) / MAX_RESOLVE_JOBS;
+
+	for( UINT iJob = 0; iJob * tilesPerJob < numTiles; iJob++ )
+	{
+		ResolveTilesJob& job = jobs[ iJob ];
+		job.m_frameBuffer = this;
+		job.m_firstTile = iJob * tilesPerJob;
+		job.m_numTiles = smallest( tilesPerJob, numTiles - job.m_firstTile );
+
+		threads.EnqueueJob( &job );
+	}
 
-#endif
+	threads.RunAllJobs();
 }
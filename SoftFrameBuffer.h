@@ -5,11 +5,60 @@
 struct SoftFrameBuffer
 {
 	SoftPixel *	m_colorBuffer;	// <= memory not owned, managed by the user
-	ZBufElem *	m_depthBuffer;	// <= owned by the framebuffer
+	void *		m_depthBuffer;	// <= owned by the framebuffer, elements of m_depthFormat
+	EDepthFormat	m_depthFormat;
+
+	// optional tiled layout: each MEMORY_TILE_SIZE_X x MEMORY_TILE_SIZE_Y tile of the depth buffer
+	// and of m_tiledColorBuffer is stored contiguously (tiles follow each other in row-major order),
+	// so that the tile rasterizer walks memory linearly;
+	// the user's color buffer is filled by ResolveColor()
+	SoftPixel *	m_tiledColorBuffer;	// <= owned by the framebuffer, null if the layout is linear
+	bool		m_tiledLayout;
 
 	UINT		m_viewportWidth;
 	UINT		m_viewportHeight;
 
+	UINT		m_subPixelBits;	// sub-pixel precision of the rasterizer, see SOFT_RENDER_MAX_SUBPIXEL_BITS
+
+	// hierarchical Z: farthest depth value in each HIZ_TILE_SIZE_X x HIZ_TILE_SIZE_Y screen tile;
+	// it is lowered by the tile rasterizer and is never below the actual depth values,
+	// so triangles behind it can be rejected before they are rasterized
+	F4 *		m_tileMaxDepth;	// [m_numDepthTilesX * m_numDepthTilesY]
+	UINT		m_numDepthTilesX;
+	UINT		m_numDepthTilesY;
+
+	enum { HIZ_TILE_SIZE_X = 16 };
+	enum { HIZ_TILE_SIZE_Y = 8 };
+
+	// memory tiles are hierarchical Z tiles, so m_numDepthTilesX is also the number of memory tiles per row
+	enum { MEMORY_TILE_SIZE_X = HIZ_TILE_SIZE_X };
+	enum { MEMORY_TILE_SIZE_Y = HIZ_TILE_SIZE_Y };
+	enum { MEMORY_TILE_PIXELS = MEMORY_TILE_SIZE_X * MEMORY_TILE_SIZE_Y };
+
+	// lazy clears: clearing only flags the tiles, the pixels of a tile are written
+	// when it's rendered to for the first time (see PrepareTile()) or at the end of the frame
+	enum ETileFlags
+	{
+		TILE_DEPTH_CLEARED = BIT(0),	// all depth values are the farthest ones (see GetDepthClearValue())
+		TILE_COLOR_CLEARED = BIT(1),	// all pixels have m_clearColor
+		TILE_COLOR_IN_USER_BUFFER = BIT(2),	// tiled layout: the pixels are still in the user's buffer
+		TILE_DEPTH_PLANE = BIT(3),	// depth compression: the depth values are given by m_depthPlanes[iTile], the depth buffer is stale
+	};
+	BYTE *		m_tileFlags;	// [m_numDepthTilesX * m_numDepthTilesY]
+	SoftPixel	m_clearColor;
+
+	// optional depth compression (floating-point depth only): the depth of a tile which is fully covered
+	// by a single triangle is kept as a plane equation and is expanded into the depth buffer
+	// only when the tile is partially covered by another triangle;
+	// cleared tiles are constant planes
+	struct DepthPlane
+	{
+		F4	z0;		// depth of the top-left pixel of the tile
+		F4	dzdx;	// depth increments from pixel to pixel
+		F4	dzdy;
+	};
+	DepthPlane *	m_depthPlanes;	// [m_numDepthTilesX * m_numDepthTilesY], null if depth compression is disabled
+
 public:
 	SoftFrameBuffer();
 	~SoftFrameBuffer();
@@ -17,7 +66,112 @@ public:
 	bool Initialize( UINT width, UINT height, SoftPixel* pixels );
 	void Shutdown();
 
+	// both clears are lazy (see ETileFlags)
 	void ClearDepthOnly();
+	void ClearColor( SoftPixel color );
+
+	// switches between linear and tiled layouts, the contents are preserved
+	void SetTiledLayout( bool bTiled );
+
+	// reallocates the depth buffer, the contents are cleared
+	// (depth compression is disabled for formats other than DepthFormat_F32)
+	void SetDepthFormat( EDepthFormat depthFormat );
+
+	// compressed tiles are expanded when depth compression is disabled
+	void SetDepthCompression( bool bEnable );
+
+	// returns the depth values of the pixels [iX..iX+3] in the row iY of a compressed tile;
+	// all code which reads compressed depth must go through this function, so that the values are always the same
+	static FORCEINLINE __m128 EvaluateDepthPlane_SSE( const DepthPlane& plane, UINT iX, UINT iY )
+	{
+		const __m128 qfX = _mm_add_ps( _mm_set1_ps( (F4)iX ), _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f ) );
+		const __m128 qfZ = _mm_add_ps( _mm_set1_ps( plane.z0 ), _mm_mul_ps( _mm_set1_ps( plane.dzdx ), qfX ) );
+		return _mm_add_ps( qfZ, _mm_mul_ps( _mm_set1_ps( plane.dzdy ), _mm_set1_ps( (F4)iY ) ) );
+	}
+	// writes the depth values of a compressed tile into the given rectangle (the pitch is in pixels)
+	void ExpandDepthPlane( UINT iTile, F4* depth, UINT pitch, UINT numColumns, UINT numRows ) const;
+	// returns the farthest depth value of a compressed tile (hierarchical Z)
+	F4 GetDepthPlaneMax( UINT iTile ) const;
+
+	static FORCEINLINE UINT GetDepthElementSize( EDepthFormat depthFormat )
+	{
+		return (depthFormat == DepthFormat_D16) ? sizeof UINT16 : sizeof UINT32;
+	}
+	// returns the bits of the farthest depth value, repeated to fill 32 bits
+	static FORCEINLINE UINT32 GetDepthClearValue( EDepthFormat depthFormat )
+	{
+		switch( depthFormat )
+		{
+		case DepthFormat_D24 :	return 0x00FFFFFF;
+		case DepthFormat_D16 :	return 0xFFFFFFFF;
+		default:
+			{
+				_flint	u;
+				u.f = SOFT_MAX_DEPTH;
+				return u.u;
+			}
+		}
+	}
+
+	// tiled layout: the user's pixels will be copied into the tiles (at the start of a frame)
+	void SwizzleColor();
+	// writes pending color clears and, in tiled layout, the tiles into the user's pixels (at the end of a frame);
+	// runs in parallel
+	void ResolveColor();
+
+	// writes pending clears of all tiles (for code which doesn't know about tile flags)
+	void ApplyAllTileFlags();
+
+	// must be called before the pixels of the tile are accessed
+	FORCEINLINE void PrepareTile( UINT iTile )
+	{
+		if( m_tileFlags[ iTile ] ) {
+			this->ApplyTileFlags( iTile );
+		}
+	}
+	// same as PrepareTile(), but keeps compressed depth (for the tile rasterizer which tests against depth planes)
+	FORCEINLINE void PrepareTileKeepDepthPlane( UINT iTile )
+	{
+		const UINT flags = m_tileFlags[ iTile ];
+		if( flags & ~TILE_DEPTH_PLANE )
+		{
+			m_tileFlags[ iTile ] = flags & ~TILE_DEPTH_PLANE;
+			this->ApplyTileFlags( iTile );
+			m_tileFlags[ iTile ] = flags & TILE_DEPTH_PLANE;
+		}
+	}
+	FORCEINLINE UINT GetTileIndex( UINT x, UINT y ) const
+	{
+		return (y / MEMORY_TILE_SIZE_Y) * m_numDepthTilesX + (x / MEMORY_TILE_SIZE_X);
+	}
+
+	// returns the address of the pixel in the color buffer being rendered to
+	FORCEINLINE SoftPixel* GetPixelAddress( UINT x, UINT y )
+	{
+		const UINT iTile = GetTileIndex( x, y );
+		this->PrepareTile( iTile );
+
+		if( m_tiledLayout )
+		{
+			return m_tiledColorBuffer + iTile * MEMORY_TILE_PIXELS + (y % MEMORY_TILE_SIZE_Y) * MEMORY_TILE_SIZE_X + (x % MEMORY_TILE_SIZE_X);
+		}
+		return m_colorBuffer + y * m_viewportWidth + x;
+	}
+
+	// writes the pending clears of the tile (or loads its pixels from the user's buffer) and resets its flags
+	void ApplyTileFlags( UINT iTile );
+	// makes the tile visible in the user's buffer
+	void ResolveTile( UINT iTile );
+	// returns the part of the tile inside the viewport
+	void GetTileRect( UINT iTile, UINT &x, UINT &y, UINT &numColumns, UINT &numRows ) const;
+	// copies the user's pixels or depth values between linear and tiled layouts
+	void CopyTiles( void* linear, void* tiled, UINT elementSize, bool bToLinear ) const;
+
+	// size of the depth buffer (rounded up to whole memory tiles)
+	UINT GetNumTiledPixels() const;
+
+	// returns the highest sub-pixel precision at which edge functions cannot overflow in a viewport of the given size
+	static UINT GetSubPixelBits( UINT width, UINT height );
 
 	//void SetPixel( vec4_carg colorRGBA );
 };
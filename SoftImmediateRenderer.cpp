@@ -23,7 +23,15 @@ srImmediateRenderer::srImmediateRenderer()
 	m_projectionMatrix = XMMatrixIdentity();
 
 	m_vertexShader = nil;
+	m_vertexShader4 = nil;
+#if SOFT_RENDER_USE_AVX
+	m_vertexShader8 = nil;
+#endif // SOFT_RENDER_USE_AVX
 	m_pixelShader = nil;
+	m_pixelShader4 = nil;
+#if SOFT_RENDER_USE_AVX
+	m_pixelShader8 = nil;
+#endif // SOFT_RENDER_USE_AVX
 
 	m_cullMode = ECullMode::Cull_CCW;
 	m_fillMode = EFillMode::Fill_Solid;
@@ -61,6 +69,7 @@ srImmediateRenderer::srImmediateRenderer()
 	//m_ftblDrawTriangle[Fill_Solid] = &RasterizeTriangleImmediateColorOnly_SSE<16,16>;
 	//m_ftblDrawTriangle[Fill_Solid] = &RasterizeTriangleImmediateUserShader_SSE<16,4>;
 	m_ftblDrawTriangle[Fill_Solid] = &RasterizeTriangleImmediateUserShader_SSE<16,8>;
+	m_cpuMode = CpuMode_Use_SSE;
 
 	m_ftblDrawTriangle[Fill_Wireframe] = &F_DrawWireframeTriangle;
 }
@@ -100,11 +109,35 @@ void srImmediateRenderer::SetVertexShader( F_VertexShader* newVertexShader )
 	m_vertexShader = newVertexShader;
 }
 
+void srImmediateRenderer::SetVertexShader4( F_VertexShader4* newVertexShader )
+{
+	m_vertexShader4 = newVertexShader;
+}
+
+#if SOFT_RENDER_USE_AVX
+void srImmediateRenderer::SetVertexShader8( F_VertexShader8* newVertexShader )
+{
+	m_vertexShader8 = newVertexShader;
+}
+#endif // SOFT_RENDER_USE_AVX
+
 void srImmediateRenderer::SetPixelShader( F_PixelShader* newPixelShader )
 {
 	m_pixelShader = newPixelShader;
 }
 
+void srImmediateRenderer::SetPixelShader4( F_PixelShader4* newPixelShader )
+{
+	m_pixelShader4 = newPixelShader;
+}
+
+#if SOFT_RENDER_USE_AVX
+void srImmediateRenderer::SetPixelShader8( F_PixelShader8* newPixelShader )
+{
+	m_pixelShader8 = newPixelShader;
+}
+#endif // SOFT_RENDER_USE_AVX
+
 void srImmediateRenderer::SetTexture( SoftTexture2D* newTexture2D )
 {
 	m_texture = newTexture2D;
@@ -132,15 +165,41 @@ void srImmediateRenderer::DrawTriangles( SoftFrameBuffer& frameBuffer, const SVe
 	SoftRenderContext	renderContext;
 	renderContext.globals = &shaderGlobals;
 	renderContext.vertexShader = m_vertexShader;
+	// batch vertex shaders are only used with the selected instruction set (AVX is never selected here)
+	renderContext.vertexShader4 = (m_cpuMode >= CpuMode_Use_SSE) ? m_vertexShader4 : nil;
+#if SOFT_RENDER_USE_AVX
+	renderContext.vertexShader8 = nil;
+#endif // SOFT_RENDER_USE_AVX
 	renderContext.pixelShader = m_pixelShader;
+	renderContext.pixelShader4 = m_pixelShader4;
+#if SOFT_RENDER_USE_AVX
+	renderContext.pixelShader8 = m_pixelShader8;
+#endif // SOFT_RENDER_USE_AVX
+	// the scanline rasterizers only work with linear buffers
+	Assert( !frameBuffer.m_tiledLayout );
+	// the scanline rasterizers know nothing about tiles
+	frameBuffer.ApplyAllTileFlags();
 	renderContext.colorBuffer = frameBuffer.m_colorBuffer;
+	// the scanline rasterizers only work with floating-point depth
+	Assert( frameBuffer.m_depthFormat == DepthFormat_F32 );
 	renderContext.depthBuffer = frameBuffer.m_depthBuffer;
+	renderContext.depthFormat = DepthFormat_F32;
+	renderContext.bTiledLayout = false;
+	// the scanline rasterizers only lower depth values, so hierarchical Z stays conservative without updates
+	renderContext.tileMaxDepth = nil;
+	renderContext.numDepthTilesX = 0;
+	renderContext.frameBuffer = nil;
 	renderContext.userPointer = nil;
+	renderContext.stats = &SoftRenderer::stats;
 
 	renderContext.W = frameBuffer.m_viewportWidth;
 	renderContext.H = frameBuffer.m_viewportHeight;
 	renderContext.W2 = frameBuffer.m_viewportWidth * 0.5f;
 	renderContext.H2 = frameBuffer.m_viewportHeight * 0.5f;
+	renderContext.subPixelBits = frameBuffer.m_subPixelBits;
+
+	// shade all vertices in advance if a SIMD vertex shader is available
+	renderContext.transformedVertices = m_transformedVertices.TransformVertices( vertices, numVertices, renderContext );
 
 
 
@@ -149,4 +208,24 @@ void srImmediateRenderer::DrawTriangles( SoftFrameBuffer& frameBuffer, const SVe
 	(*m_ftblProcessTriangles[m_fillMode][m_cullMode])( drawTriangleFunction, vertices, numVertices, indices, numIndices, renderContext );
 }
 
+void srImmediateRenderer::ModifySettings( const Settings& newSettings )
+{
+	// there are no AVX versions of the immediate rasterizer, SSE is used instead
+	if( newSettings.mode == CpuMode_Use_FPU )
+	{
+		m_ftblDrawTriangle[Fill_Solid] = &F_DrawSolidTriangle;
+		m_cpuMode = CpuMode_Use_FPU;
+	}
+	else
+	{
+		m_ftblDrawTriangle[Fill_Solid] = &RasterizeTriangleImmediateUserShader_SSE<16,8>;
+		m_cpuMode = CpuMode_Use_SSE;
+	}
+}
+
+ECpuMode srImmediateRenderer::GetCpuMode() const
+{
+	return m_cpuMode;
+}
+
 }//namespace SoftRenderer
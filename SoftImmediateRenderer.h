@@ -15,7 +15,15 @@ class srImmediateRenderer : public ATriangleRenderer
 	float4x4	m_projectionMatrix;
 
 	F_VertexShader *	m_vertexShader;
+	F_VertexShader4 *	m_vertexShader4;
+#if SOFT_RENDER_USE_AVX
+	F_VertexShader8 *	m_vertexShader8;
+#endif // SOFT_RENDER_USE_AVX
 	F_PixelShader *		m_pixelShader;
+	F_PixelShader4 *	m_pixelShader4;
+#if SOFT_RENDER_USE_AVX
+	F_PixelShader8 *	m_pixelShader8;
+#endif // SOFT_RENDER_USE_AVX
 
 	ECullMode	m_cullMode;
 	EFillMode	m_fillMode;
@@ -24,6 +32,10 @@ class srImmediateRenderer : public ATriangleRenderer
 
 	F_RenderTriangles *			m_ftblProcessTriangles[Fill_MAX][Cull_MAX];
 	F_RenderSingleTriangle *	m_ftblDrawTriangle[Fill_MAX];
+	ECpuMode					m_cpuMode;	// instruction set used by the triangle rasterizer
+
+	// vertices of the current draw call shaded by SIMD vertex shaders
+	srTransformedVertexBuffer	m_transformedVertices;
 
 public:
 	srImmediateRenderer();
@@ -37,11 +49,22 @@ public:
 	void SetFillMode( EFillMode newFillMode ) override;
 
 	void SetVertexShader( F_VertexShader* newVertexShader ) override;
+	void SetVertexShader4( F_VertexShader4* newVertexShader ) override;
+#if SOFT_RENDER_USE_AVX
+	void SetVertexShader8( F_VertexShader8* newVertexShader ) override;
+#endif // SOFT_RENDER_USE_AVX
 	void SetPixelShader( F_PixelShader* newPixelShader ) override;
+	void SetPixelShader4( F_PixelShader4* newPixelShader ) override;
+#if SOFT_RENDER_USE_AVX
+	void SetPixelShader8( F_PixelShader8* newPixelShader ) override;
+#endif // SOFT_RENDER_USE_AVX
 
 	void SetTexture( SoftTexture2D* newTexture2D ) override;
 
 	void DrawTriangles( SoftFrameBuffer& frameBuffer, const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numIndices ) override;
+
+	void ModifySettings( const Settings& newSettings ) override;
+	ECpuMode GetCpuMode() const override;
 };
 
 }//namespace SoftRenderer
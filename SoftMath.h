@@ -102,3 +102,77 @@ void ComputeGradient_FPU(
 	dx = -A/C;
 	dy = -B/C;
 }
+
+// computes gradients of four interpolated parameters at once (one triangle per lane), see ComputeGradient_FPU()
+static FORCEINLINE
+void ComputeGradient_SSE(
+						 const __m128 C,
+						 const __m128 di21, const __m128 di31,	// deltas of interpolated parameter
+						 const __m128 dx21, const __m128 dx31,
+						 const __m128 dy21, const __m128 dy31,
+						 __m128 & dx, __m128 & dy
+						 )
+{
+	const __m128 A = _mm_sub_ps( _mm_mul_ps( di31, dy21 ), _mm_mul_ps( di21, dy31 ) );
+	const __m128 B = _mm_sub_ps( _mm_mul_ps( dx31, di21 ), _mm_mul_ps( dx21, di31 ) );
+
+	// flip the sign bit to negate
+	const __m128 qfSignBit = _mm_set1_ps( -0.0f );
+	dx = _mm_div_ps( _mm_xor_ps( A, qfSignBit ), C );
+	dy = _mm_div_ps( _mm_xor_ps( B, qfSignBit ), C );
+}
+
+#if SOFT_RENDER_USE_AVX
+
+// computes gradients of eight interpolated parameters at once (one triangle per lane), see ComputeGradient_FPU()
+static FORCEINLINE
+void ComputeGradient_AVX(
+						 const __m256 C,
+						 const __m256 di21, const __m256 di31,	// deltas of interpolated parameter
+						 const __m256 dx21, const __m256 dx31,
+						 const __m256 dy21, const __m256 dy31,
+						 __m256 & dx, __m256 & dy
+						 )
+{
+	const __m256 A = _mm256_sub_ps( _mm256_mul_ps( di31, dy21 ), _mm256_mul_ps( di21, dy31 ) );
+	const __m256 B = _mm256_sub_ps( _mm256_mul_ps( dx31, di21 ), _mm256_mul_ps( dx21, di31 ) );
+
+	// flip the sign bit to negate
+	const __m256 qfSignBit = _mm256_set1_ps( -0.0f );
+	dx = _mm256_div_ps( _mm256_xor_ps( A, qfSignBit ), C );
+	dy = _mm256_div_ps( _mm256_xor_ps( B, qfSignBit ), C );
+}
+
+// transposes an 8x8 matrix of floats (converts 8 structures of 8 floats between AoS and SoA layouts)
+static FORCEINLINE
+void Transpose8x8_AVX( __m256 (&r)[8] )
+{
+	const __m256 t0 = _mm256_unpacklo_ps( r[0], r[1] );
+	const __m256 t1 = _mm256_unpackhi_ps( r[0], r[1] );
+	const __m256 t2 = _mm256_unpacklo_ps( r[2], r[3] );
+	const __m256 t3 = _mm256_unpackhi_ps( r[2], r[3] );
+	const __m256 t4 = _mm256_unpacklo_ps( r[4], r[5] );
+	const __m256 t5 = _mm256_unpackhi_ps( r[4], r[5] );
+	const __m256 t6 = _mm256_unpacklo_ps( r[6], r[7] );
+	const __m256 t7 = _mm256_unpackhi_ps( r[6], r[7] );
+
+	const __m256 s0 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(1,0,1,0) );
+	const __m256 s1 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(3,2,3,2) );
+	const __m256 s2 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE(1,0,1,0) );
+	const __m256 s3 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE(3,2,3,2) );
+	const __m256 s4 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE(1,0,1,0) );
+	const __m256 s5 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE(3,2,3,2) );
+	const __m256 s6 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE(1,0,1,0) );
+	const __m256 s7 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE(3,2,3,2) );
+
+	r[0] = _mm256_permute2f128_ps( s0, s4, 0x20 );
+	r[1] = _mm256_permute2f128_ps( s1, s5, 0x20 );
+	r[2] = _mm256_permute2f128_ps( s2, s6, 0x20 );
+	r[3] = _mm256_permute2f128_ps( s3, s7, 0x20 );
+	r[4] = _mm256_permute2f128_ps( s0, s4, 0x31 );
+	r[5] = _mm256_permute2f128_ps( s1, s5, 0x31 );
+	r[6] = _mm256_permute2f128_ps( s2, s6, 0x31 );
+	r[7] = _mm256_permute2f128_ps( s3, s7, 0x31 );
+}
+
+#endif // SOFT_RENDER_USE_AVX
@@ -0,0 +1,35 @@
+#include "SoftRender_PCH.h"
+#pragma hdrstop
+#include "SoftRender.h"
+#include "SoftRender_Internal.h"
+
+namespace SoftRenderer
+{
+
+//-------------------------------------------------------------------
+//	SSE
+//-------------------------------------------------------------------
+
+__m128i PixelShader4_Texture_Point( const ShaderGlobals& globals, const SPixel4& inputs )
+{
+	return globals.texture->Sample_Point_Wrap4( inputs.vars[0], inputs.vars[1] );
+}
+
+//-------------------------------------------------------------------
+//	AVX
+//-------------------------------------------------------------------
+
+#if SOFT_RENDER_USE_AVX
+
+__m256i PixelShader8_Texture_Point( const ShaderGlobals& globals, const SPixel8& inputs )
+{
+	return globals.texture->Sample_Point_Wrap8( inputs.vars[0], inputs.vars[1] );
+}
+
+#endif // SOFT_RENDER_USE_AVX
+
+}//namespace SoftRenderer
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -3,6 +3,8 @@
 
 #include <Base/JobSystem/ThreadPool.h>
 
+#include <intrin.h>	// __cpuid, _xgetbv
+
 #include "SoftRender.h"
 #include "SoftFrameBuffer.h"
 #include "SoftRender_Internal.h"
@@ -34,6 +36,7 @@ namespace SoftRenderer
 	static bool	bFrameStarted;
 
 	Stats	stats;
+	CpuFeatures	gCpuFeatures;
 	bool	bDbg_DrawBlockBounds = false;
 	bool	bDbg_EnableThreading = true;
 
@@ -51,6 +54,9 @@ bool Initialize( const InitArgs& initArgs )
 	DEVOUT("\tsizeof(XVertex) = %u bytes:\n", sizeof XVertex);
 	DEVOUT("\tsizeof(XTriangle) = %u bytes:\n", sizeof XTriangle);
 
+	gCpuFeatures.Detect();
+	DEVOUT("\tAVX: %s, AVX2: %s, AVX-512: %s\n", gCpuFeatures.bAVX ? "yes" : "no", gCpuFeatures.bAVX2 ? "yes" : "no", gCpuFeatures.bAVX512 ? "yes" : "no");
+
 	gPtr.ConstructInPlace();
 
 	gPtr->m_frameBuffer.Initialize( initArgs.width, initArgs.height, initArgs.rgba );
@@ -80,7 +86,6 @@ bool Initialize( const InitArgs& initArgs )
 
 void ModifySettings( const Settings& newSettings )
 {
-	mxUNDONE;
 	//if( newSettings.bImmediateRasterization )
 	//{
 	//	gPtr->m_currentRenderer = &gPtr->m_immediateRenderer;
@@ -89,7 +94,50 @@ void ModifySettings( const Settings& newSettings )
 	//{
 	//	gPtr->m_currentRenderer = &gPtr->m_tileRenderer;
 	//}
-	settings = newSettings;
+	Settings	validSettings = newSettings;
+	validSettings.mode = gCpuFeatures.ClampCpuMode( newSettings.mode );
+#if SOFT_RENDER_USE_IMMEDIATE_RASTERIZATION
+	// the scanline rasterizers only work with a linear framebuffer and floating-point depth
+	validSettings.bTiledFrameBuffer = false;
+	validSettings.depthFormat = DepthFormat_F32;
+	validSettings.bDepthCompression = false;
+#endif
+	// only floating-point depth can be compressed
+	if( validSettings.depthFormat != DepthFormat_F32 ) {
+		validSettings.bDepthCompression = false;
+	}
+
+	gPtr->m_currentRenderer->ModifySettings( validSettings );
+
+	if( gPtr->m_frameBuffer.m_tiledLayout != validSettings.bTiledFrameBuffer )
+	{
+		// binned triangles must be rasterized with the layout they were binned for
+		gPtr->m_currentRenderer->Flush();
+		gPtr->m_frameBuffer.SetTiledLayout( validSettings.bTiledFrameBuffer );
+	}
+
+	if( gPtr->m_frameBuffer.m_depthFormat != validSettings.depthFormat )
+	{
+		// binned triangles must be rasterized into the depth buffer they were binned for
+		gPtr->m_currentRenderer->Flush();
+		gPtr->m_frameBuffer.SetDepthFormat( validSettings.depthFormat );
+	}
+
+	if( (gPtr->m_frameBuffer.m_depthPlanes != nil) != validSettings.bDepthCompression )
+	{
+		gPtr->m_currentRenderer->Flush();
+		gPtr->m_frameBuffer.SetDepthCompression( validSettings.bDepthCompression );
+	}
+
+	// the renderer may have no kernels for the selected instruction set
+	validSettings.mode = gPtr->m_currentRenderer->GetCpuMode();
+
+	if( validSettings.mode != settings.mode ) {
+		DEVOUT("SoftRender: using %s kernels (requested: %s)\n",
+			ECpuMode_To_Chars( validSettings.mode ), ECpuMode_To_Chars( newSettings.mode ));
+	}
+
+	settings = validSettings;
 }
 
 void Shutdown()
@@ -121,6 +169,9 @@ void BeginFrame()
 	stats.Reset();
 
 	gPtr->m_frameBuffer.ClearDepthOnly();
+
+	// the frame is drawn over the user's pixels
+	gPtr->m_frameBuffer.SwizzleColor();
 }
 
 void EndFrame()
@@ -129,9 +180,21 @@ void EndFrame()
 	
 	gPtr->m_currentRenderer->Flush();
 
+	gPtr->m_frameBuffer.ResolveColor();
+
 	bFrameStarted = false;
 }
 
+void ClearColor( SoftPixel color )
+{
+	Assert(bFrameStarted);
+
+	// triangles drawn before the clear must not be rasterized after it
+	gPtr->m_currentRenderer->Flush();
+
+	gPtr->m_frameBuffer.ClearColor( color );
+}
+
 void SetWorldMatrix( const float4x4& newWorldMatrix )
 {
 	gPtr->m_currentRenderer->SetWorldMatrix( newWorldMatrix );
@@ -162,11 +225,35 @@ void SetVertexShader( F_VertexShader* newVertexShader )
 	gPtr->m_currentRenderer->SetVertexShader( newVertexShader );
 }
 
+void SetVertexShader4( F_VertexShader4* newVertexShader )
+{
+	gPtr->m_currentRenderer->SetVertexShader4( newVertexShader );
+}
+
+#if SOFT_RENDER_USE_AVX
+void SetVertexShader8( F_VertexShader8* newVertexShader )
+{
+	gPtr->m_currentRenderer->SetVertexShader8( newVertexShader );
+}
+#endif // SOFT_RENDER_USE_AVX
+
 void SetPixelShader( F_PixelShader* newPixelShader )
 {
 	gPtr->m_currentRenderer->SetPixelShader( newPixelShader );
 }
 
+void SetPixelShader4( F_PixelShader4* newPixelShader )
+{
+	gPtr->m_currentRenderer->SetPixelShader4( newPixelShader );
+}
+
+#if SOFT_RENDER_USE_AVX
+void SetPixelShader8( F_PixelShader8* newPixelShader )
+{
+	gPtr->m_currentRenderer->SetPixelShader8( newPixelShader );
+}
+#endif // SOFT_RENDER_USE_AVX
+
 void SetTexture( SoftTexture2D* newTexture2D )
 {
 	gPtr->m_currentRenderer->SetTexture( newTexture2D );
@@ -193,6 +280,11 @@ SoftPixel* GetColorBuffer()
 	return gPtr->m_frameBuffer.m_colorBuffer;
 }
 
+SoftPixel* GetPixelAddress( UINT x, UINT y )
+{
+	return gPtr->m_frameBuffer.GetPixelAddress( x, y );
+}
+
 ThreadPool& GetThreadPool()
 {
 	return gPtr->m_threadPool;
@@ -200,9 +292,70 @@ ThreadPool& GetThreadPool()
 
 }//namespace SoftRenderer
 
+void SoftRenderer::CpuFeatures::Detect()
+{
+	bAVX = false;
+	bAVX2 = false;
+	bAVX512 = false;
+
+#if SOFT_RENDER_USE_AVX
+	int cpuInfo[4];	// EAX, EBX, ECX, EDX
+	__cpuid( cpuInfo, 0 );
+	const int maxFunctionId = cpuInfo[0];
+
+	__cpuid( cpuInfo, 1 );
+
+	const bool bOSXSAVE = (cpuInfo[2] & (1 << 27)) != 0;
+	const bool bCpuAVX = (cpuInfo[2] & (1 << 28)) != 0;
+
+	// the OS must save and restore XMM and YMM registers on context switches
+	UINT64 XCR0 = 0;
+	if( bOSXSAVE && bCpuAVX )
+	{
+		XCR0 = _xgetbv( 0 );
+		bAVX = (XCR0 & 0x6) == 0x6;
+	}
+
+	// extended features
+	if( bAVX && maxFunctionId >= 7 )
+	{
+		__cpuidex( cpuInfo, 7, 0 );
+		bAVX2 = (cpuInfo[1] & (1 << 5)) != 0;
+
+		// AVX-512 Foundation and OS support for saving opmask and ZMM registers
+		const bool bCpuAVX512F = (cpuInfo[1] & (1 << 16)) != 0;
+		bAVX512 = bAVX2 && bCpuAVX512F && (XCR0 & 0xE0) == 0xE0;
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+#if !SOFT_RENDER_USE_AVX512
+	bAVX512 = false;	// the kernels were not compiled in
+#endif // !SOFT_RENDER_USE_AVX512
+}
+
+ECpuMode SoftRenderer::CpuFeatures::ClampCpuMode( ECpuMode requestedMode ) const
+{
+	ECpuMode	mode = smallest( requestedMode, CpuMode_Use_AVX512 );
+
+	if( mode == CpuMode_Use_AVX512 && !bAVX512 ) {
+		mode = CpuMode_Use_AVX;
+	}
+	if( mode == CpuMode_Use_AVX && !bAVX2 ) {
+		mode = CpuMode_Use_SSE;
+	}
+	// SSE2 is always available on x86-64 (and assumed on x86)
+	return mode;
+}
+
 SoftRenderer::Settings::Settings()
 {
-	mode = CpuMode_Use_FPU;
+	mode = CpuMode_MAX;
+	bDeferredRasterization = true;
+	bCoverageMasks = false;
+	bNonTemporalStores = false;
+	bTiledFrameBuffer = false;
+	depthFormat = DepthFormat_F32;
+	bDepthCompression = false;
 }
 
 SoftRenderer::InitArgs::InitArgs()
@@ -225,6 +378,13 @@ void SoftRenderer::Stats::Reset()
 	numTrianglesRendered = 0;
 	numVertices = 0;
 	numIndices = 0;
+	numVertexCacheHits = 0;
+	numVertexCacheMisses = 0;
+	numBinnedTiles = 0;
+	maxBinnedTiles = 0;
+	numTileBlocks = 0;
+	numOccludedTiles = 0;
+	numSmallTriangles = 0;
 }
 
 const char* ECullMode_To_Chars( ECullMode cullMode )
@@ -245,7 +405,21 @@ const char* ECpuMode_To_Chars( ECpuMode cpuMode )
 	{
 	case CpuMode_Use_FPU :	return "FPU";
 	case CpuMode_Use_SSE :	return "SSE";
-	//case CpuMode_Use_AVX :	return "AVX";
+	case CpuMode_Use_AVX :	return "AVX2";
+	case CpuMode_Use_AVX512 :	return "AVX-512";
+	case CpuMode_MAX :	return "Best";
+	default:	Unreachable;
+	}
+	return "?";
+}
+
+const char* EDepthFormat_To_Chars( EDepthFormat depthFormat )
+{
+	switch( depthFormat )
+	{
+	case DepthFormat_F32 :	return "F32";
+	case DepthFormat_D24 :	return "D24";
+	case DepthFormat_D16 :	return "D16";
 	default:	Unreachable;
 	}
 	return "?";
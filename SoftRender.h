@@ -15,6 +15,14 @@ class ThreadPool;
 // use SIMD instructions
 #define SOFT_RENDER_USE_SSE		(1)
 
+// compile 256-bit AVX code paths (selected at run time, if supported by the CPU);
+// needs Visual Studio 2010 SP1 or newer
+#define SOFT_RENDER_USE_AVX		(1)
+
+// compile 512-bit AVX-512 code paths (selected at run time, if supported by the CPU);
+// needs Visual Studio 2017 or newer
+#define SOFT_RENDER_USE_AVX512	(SOFT_RENDER_USE_AVX)
+
 // use multiple threads
 #define SOFT_RENDER_ASYNC_JOBS	(1)
 
@@ -24,8 +32,19 @@ class ThreadPool;
 // 1 - transform,clip and rasterize triangles immediately, without buffering.
 #define SOFT_RENDER_USE_IMMEDIATE_RASTERIZATION		(0)
 
-enum { SOFT_RENDER_MAX_WINDOW_WIDTH = 2048 };
-enum { SOFT_RENDER_MAX_WINDOW_HEIGHT = 1024 };
+#if SOFT_RENDER_USE_AVX
+	#include <immintrin.h>
+#endif // SOFT_RENDER_USE_AVX
+
+enum { SOFT_RENDER_MAX_WINDOW_WIDTH = 8192 };
+enum { SOFT_RENDER_MAX_WINDOW_HEIGHT = 8192 };
+
+// screen-space vertex positions are snapped to fixed-point with a few bits of sub-pixel precision;
+// edge functions are products of two fixed-point coordinates and must fit into 32 bits,
+// so the precision is chosen by the viewport size:
+// 4 bits up to 2048x2048 (28.4), 3 bits up to 4096x4096 (28.3), 2 bits up to 8192x8192 (28.2)
+enum { SOFT_RENDER_MAX_SUBPIXEL_BITS = 4 };
+enum { SOFT_RENDER_MIN_SUBPIXEL_BITS = 2 };
 
 
 //-------------------------------------------------------------------
@@ -52,59 +71,29 @@ enum { SOFT_STRIDE = sizeof SoftPixel };
 
 
 
-#if 1
-
-	#define SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER	(1)
-
-	// floating-point depth buffer
-	typedef F4 ZBufElem;
-
-	//#define SOFT_MAX_DEPTH	1.0f
-	#define SOFT_MAX_DEPTH	9999999.0f
-
-	static FORCEINLINE
-	ZBufElem FloatDepthToZBufferValue( FLOAT depth )
-	{
-		return depth;
-	}
-
-#elif 0
-
-	#define SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER	(0)
-
-	// unsigned shorts
-	typedef UINT16 ZBufElem;
-
-	#define SOFT_MAX_DEPTH	MAX_UINT16
-
-	static FORCEINLINE
-	ZBufElem FloatDepthToZBufferValue( FLOAT depth )
-	{
-		// [0.f..1.f] -> [0..MAX_UINT16]
-		//const F4 bias = 0.01f;	// because depth can be slightly negative -> artifacts
-		depth = mxFabs(depth);
-		Assert( depth > 0.0f );
-		Assert( depth < 1.0f );
-		return (UINT)asmFloatToInt( depth * 65535.0f );
-	}
-
-#else
-
-	#define SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER	(0)
-
-	// signed shorts
-	typedef INT16 ZBufElem;
+// formats of depth buffers, selected at run time (see Settings::depthFormat);
+// the rasterizer interpolates floating-point depth and converts it into the format of the buffer
+enum EDepthFormat
+{
+	DepthFormat_F32,	// 32-bit floating-point
+	DepthFormat_D24,	// 24-bit unsigned normalized [0..1] (stored in 32 bits)
+	DepthFormat_D16,	// 16-bit unsigned normalized [0..1], halves depth bandwidth (e.g. for depth-only and shadow passes)
+	DepthFormat_MAX
+};
+const char* EDepthFormat_To_Chars( EDepthFormat depthFormat );
 
-	#define SOFT_MAX_DEPTH	MAX_INT16
+// element of floating-point depth buffers
+typedef F4 ZBufElem;
 
-	static FORCEINLINE
-	ZBufElem FloatDepthToZBufferValue( FLOAT depth )
-	{
-		// [0.f..1.f] -> [0..MAX_INT16]
-		return (UINT)asmFloatToInt( depth * 32767.0f );
-	}
+// clear value of floating-point depth buffers
+//#define SOFT_MAX_DEPTH	1.0f
+#define SOFT_MAX_DEPTH	9999999.0f
 
-#endif
+static FORCEINLINE
+ZBufElem FloatDepthToZBufferValue( FLOAT depth )
+{
+	return depth;
+}
 
 
 
@@ -202,6 +191,76 @@ typedef void F_VertexShader( const VS_INPUT& inputs, VS_OUTPUT &outputs );
 typedef void F_PixelShader( SPixelShaderParameters & args );
 
 
+// SIMD vertex shaders process batches of vertices in SoA layout:
+// each register holds the same component of 4 (or 8) different vertices.
+
+// 4 input vertices (app to vertex shader)
+mxSIMDALIGNED struct SVertex4
+{
+	__m128		position[3];	// x,y,z
+	__m128		normal[3];		// x,y,z
+	__m128		texCoord[2];	// u,v
+};
+
+// 4 transformed vertices (vertex shader -> pixel shader interpolants)
+mxSIMDALIGNED struct XVertex4
+{
+	__m128		P[4];	// x,y,z,w
+	__m128		vars[ NUM_VARYINGS ];
+};
+
+typedef void F_VertexShader4( const ShaderGlobals& globals, const SVertex4& inputs, XVertex4 &outputs );
+
+#if SOFT_RENDER_USE_AVX
+
+// 8 input vertices (app to vertex shader)
+struct SVertex8
+{
+	__m256		position[3];	// x,y,z
+	__m256		normal[3];		// x,y,z
+	__m256		texCoord[2];	// u,v
+};
+
+// 8 transformed vertices (vertex shader -> pixel shader interpolants)
+struct XVertex8
+{
+	__m256		P[4];	// x,y,z,w
+	__m256		vars[ NUM_VARYINGS ];
+};
+
+typedef void F_VertexShader8( const ShaderGlobals& globals, const SVertex8& inputs, XVertex8 &outputs );
+
+#endif // SOFT_RENDER_USE_AVX
+
+
+// SIMD pixel shaders process horizontal rows of 4 (or 8) pixels in SoA layout
+// and return packed ARGB32 colors of all pixels; only colors of covered pixels are written.
+
+// 4 pixels (interpolants -> pixel shader)
+mxSIMDALIGNED struct SPixel4
+{
+	__m128		vars[ NUM_VARYINGS ];	// perspectively-correct interpolated parameters
+	__m128		depth;	// interpolated depth
+	__m128i		mask;	// coverage mask (all bits set in lanes of covered pixels)
+};
+
+typedef __m128i F_PixelShader4( const ShaderGlobals& globals, const SPixel4& inputs );
+
+#if SOFT_RENDER_USE_AVX
+
+// 8 pixels (interpolants -> pixel shader)
+struct SPixel8
+{
+	__m256		vars[ NUM_VARYINGS ];	// perspectively-correct interpolated parameters
+	__m256		depth;	// interpolated depth
+	__m256i		mask;	// coverage mask (all bits set in lanes of covered pixels)
+};
+
+typedef __m256i F_PixelShader8( const ShaderGlobals& globals, const SPixel8& inputs );
+
+#endif // SOFT_RENDER_USE_AVX
+
+
 
 
 
@@ -237,7 +296,8 @@ enum ECpuMode
 {
 	CpuMode_Use_FPU,
 	CpuMode_Use_SSE,
-	//CpuMode_Use_AVX,
+	CpuMode_Use_AVX,	// AVX2
+	CpuMode_Use_AVX512,
 	CpuMode_MAX
 };
 const char* ECpuMode_To_Chars( ECpuMode cpuMode );
@@ -247,8 +307,37 @@ namespace SoftRenderer
 {
 	struct Settings
 	{
+		// instruction set used by the rasterizer;
+		// CpuMode_MAX selects the best one supported by the CPU,
+		// lower modes can be forced (e.g. for benchmarking)
+		// and are clamped to the ones supported by the CPU
 		ECpuMode	mode;
 
+		// bin triangles of all draw calls between BeginFrame() and EndFrame()
+		// and rasterize them once, at the end of the frame
+		// (otherwise triangles are rasterized at the end of each draw call)
+		bool		bDeferredRasterization;
+
+		// rasterize partially covered tiles by building 64-bit coverage masks of 8x8 blocks
+		// and shading only their non-empty rows and quads
+		// (instead of stepping edge functions across the whole tile; FPU kernels ignore it)
+		bool		bCoverageMasks;
+
+		// write screen tiles back to the framebuffer with non-temporal (streaming) stores,
+		// saves memory bandwidth at high resolutions
+		bool		bNonTemporalStores;
+
+		// store color and depth tile by tile, so that the tile rasterizer walks memory linearly;
+		// the user's pixels are copied into the tiles in BeginFrame() and back in EndFrame()
+		bool		bTiledFrameBuffer;
+
+		// format of the depth buffer; changing it discards the contents of the depth buffer
+		EDepthFormat	depthFormat;
+
+		// keep the depth of screen tiles which are fully covered by a single triangle as plane equations,
+		// depth tests against such tiles don't touch the depth buffer (only with DepthFormat_F32)
+		bool		bDepthCompression;
+
 	public:
 		Settings();
 	};
@@ -276,6 +365,10 @@ namespace SoftRenderer
 	void BeginFrame();
 	void EndFrame();
 
+	// fills the color buffer with the given color (between BeginFrame() and EndFrame());
+	// tiles are filled only when they are drawn to or at the end of the frame
+	void ClearColor( SoftPixel color );
+
 	void SetWorldMatrix( const float4x4& newWorldMatrix );
 	void SetViewMatrix( const float4x4& newViewMatrix );
 	void SetProjectionMatrix( const float4x4& newProjectionMatrix );
@@ -283,8 +376,22 @@ namespace SoftRenderer
 	void SetCullMode( ECullMode newCullMode );
 	void SetFillMode( EFillMode newFillMode );
 
+	// the scalar vertex shader must always be set, SIMD vertex shaders are optional (can be null);
+	// if a SIMD version is set, all vertices of a draw call are shaded with it in batches
 	void SetVertexShader( F_VertexShader* newVertexShader );
+	void SetVertexShader4( F_VertexShader4* newVertexShader );
+#if SOFT_RENDER_USE_AVX
+	// ignored if the CPU doesn't support AVX
+	void SetVertexShader8( F_VertexShader8* newVertexShader );
+#endif // SOFT_RENDER_USE_AVX
+	// the scalar pixel shader must always be set, SIMD pixel shaders are optional (can be null);
+	// if a SIMD version is set, the tile renderer calls it once per row of 4 (or 8) pixels
 	void SetPixelShader( F_PixelShader* newPixelShader );
+	void SetPixelShader4( F_PixelShader4* newPixelShader );
+#if SOFT_RENDER_USE_AVX
+	// used only by the AVX2 and AVX-512 rasterization kernels
+	void SetPixelShader8( F_PixelShader8* newPixelShader );
+#endif // SOFT_RENDER_USE_AVX
 
 	void SetTexture( SoftTexture2D* newTexture2D );
 
@@ -301,14 +408,45 @@ namespace SoftRenderer
 	void GetViewportSize( UINT &W, UINT &H );
 	SoftPixel* GetColorBuffer();
 
+	// returns the address of the pixel in the color buffer being rendered to
+	// (not in the user's buffer if Settings::bTiledFrameBuffer is set)
+	SoftPixel* GetPixelAddress( UINT x, UINT y );
+
 	ThreadPool& GetThreadPool();
 
+	// built-in SIMD vertex shaders:
+	// transform positions by the world-view-projection matrix
+	// and pass texture coordinates through (in vars[0] and vars[1])
+	void VertexShader4_WVP_TexCoords( const ShaderGlobals& globals, const SVertex4& inputs, XVertex4 &outputs );
+#if SOFT_RENDER_USE_AVX
+	void VertexShader8_WVP_TexCoords( const ShaderGlobals& globals, const SVertex8& inputs, XVertex8 &outputs );
+#endif // SOFT_RENDER_USE_AVX
+
+	// built-in SIMD pixel shaders:
+	// sample globals.texture (point filtering, wrap addressing)
+	// at texture coordinates in vars[0] and vars[1] (globals.texture must be set)
+	__m128i PixelShader4_Texture_Point( const ShaderGlobals& globals, const SPixel4& inputs );
+#if SOFT_RENDER_USE_AVX
+	__m256i PixelShader8_Texture_Point( const ShaderGlobals& globals, const SPixel8& inputs );
+#endif // SOFT_RENDER_USE_AVX
+
 	struct Stats
 	{
 		UINT	numTrianglesRendered;
 		UINT	numVertices;
 		UINT	numIndices;
 
+		// post-transform vertex cache
+		UINT	numVertexCacheHits;
+		UINT	numVertexCacheMisses;	// number of vertex shader invocations
+
+		// tile binning
+		UINT	numBinnedTiles;	// total number of triangle tiles rasterized
+		UINT	maxBinnedTiles;	// high-water mark: max. number of tiles binned between two flushes
+		UINT	numTileBlocks;	// number of tile blocks allocated by the tile renderer
+		UINT	numOccludedTiles;	// number of triangle tiles rejected by hierarchical Z before rasterization
+		UINT	numSmallTriangles;	// number of triangles binned into a single tile without edge tests
+
 	public:
 		void Reset();
 	};
@@ -327,6 +465,7 @@ class SoftTexture2D
 {
 	// Texture resolution - hardcoded for speed
 	enum { SIZE_X = 64 };
+	enum { SIZE_X_LOG2 = 6 };
 	enum { SIZE_Y = 64 };
 
 	TSmallList< ARGB32 >	m_data;
@@ -341,6 +480,12 @@ public:
 	void Clear();
 
 	ARGB32 Sample_Point_Wrap( F4 u, F4 v ) const;
+
+	// sample 4 (or 8) texels at once
+	__m128i Sample_Point_Wrap4( const __m128& u, const __m128& v ) const;
+#if SOFT_RENDER_USE_AVX
+	__m256i Sample_Point_Wrap8( const __m256& u, const __m256& v ) const;	// AVX2
+#endif // SOFT_RENDER_USE_AVX
 };
 
 
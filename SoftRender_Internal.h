@@ -13,25 +13,63 @@ struct SoftRenderContext
 {
 	const ShaderGlobals *	globals;
 	F_VertexShader *		vertexShader;
+	F_VertexShader4 *		vertexShader4;	// can be null
+#if SOFT_RENDER_USE_AVX
+	F_VertexShader8 *		vertexShader8;	// can be null
+#endif // SOFT_RENDER_USE_AVX
 	F_PixelShader *			pixelShader;
+	F_PixelShader4 *		pixelShader4;	// can be null
+#if SOFT_RENDER_USE_AVX
+	F_PixelShader8 *		pixelShader8;	// can be null
+#endif // SOFT_RENDER_USE_AVX
+
+	// vertices of the current draw call shaded in advance by a SIMD vertex shader
+	// (null if they must be shaded one by one);
+	// valid only while the draw call is being processed
+	const XVertex *			transformedVertices;
 	SoftPixel *				colorBuffer;
-	ZBufElem *				depthBuffer;
+	void *					depthBuffer;	// elements of depthFormat
+	EDepthFormat			depthFormat;
+	bool					bTiledLayout;	// color and depth buffers are stored tile by tile, see SoftFrameBuffer
+	F4 *					tileMaxDepth;	// hierarchical Z, see SoftFrameBuffer (null if not maintained)
+	U4						numDepthTilesX;	// row pitch of tileMaxDepth
+	SoftFrameBuffer *		frameBuffer;	// owner of the buffers with per-tile clear flags (null if the buffers are always up to date)
 	void *					userPointer;
+	SoftRenderer::Stats *	stats;	// statistics of the thread processing triangles
 
 	// for viewport transform
 	U4	W;	// screen width
 	U4	H;	// screen height
 	F4	W2;	// half viewport width
 	F4	H2;	// half viewport height
+
+	U4	subPixelBits;	// precision of fixed-point screen coordinates (depends on viewport size)
 };
 
 
 namespace SoftRenderer
 {
 
+// instruction sets supported by the host CPU
+struct CpuFeatures
+{
+	bool	bAVX;	// AVX instructions and OS support for saving YMM registers
+	bool	bAVX2;	// 256-bit integer instructions
+	bool	bAVX512;	// AVX-512 Foundation and OS support for saving ZMM registers
+
+public:
+	// queries the CPU, called once at startup
+	void Detect();
+
+	// returns the given mode or the best lower one which can be used on this CPU
+	ECpuMode ClampCpuMode( ECpuMode requestedMode ) const;
+};
+
+extern CpuFeatures	gCpuFeatures;
+
 
 // size of post transform cache
-//enum { VERTEX_CACHE_SIZE = 32 };
+enum { VERTEX_CACHE_SIZE = 32 };	//<= must be a power of two
 
 // an intermediate vertex buffer for transformed primitives;
 // it contains both vertex and face info for the primitives;
@@ -43,9 +81,12 @@ enum { MAX_BATCHED_VERTICES = (1<<12) };
 //enum { VERTEX_BUFFER_SIZE_CLIP = BATCHED_VERTEX_BUFFER_SIZE*5 };
 
 // capacity of buffer for storing transformed triangles
-//enum { FACE_BUFFER_SIZE = 4096 };
+enum { FACE_BUFFER_SIZE = 4096 };
 //enum { FACE_BUFFER_SIZE = 2048 };
-enum { FACE_BUFFER_SIZE = 1024 };
+//enum { FACE_BUFFER_SIZE = 1024 };
+
+// capacity of buffer for storing render states of deferred draw calls
+enum { MAX_DRAW_CALLS = 256 };
 
 // The maximum amount of vertices after clipping is 2*6 + 1.
 //enum { CLIP_BUFFER_SIZE = 2*6 + 1 };
@@ -100,6 +141,92 @@ void TransformVertex( const SVertex& vertex, XVertex *transformedVertex, const S
 	(*renderContext.vertexShader)( vertexShaderInput, vertexShaderOutput );
 }
 
+// storage for vertices shaded up front by SIMD vertex shaders
+class srTransformedVertexBuffer
+{
+	XVertex *	m_vertices;
+	UINT		m_maxVertices;
+
+public:
+	srTransformedVertexBuffer();
+	~srTransformedVertexBuffer();
+
+	// runs the SIMD vertex shader of the given context (if any) on all vertices,
+	// returns null if the context has no SIMD vertex shader
+	const XVertex* TransformVertices( const SVertex* vertices, UINT numVertices, const SoftRenderContext& context );
+};
+
+// post-transform vertex cache (FIFO, keyed by vertex index);
+// avoids running the vertex shader for vertices shared by adjacent triangles of indexed meshes
+struct VertexCache
+{
+	mxSIMDALIGNED INT32	tags[ VERTEX_CACHE_SIZE ];	// indices of cached vertices (-1 = empty slot)
+	XVertex		transformed[ VERTEX_CACHE_SIZE ];
+	UINT		nextSlot;	// slot to be replaced next
+
+	UINT		numHits;
+	UINT		numMisses;	// number of vertex shader invocations
+
+public:
+	VertexCache()
+	{
+		this->Clear();
+	}
+
+	void Clear()
+	{
+		for( UINT i = 0; i < VERTEX_CACHE_SIZE; i++ ) {
+			tags[i] = -1;
+		}
+		nextSlot = 0;
+		numHits = 0;
+		numMisses = 0;
+	}
+
+	// returns index of the slot holding the given vertex or -1 if the vertex is not in the cache
+	FORCEINLINE INT FindSlot( UINT index ) const
+	{
+	#if SOFT_RENDER_USE_SSE
+		const __m128i qiKey = _mm_set1_epi32( index );
+		for( UINT i = 0; i < VERTEX_CACHE_SIZE; i += SSE_REG_WIDTH )
+		{
+			const __m128i qiTags = _mm_load_si128( (const __m128i*) &tags[i] );
+			// there can be at most one match: 1,2,4,8 => 0,1,2,3
+			const UINT mask = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( qiTags, qiKey ) ) );
+			if( mask ) {
+				return i + (mask >> 1) - (mask >> 3);
+			}
+		}
+	#else
+		for( UINT i = 0; i < VERTEX_CACHE_SIZE; i++ )
+		{
+			if( tags[i] == (INT32)index ) {
+				return i;
+			}
+		}
+	#endif
+		return -1;
+	}
+
+	// returns the vertex transformed by the vertex shader, executes the shader only on cache misses
+	FORCEINLINE const XVertex& TransformVertex( const SVertex* vertices, UINT index, const SoftRenderContext& context )
+	{
+		const INT slot = this->FindSlot( index );
+		if( slot >= 0 )
+		{
+			numHits++;
+			return transformed[ slot ];
+		}
+
+		numMisses++;
+
+		const UINT newSlot = (nextSlot++) & (VERTEX_CACHE_SIZE-1);
+		tags[ newSlot ] = index;
+		SoftRenderer::TransformVertex( vertices[ index ], &transformed[ newSlot ], context );
+		return transformed[ newSlot ];
+	}
+};
+
 // performs perspective division and viewport mapping
 // perspective divide and viewport transform of vertices
 static inline
@@ -138,17 +265,19 @@ mxALIGN_BY_CACHE_LINE struct XTriangle
 {
 	XVertex		v1, v2, v3;
 
-	//// Cached start values for varyings
-	//F4		vars1OverW1[NUM_VARYINGS];	// v1.vars * invW1
+	// Cached start values for varyings
+	F4		vars1OverW1[NUM_VARYINGS];	// v1.vars * invW1
 
-	//// varyings multiplied by inverse W
-	//// (so that they can be linearly interpolated in screen space)
-	//Vec2D	varsOverW[NUM_VARYINGS];
+	// gradients of varyings multiplied by inverse W
+	// (so that they can be linearly interpolated in screen space)
+	Vec2D	varsOverW[NUM_VARYINGS];
 
-	//Vec2D	vInvW;	// inverse W
+	Vec2D	vInvW;	// inverse W gradient
 
 	Vec2D	vZ;	// depth gradient
 
+	UINT32	iDrawCall;	// index of draw call (render states) this triangle belongs to
+
 	// Cached fixed point coordinates
 	INT32	FPX[3];
 	INT32	FPY[3];
@@ -228,7 +357,15 @@ public:
 	virtual void SetFillMode( EFillMode newFillMode ) = 0;
 
 	virtual void SetVertexShader( F_VertexShader* newVertexShader ) = 0;
+	virtual void SetVertexShader4( F_VertexShader4* newVertexShader ) = 0;
+#if SOFT_RENDER_USE_AVX
+	virtual void SetVertexShader8( F_VertexShader8* newVertexShader ) = 0;
+#endif // SOFT_RENDER_USE_AVX
 	virtual void SetPixelShader( F_PixelShader* newPixelShader ) = 0;
+	virtual void SetPixelShader4( F_PixelShader4* newPixelShader ) = 0;
+#if SOFT_RENDER_USE_AVX
+	virtual void SetPixelShader8( F_PixelShader8* newPixelShader ) = 0;
+#endif // SOFT_RENDER_USE_AVX
 
 	virtual void SetTexture( SoftTexture2D* newTexture2D ) = 0;
 
@@ -237,7 +374,10 @@ public:
 	// wait for queued jobs to finish
 	virtual void Flush() {}
 
-	//virtual void ModifySettings( const Settings& newSettings ) {}
+	virtual void ModifySettings( const Settings& newSettings ) {}
+
+	// returns the instruction set actually used by the rasterization kernels
+	virtual ECpuMode GetCpuMode() const = 0;
 
 	virtual ~ATriangleRenderer() {}
 };
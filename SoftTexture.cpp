@@ -111,6 +111,39 @@ ARGB32 SoftTexture2D::Sample_Point_Wrap( F4 u, F4 v ) const
 #endif
 }
 
+__m128i SoftTexture2D::Sample_Point_Wrap4( const __m128& u, const __m128& v ) const
+{
+	mxSTATIC_ASSERT( SIZE_X == (1 << SIZE_X_LOG2) );
+
+	// same addressing as in Sample_Point_Wrap()
+	const __m128i qiU = _mm_and_si128( _mm_cvtps_epi32( _mm_mul_ps( u, _mm_set_ps1( (F4)SIZE_X ) ) ), _mm_set1_epi32( SIZE_X-1 ) );
+	const __m128i qiV = _mm_and_si128( _mm_cvtps_epi32( _mm_mul_ps( v, _mm_set_ps1( (F4)SIZE_Y ) ) ), _mm_set1_epi32( SIZE_Y-1 ) );
+
+	// iV * SIZE_X + iU
+	const __m128i qiIndex = _mm_add_epi32( _mm_slli_epi32( qiV, SIZE_X_LOG2 ), qiU );
+
+	// SSE has no gather instructions, fetch texels one by one
+	mxSIMDALIGNED INT32	indices[4];
+	_mm_store_si128( (__m128i*) indices, qiIndex );
+
+	const ARGB32* data = m_data.ToPtr();
+	return _mm_set_epi32( data[ indices[3] ], data[ indices[2] ], data[ indices[1] ], data[ indices[0] ] );
+}
+
+#if SOFT_RENDER_USE_AVX
+__m256i SoftTexture2D::Sample_Point_Wrap8( const __m256& u, const __m256& v ) const
+{
+	// same addressing as in Sample_Point_Wrap()
+	const __m256i qiU = _mm256_and_si256( _mm256_cvtps_epi32( _mm256_mul_ps( u, _mm256_set1_ps( (F4)SIZE_X ) ) ), _mm256_set1_epi32( SIZE_X-1 ) );
+	const __m256i qiV = _mm256_and_si256( _mm256_cvtps_epi32( _mm256_mul_ps( v, _mm256_set1_ps( (F4)SIZE_Y ) ) ), _mm256_set1_epi32( SIZE_Y-1 ) );
+
+	// iV * SIZE_X + iU
+	const __m256i qiIndex = _mm256_add_epi32( _mm256_slli_epi32( qiV, SIZE_X_LOG2 ), qiU );
+
+	return _mm256_i32gather_epi32( (const int*) m_data.ToPtr(), qiIndex, sizeof ARGB32 );
+}
+#endif // SOFT_RENDER_USE_AVX
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -1,7 +1,6 @@
 #include "SoftRender_PCH.h"
 #pragma hdrstop
 #include <Base/JobSystem/ThreadPool.h>
-#include <Base/Templates/Algorithm/RadixSort.h>
 #include "SoftMesh.h"
 #include "SoftTileRenderer.h"
 #include "SoftFrameBuffer.h"
@@ -9,11 +8,19 @@
 #include "SoftImmediateRenderer.h"
 #include "Rasterizer_FPU.inl"
 #include "Rasterizer_SSE.inl"
+#include "Rasterizer_AVX.inl"
+#include "Rasterizer_AVX512.inl"
+#include "Rasterizer_CoverageMask.inl"
+#include "TriangleSetup.inl"
 #include "SoftThreads.h"
 
 namespace SoftRenderer
 {
 
+// tiles of framebuffers with tiled layout are screen tiles
+mxSTATIC_ASSERT( SoftFrameBuffer::MEMORY_TILE_SIZE_X == TILE_SIZE_X );
+mxSTATIC_ASSERT( SoftFrameBuffer::MEMORY_TILE_SIZE_Y == TILE_SIZE_Y );
+
 #if SOFT_RENDER_DEBUG
 static inline
 float Dbg_Touch__m128( float* address )
@@ -26,167 +33,97 @@ float Dbg_Touch__m128( float* address )
 }
 #endif // SOFT_RENDER_DEBUG
 
-static inline
-srTile& AllocateTile( srTileRenderer* renderer )
+// takes a block from the pool of the chunk or allocates a new one if the pool is empty
+static
+srTileBlock* AllocateTileBlock( srFrontEndChunk* chunk )
 {
-	const UINT currCapacity = renderer->m_maxTiles;
-	Assert(IsPowerOfTwo(currCapacity));
+	srTileBlock* block = chunk->freeBlocks;
+	if( block )
+	{
+		chunk->freeBlocks = block->next;
+	}
+	else
+	{
+		block = (srTileBlock*) mxAlloc( sizeof srTileBlock );
+		block->iOwner = chunk->iChunk;
+		chunk->numBlocks++;
+	}
+	Assert( block->iOwner == chunk->iChunk );
+	block->numTiles = 0;
+	chunk->tiles.AddBlock( block );
+	return block;
+}
 
-	const UINT newTileIndex = (renderer->m_numTiles++) & (currCapacity-1);//avoid checking for overflow
-	Assert( newTileIndex < currCapacity );
+static inline
+srTile& AllocateTile( srFrontEndChunk* chunk )
+{
+	srTileBlock* block = chunk->tiles.tail;
+	if( !block || block->numTiles == TILES_PER_BLOCK )
+	{
+		block = AllocateTileBlock( chunk );
+	}
+	chunk->tiles.numTiles++;
 
-	srTile & newTile = renderer->m_tiles[ newTileIndex ];
+	srTile & newTile = block->tiles[ block->numTiles++ ];
 	return newTile;
 }
 
-static inline
-void RasterizeFullyCoveredTile( const srTile& tile, const SoftRenderContext& context, srTileRenderer* renderer )
+// scalar tile kernels, used when SIMD is disabled (e.g. for benchmarking)
+template< EDepthFormat FORMAT >
+static
+void RasterizeFullyCoveredTile_FPU( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
 {
-	//Assert( tile.bFullyCovered );
+	typedef srDepthFormat< FORMAT > DEPTH;
 
 	const int W = context.W;	// viewport width
-	//const int H = context.H;	// viewport height
-
-	const UINT iFace = tile.iFace;
-	const XTriangle& face = renderer->m_transformedFaces[ iFace ];
 
 	const F4 fX1 = face.v1.P.x;
-	const F4 fX2 = face.v2.P.x;
-	const F4 fX3 = face.v3.P.x;
-
 	const F4 fY1 = face.v1.P.y;
-	const F4 fY2 = face.v2.P.y;
-	const F4 fY3 = face.v3.P.y;
-
 	const F4 fZ1 = face.v1.P.z;
-	const F4 fZ2 = face.v2.P.z;
-	const F4 fZ3 = face.v3.P.z;
-
-	const INT32 nMinX = face.minX;
-	const INT32 nMaxX = face.maxX;
-	const INT32 nMinY = face.minY;
-	const INT32 nMaxY = face.maxY;
-
-	//Assert( nMinX % TILE_SIZE_X == 0 );
-	//Assert( nMinY % TILE_SIZE_Y == 0 );
-
-	const UINT iBlockX = tile.GetX();
-	const UINT iBlockY = tile.GetY();
 
-	const __m128 qf3210 = _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f );
-	//const __m128 qf4444 = _mm_set_ps1( 4.0f );
-	static const __m128 qf255x4 = _mm_set_ps1( 255.0f );
-
-	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
-	ZBufElem *	depthBufferStart = context.depthBuffer + iBlockY * W;	// depth buffer
+	SoftPixel* pixels = context.colorBuffer + iBlockY * W;	// color buffer
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
 
 	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
 	{
-		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += SSE_REG_WIDTH )
-		{
-			F4* depth = (depthBufferStart + iX);
-			//Assert(IS_16_BYTE_ALIGNED(depth));
-
-			__m128i* dest = (__m128i*) (colorBufferStart + iX);
-			//Assert(IS_16_BYTE_ALIGNED(dest));
-
-			//#######[LOAD] load previous depth
-			const __m128 qfOldDepth = _mm_load_ps( depth );
+		const F4 fY = (F4)iY - fY1;
 
-			//###[LHS]
-			// start value for x and y
-			const F4 fX = (F4)iX - fX1;	//<=###[LHS]
-			const F4 fY = (F4)iY - fY1;	//<=###[LHS]
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX++ )
+		{
+			const F4 fX = (F4)iX - fX1;
 
 			// interpolate depth
-			const __m128 qfvZx = _mm_set1_ps( face.vZ.x );
-			const __m128 qfZ0 = _mm_set1_ps( fZ1 + face.vZ.x * fX + face.vZ.y * fY );
-			const __m128 qfZ = _mm_add_ps( qfZ0, _mm_mul_ps( qfvZx, qf3210 ) );
+			const F4 fZ = fZ1 + face.vZ.x * fX + face.vZ.y * fY;
 
 			// perform depth testing
-			const __m128i qiDepthMask = (__m128i&) _mm_cmple_ps( qfZ, qfOldDepth );
-			if( !_mm_movemask_ps( (__m128&)qiDepthMask) ) {
-				continue;	// this quad is occluded
-			}
-
-			//$$$@@@[STORE] write depth to framebuffer
-			_mm_store_ps( depth,
-							_mm_or_ps(
-								_mm_and_ps( (__m128&)qiDepthMask, qfZ ),
-								_mm_andnot_ps( (__m128&)qiDepthMask, qfOldDepth )
-							)
-			);	//write
-
-			//#######[LOAD] load previous color
-			const __m128i qiOldColor = _mm_load_si128( dest );
-
-			// convert depth to color
-
-			__m128 qfTmp;
-			qfTmp = _mm_mul_ps( qfZ, qf255x4 );	// [0..1] => [0..255]
-			qfTmp = _mm_min_ps( qfTmp, qf255x4 );	// clamp to [0..255]
-
-			__m128i	qiTmp;
-			qiTmp = _mm_cvtps_epi32( qfTmp );	// convert float => int
-
-			// convert to ARGB: (i<<16)|(i<<8)|i;	// Alpha=0
-			__m128i qiNewColor = _mm_or_si128(
-				_mm_or_si128(
-					_mm_slli_epi32( qiTmp, 16 ),
-					_mm_slli_epi32( qiTmp, 8 )
-				),
-				qiTmp
-			);
-
-			const __m128i result = _mm_or_si128(
-				_mm_and_si128( qiDepthMask, qiNewColor ),
-				_mm_andnot_si128( qiDepthMask, qiOldColor )
-			);
-
-			//$$$@@@[STORE] write color to framebuffer
-			_mm_store_si128( dest, result );	//write
+			const typename DEPTH::Elem newDepth = DEPTH::Encode( fZ );
+			if( newDepth <= zbuffer[iX] )
+			{
+				zbuffer[iX] = newDepth;
 
+				ShadeTilePixel( face, iX, iY, fZ, pixels + iX, context );
+			}
 		}//for x
 
-		colorBufferStart += W;
-		depthBufferStart += W;
+		pixels += W;
+		zbuffer += W;
 	}//for y
-
-	//SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, iBlockX, iBlockY, TILE_SIZE_X, TILE_SIZE_Y );
 }
 
-static inline
-void RasterizePartiallyCoveredTile( const srTile& tile, const SoftRenderContext& context, srTileRenderer* renderer )
+template< EDepthFormat FORMAT >
+static
+void RasterizePartiallyCoveredTile_FPU( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
 {
-	//Assert( !tile.bFullyCovered );
+	typedef srDepthFormat< FORMAT > DEPTH;
 
 	const int W = context.W;	// viewport width
-	const int H = context.H;	// viewport height
-
-	const UINT iFace = tile.iFace;
-	Assert( iFace < renderer->m_nTransformedTris );
-
-	const XTriangle& face = renderer->m_transformedFaces[ iFace ];
-
-	const UINT iBlockX = tile.GetX();
-	const UINT iBlockY = tile.GetY();
-
-	//Assert( iBlockX <= W-TILE_SIZE_X );
-	//Assert( iBlockY <= H-TILE_SIZE_Y );
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
 
 	const F4 fX1 = face.v1.P.x;
-	const F4 fX2 = face.v2.P.x;
-	const F4 fX3 = face.v3.P.x;
-
 	const F4 fY1 = face.v1.P.y;
-	const F4 fY2 = face.v2.P.y;
-	const F4 fY3 = face.v3.P.y;
-
 	const F4 fZ1 = face.v1.P.z;
-	const F4 fZ2 = face.v2.P.z;
-	const F4 fZ3 = face.v3.P.z;
 
-	// 24.8 fixed-point
+	// 28.4 fixed-point
 	const INT32 X1 = face.FPX[0];
 	const INT32 X2 = face.FPX[1];
 	const INT32 X3 = face.FPX[2];
@@ -213,136 +150,48 @@ void RasterizePartiallyCoveredTile( const srTile& tile, const SoftRenderContext&
 	const INT32 FDY23 = DeltaY23 << FP_SHIFT;
 	const INT32 FDY31 = DeltaY31 << FP_SHIFT;
 
-
-	// Half-edge constants in 28.4
-
-	const INT32 C1 = face.C1;
-	const INT32 C2 = face.C2;
-	const INT32 C3 = face.C3;
-
-
-	const INT32 nMinX = face.minX;
-	const INT32 nMaxX = face.maxX;
-	const INT32 nMinY = face.minY;
-	const INT32 nMaxY = face.maxY;
-
-	//Assert( nMinX % TILE_SIZE_X == 0 );
-	//Assert( nMinY % TILE_SIZE_Y == 0 );
-
 	SoftPixel* pixels = context.colorBuffer + iBlockY * W;	// color buffer
-	ZBufElem* zbuffer = context.depthBuffer + iBlockY * W;	// depth buffer
-
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
 
 	// Corners of block in 28.4 fixed-point (4 bits of sub-pixel accuracy)
 	const UINT FBlockX0 = (iBlockX << FP_SHIFT);
-	const UINT FBlockX1 = (iBlockX + (TILE_SIZE_X - 1)) << FP_SHIFT;
 	const UINT FBlockY0 = (iBlockY << FP_SHIFT);
-	const UINT FBlockY1 = (iBlockY + (TILE_SIZE_Y - 1)) << FP_SHIFT;
 
 	// in 28.4
-	INT32 CY1 = C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0;
-	INT32 CY2 = C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0;
-	INT32 CY3 = C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0;
-
-	const __m128 qf3210 = _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f );
-	//const __m128 qf4444 = _mm_set_ps1( 4.0f );
-	static const __m128 qf255x4 = _mm_set_ps1( 255.0f );
-
-	const __m128i qiOffsetDY12 = _mm_set_epi32( FDY12 * 3, FDY12 * 2, FDY12 * 1, FDY12 * 0 );
-	const __m128i qiOffsetDY23 = _mm_set_epi32( FDY23 * 3, FDY23 * 2, FDY23 * 1, FDY23 * 0 );
-	const __m128i qiOffsetDY31 = _mm_set_epi32( FDY31 * 3, FDY31 * 2, FDY31 * 1, FDY31 * 0 );
-
-	const __m128i qiFDY12_4 = _mm_set1_epi32( FDY12 * SSE_REG_WIDTH );
-	const __m128i qiFDY23_4 = _mm_set1_epi32( FDY23 * SSE_REG_WIDTH );
-	const __m128i qiFDY31_4 = _mm_set1_epi32( FDY31 * SSE_REG_WIDTH );
+	INT32 CY1 = face.C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0;
+	INT32 CY2 = face.C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0;
+	INT32 CY3 = face.C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0;
 
 	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
 	{
-		const __m128i	qiCY1 = _mm_set1_epi32( CY1 );
-		const __m128i	qiCY2 = _mm_set1_epi32( CY2 );
-		const __m128i	qiCY3 = _mm_set1_epi32( CY3 );
+		INT32 CX1 = CY1;
+		INT32 CX2 = CY2;
+		INT32 CX3 = CY3;
 
-		__m128i qiCX1 = _mm_sub_epi32( qiCY1, qiOffsetDY12 );
-		__m128i qiCX2 = _mm_sub_epi32( qiCY2, qiOffsetDY23 );
-		__m128i qiCX3 = _mm_sub_epi32( qiCY3, qiOffsetDY31 );
+		const F4 fY = (F4)iY - fY1;
 
-		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += SSE_REG_WIDTH )
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX++ )
 		{
-			const __m128i qiCX1mask = _mm_cmpgt_epi32( qiCX1, _mm_setzero_si128() );
-			const __m128i qiCX2mask = _mm_cmpgt_epi32( qiCX2, _mm_setzero_si128() );
-			const __m128i qiCX3mask = _mm_cmpgt_epi32( qiCX3, _mm_setzero_si128() );
-			const __m128i qiEdgeMask = _mm_and_si128( qiCX1mask, _mm_and_si128( qiCX2mask, qiCX3mask ) );
-
-			F4* depth = (zbuffer + iX);
-			//Assert(IS_16_BYTE_ALIGNED(depth));
-
-			__m128i* dest = (__m128i*) (pixels + iX);
-			//Assert(IS_16_BYTE_ALIGNED(dest));
-
-			//#######[LOAD] load previous depth
-			const __m128 qfOldDepth = _mm_load_ps( depth );
+			if( CX1 > 0 && CX2 > 0 && CX3 > 0 )
+			{
+				const F4 fX = (F4)iX - fX1;
 
-			//###[LHS]
-			// start value for x and y
-			const F4 fX = (F4)iX - fX1;	//<=###[LHS]
-			const F4 fY = (F4)iY - fY1;	//<=###[LHS]
+				// interpolate depth
+				const F4 fZ = fZ1 + face.vZ.x * fX + face.vZ.y * fY;
 
-			// interpolate depth
-			const __m128 qfvZx = _mm_set1_ps( face.vZ.x );
-			const __m128 qfZ0 = _mm_set1_ps( fZ1 + face.vZ.x * fX + face.vZ.y * fY );
-			const __m128 qfZ = _mm_add_ps( qfZ0, _mm_mul_ps( qfvZx, qf3210 ) );
+				// perform depth testing
+				const typename DEPTH::Elem newDepth = DEPTH::Encode( fZ );
+				if( newDepth <= zbuffer[iX] )
+				{
+					zbuffer[iX] = newDepth;
 
-			// perform depth testing
-			const __m128i qiDepthMask = (__m128i&) _mm_cmple_ps( qfZ, qfOldDepth );
-			if( !_mm_movemask_ps( (__m128&)qiDepthMask) ) {
-				goto L_Skip_This_Quad;	// this quad is occluded
+					ShadeTilePixel( face, iX, iY, fZ, pixels + iX, context );
+				}
 			}
 
-			const __m128i qiColorMask = _mm_and_si128( qiDepthMask, qiEdgeMask );
-
-			//$$$@@@[STORE] write depth to framebuffer
-			_mm_store_ps( depth,
-							_mm_or_ps(
-								_mm_and_ps( (__m128&)qiColorMask, qfZ ),
-								_mm_andnot_ps( (__m128&)qiColorMask, qfOldDepth )
-							)
-			);	//write
-			
-			//#######[LOAD] load previous color
-			const __m128i qiOldColor = _mm_load_si128( dest );
-
-			// convert depth to color
-
-			__m128 qfTmp;
-			qfTmp = _mm_mul_ps( qfZ, qf255x4 );	// [0..1] => [0..255]
-			qfTmp = _mm_min_ps( qfTmp, qf255x4 );	// clamp to [0..255]
-
-			__m128i	qiTmp;
-			qiTmp = _mm_cvtps_epi32( qfTmp );	// convert float => int
-
-			// convert to ARGB: (i<<16)|(i<<8)|i;	// Alpha=0
-			__m128i qiNewColor = _mm_or_si128(
-				_mm_or_si128(
-					_mm_slli_epi32( qiTmp, 16 ),
-					_mm_slli_epi32( qiTmp, 8 )
-				),
-				qiTmp
-			);
-
-			const __m128i result = _mm_or_si128(
-				_mm_and_si128( qiColorMask, qiNewColor ),
-				_mm_andnot_si128( qiColorMask, qiOldColor )
-			);
-
-			//$$$@@@[STORE] write color to framebuffer
-			_mm_store_si128( dest, result );	//write
-
-
-L_Skip_This_Quad:
-			qiCX1 = _mm_sub_epi32( qiCX1, qiFDY12_4 );
-			qiCX2 = _mm_sub_epi32( qiCX2, qiFDY23_4 );
-			qiCX3 = _mm_sub_epi32( qiCX3, qiFDY31_4 );
-
+			CX1 -= FDY12;
+			CX2 -= FDY23;
+			CX3 -= FDY31;
 		}//for x
 
 		CY1 += FDX12;
@@ -352,80 +201,61 @@ L_Skip_This_Quad:
 		pixels += W;
 		zbuffer += W;
 	}//for y
-
-	//SoftRenderer::Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, iBlockX, iBlockY, TILE_SIZE_X, TILE_SIZE_Y );
 }
 
-// BLOCK_SIZE_X=16 and BLOCK_SIZE_Y=8 are good values
-template< UINT BLOCK_SIZE_X, UINT BLOCK_SIZE_Y >
-static inline
-void F_ProcessTriangle(
-								 //NOTABUG: swap v2 and v3 because of triangle winding order and our edge functions sign calculation
-								 const XVertex& v1, const XVertex& v3, const XVertex& v2,
-								 const SoftRenderContext& context
-						   )
+// shades all pixels of a fully covered tile which is in front of its depth plane
+// (see srTileRenderer::RasterizeDepthPlaneTile()), the depth buffer is not accessed
+static
+void ShadeFullyCoveredTile_FPU( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
 {
-	mxSTATIC_ASSERT_ISPOW2( BLOCK_SIZE_X );
-	mxSTATIC_ASSERT_ISPOW2( BLOCK_SIZE_Y );
-
-	mxPROFILE_SCOPE("Process Triangle (Insert Transformed Triangle)");
-
-
 	const int W = context.W;	// viewport width
-	const int H = context.H;	// viewport height
 
-	srTileRenderer* renderer = c_cast(srTileRenderer*) context.userPointer;
-
-	Assert( renderer->m_nTransformedTris < FACE_BUFFER_SIZE );
-
-	const UINT newFaceIndex = (renderer->m_nTransformedTris++) & (FACE_BUFFER_SIZE-1);//avoid checking for overflow
-
-	XTriangle & face = renderer->m_transformedFaces[ newFaceIndex ];
-
-	face.v1 = v1;
-	face.v2 = v2;
-	face.v3 = v3;
-
-
-	const F4 fX1 = v1.P.x;
-	const F4 fX2 = v2.P.x;
-	const F4 fX3 = v3.P.x;
+	const F4 fX1 = face.v1.P.x;
+	const F4 fY1 = face.v1.P.y;
+	const F4 fZ1 = face.v1.P.z;
 
-	const F4 fY1 = v1.P.y;
-	const F4 fY2 = v2.P.y;
-	const F4 fY3 = v3.P.y;
+	SoftPixel* pixels = context.colorBuffer + iBlockY * W;	// color buffer
 
-	const F4 fZ1 = v1.P.z;
-	const F4 fZ2 = v2.P.z;
-	const F4 fZ3 = v3.P.z;
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		const F4 fY = (F4)iY - fY1;
 
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX++ )
+		{
+			const F4 fX = (F4)iX - fX1;
 
-	const INT32 X1 = iround( F4(1<<FP_SHIFT) * fX1 );
-	const INT32 X2 = iround( F4(1<<FP_SHIFT) * fX2 );
-	const INT32 X3 = iround( F4(1<<FP_SHIFT) * fX3 );
+			// interpolate depth
+			const F4 fZ = fZ1 + face.vZ.x * fX + face.vZ.y * fY;
 
-	const INT32 Y1 = iround( F4(1<<FP_SHIFT) * fY1 );
-	const INT32 Y2 = iround( F4(1<<FP_SHIFT) * fY2 );
-	const INT32 Y3 = iround( F4(1<<FP_SHIFT) * fY3 );
+			ShadeTilePixel( face, iX, iY, fZ, pixels + iX, context );
+		}//for x
 
-	//const INT32 Z1 = iround( 16.0f * fZ1 );
-	//const INT32 Z2 = iround( 16.0f * fZ2 );
-	//const INT32 Z3 = iround( 16.0f * fZ3 );
+		pixels += W;
+	}//for y
+}
 
-	//const INT32 W1 = iround( 16.0f * fInvW1 );
-	//const INT32 W2 = iround( 16.0f * fInvW2 );
-	//const INT32 W3 = iround( 16.0f * fInvW3 );
+// rasterizes a small triangle (see IsSmallTriangle()) inside its bounding rectangle
+template< EDepthFormat FORMAT >
+static
+void RasterizeSmallTriangle_FPU( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
 
+	const int W = context.W;	// viewport width
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
 
-	face.FPX[0] = X1;
-	face.FPX[1] = X2;
-	face.FPX[2] = X3;
-			
-	face.FPY[0] = Y1;
-	face.FPY[1] = Y2;
-	face.FPY[2] = Y3;
+	const F4 fX1 = face.v1.P.x;
+	const F4 fY1 = face.v1.P.y;
+	const F4 fZ1 = face.v1.P.z;
 
+	// 28.4 fixed-point
+	const INT32 X1 = face.FPX[0];
+	const INT32 X2 = face.FPX[1];
+	const INT32 X3 = face.FPX[2];
 
+	const INT32 Y1 = face.FPY[0];
+	const INT32 Y2 = face.FPY[1];
+	const INT32 Y3 = face.FPY[2];
 
 	// deltas
 	const INT32 DeltaX12 = X1 - X2;
@@ -436,7 +266,6 @@ void F_ProcessTriangle(
 	const INT32 DeltaY23 = Y2 - Y3;
 	const INT32 DeltaY31 = Y3 - Y1;
 
-
 	// 24.8 Fixed-point deltas
 	const INT32 FDX12 = DeltaX12 << FP_SHIFT;
 	const INT32 FDX23 = DeltaX23 << FP_SHIFT;
@@ -446,188 +275,679 @@ void F_ProcessTriangle(
 	const INT32 FDY23 = DeltaY23 << FP_SHIFT;
 	const INT32 FDY31 = DeltaY31 << FP_SHIFT;
 
+	// bounding rectangle in pixels (the tile contains it)
+	const INT32 FP_ROUND = (1 << FP_SHIFT) - 1;
+	const UINT nStartX = largest( (Min3(X1, X2, X3) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockX );
+	const UINT nStartY = largest( (Min3(Y1, Y2, Y3) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockY );
+	const UINT nEndX = face.maxX;
+	const UINT nEndY = face.maxY;
+	Assert( nEndX <= iBlockX + TILE_SIZE_X && nEndY <= iBlockY + TILE_SIZE_Y );
 
+	SoftPixel* pixels = context.colorBuffer + nStartY * W;	// color buffer
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, nStartY );	// depth buffer
 
+	// top-left corner of the rectangle in 28.4 fixed-point
+	const UINT FStartX = (nStartX << FP_SHIFT);
+	const UINT FStartY = (nStartY << FP_SHIFT);
 
-	// Compute interpolation data
-	//const F4 fDeltaX12 = fX1 - fX2;
-	//const F4 fDeltaX23 = fX2 - fX3;
-	const F4 fDeltaX31 = fX3 - fX1;
-
-	//const F4 fDeltaY12 = fY1 - fY2;
-	//const F4 fDeltaY23 = fY2 - fY3;
-	const F4 fDeltaY31 = fY3 - fY1;
-
-	const F4 fDeltaZ21 = fZ2 - fZ1;
-	const F4 fDeltaZ31 = fZ3 - fZ1;
-
-	const F4 fDeltaX21 = fX2 - fX1;
-	const F4 fDeltaY21 = fY2 - fY1;
+	// in 28.4
+	INT32 CY1 = face.C1 + DeltaX12 * FStartY - DeltaY12 * FStartX;
+	INT32 CY2 = face.C2 + DeltaX23 * FStartY - DeltaY23 * FStartX;
+	INT32 CY3 = face.C3 + DeltaX31 * FStartY - DeltaY31 * FStartX;
 
-	const F4 INTERP_C = fDeltaX21 * fDeltaY31 - fDeltaX31 * fDeltaY21;
+	for( UINT iY = nStartY; iY < nEndY; iY++ )
+	{
+		INT32 CX1 = CY1;
+		INT32 CX2 = CY2;
+		INT32 CX3 = CY3;
 
+		const F4 fY = (F4)iY - fY1;
 
-	// compute gradient for interpolating depth (aka Z)
+		for( UINT iX = nStartX; iX < nEndX; iX++ )
+		{
+			if( CX1 > 0 && CX2 > 0 && CX3 > 0 )
+			{
+				const F4 fX = (F4)iX - fX1;
 
-	ComputeGradient_FPU(
-		INTERP_C,
-		fDeltaZ21, fDeltaZ31,
-		fDeltaX21, fDeltaX31,
-		fDeltaY21, fDeltaY31,
-		face.vZ.x, face.vZ.y
-		);
+				// interpolate depth
+				const F4 fZ = fZ1 + face.vZ.x * fX + face.vZ.y * fY;
 
+				// perform depth testing
+				const typename DEPTH::Elem newDepth = DEPTH::Encode( fZ );
+				if( newDepth <= zbuffer[iX] )
+				{
+					zbuffer[iX] = newDepth;
 
-	mxSTATIC_ASSERT( SOFT_RENDER_USES_FLOATING_POINT_DEPTH_BUFFER );
+					ShadeTilePixel( face, iX, iY, fZ, pixels + iX, context );
+				}
+			}
 
+			CX1 -= FDY12;
+			CX2 -= FDY23;
+			CX3 -= FDY31;
+		}//for x
 
-	// Half-edge constants in 28.4
-	INT32 C1 = DeltaY12 * X1 - DeltaX12 * Y1;
-	INT32 C2 = DeltaY23 * X2 - DeltaX23 * Y2;
-	INT32 C3 = DeltaY31 * X3 - DeltaX31 * Y3;
+		CY1 += FDX12;
+		CY2 += FDX23;
+		CY3 += FDX31;
 
-	// correct for top-left fill convention
-	if( DeltaY12 < 0 || (DeltaY12 == 0 && DeltaX12 > 0) ) {
-		++C1;
-	}
-	if( DeltaY23 < 0 || (DeltaY23 == 0 && DeltaX23 > 0) ) {
-		++C2;
-	}
-	if( DeltaY31 < 0 || (DeltaY31 == 0 && DeltaX31 > 0) ) {
-		++C3;
-	}
+		pixels += W;
+		zbuffer += W;
+	}//for y
+}
 
+template< EDepthFormat FORMAT >
+static
+void RasterizeFullyCoveredTile_SSE( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
 
-	face.C1 = C1;
-	face.C2 = C2;
-	face.C3 = C3;
+	const int W = context.W;	// viewport width
 
+	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
+	typename DEPTH::Elem *	depthBufferStart = GetDepthAddress< FORMAT >( context, 0, iBlockY );	// depth buffer
 
-	// Bounding rectangle of this triangle in screen space
+	// interpolants at the first quad of the tile and their increments from quad to quad and from row to row
+	srPlanes_SSE	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, SSE_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
 
-#if 0
-	const INT32 nMinX = ((Min3(X1, X2, X3) + 0xF) >> FP_SHIFT) & ~(BLOCK_SIZE_X - 1);	// start in block corner
-	const INT32 nMaxX = ((Max3(X1, X2, X3) + 0xF) >> FP_SHIFT);
-	const INT32 nMinY = ((Min3(Y1, Y2, Y3) + 0xF) >> FP_SHIFT) & ~(BLOCK_SIZE_Y - 1);	// start in block corner
-	const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + 0xF) >> FP_SHIFT);
-#else
-	const INT32 nMinX = Clamp( (Min3(X1, X2, X3) + 0xF) >> 4, 0, W ) & ~(BLOCK_SIZE_X - 1);
-	const INT32 nMaxX = Clamp( (Max3(X1, X2, X3) + 0xF) >> 4, 0, W );
-	const INT32 nMinY = Clamp( (Min3(Y1, Y2, Y3) + 0xF) >> 4, 0, H ) & ~(BLOCK_SIZE_Y - 1);
-	const INT32 nMaxY = Clamp( (Max3(Y1, Y2, Y3) + 0xF) >> 4, 0, H );
-#endif
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		srPlanes_SSE	planes = planesRow;
 
-	Assert( nMinX % BLOCK_SIZE_X == 0 );
-	Assert( nMinY % BLOCK_SIZE_Y == 0 );
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += SSE_REG_WIDTH )
+		{
+			typename DEPTH::Elem* depth = (depthBufferStart + iX);
+			//Assert(IS_16_BYTE_ALIGNED(depth));
 
-	face.minX = nMinX;
-	face.maxX = nMaxX;
-	face.minY = nMinY;
-	face.maxY = nMaxY;
+			//#######[LOAD] load previous depth
+			const __m128 qfOldDepth = DEPTH::Load_SSE( depth );
+			const __m128 qfNewDepth = DEPTH::Encode_SSE( planes.z );
 
+			// perform depth testing
+			const __m128 qfDepthMask = DEPTH::LessEqual_SSE( qfNewDepth, qfOldDepth );
+			const UINT mask = _mm_movemask_ps( qfDepthMask );
 
-	mxOPTIMIZE("Use integer SSE instruction?");
+			// skip this quad if it's occluded
+			if( mask )
+			{
+				//$$$@@@[STORE] write depth to framebuffer
+				DEPTH::Store_SSE( depth, _mm_or_ps( _mm_and_ps( qfDepthMask, qfNewDepth ), _mm_andnot_ps( qfDepthMask, qfOldDepth ) ) );
 
-	for( UINT iBlockY = nMinY; iBlockY < nMaxY; iBlockY += BLOCK_SIZE_Y )
-	{
-		for( UINT iBlockX = nMinX; iBlockX < nMaxX; iBlockX += BLOCK_SIZE_X )
-		{
-			// Corners of block in 28.4 fixed-point (4 bits of sub-pixel accuracy)
-			const UINT FBlockX0 = (iBlockX << FP_SHIFT);
-			const UINT FBlockX1 = (iBlockX + (BLOCK_SIZE_X - 1)) << FP_SHIFT;
-			const UINT FBlockY0 = (iBlockY << FP_SHIFT);
-			const UINT FBlockY1 = (iBlockY + (BLOCK_SIZE_Y - 1)) << FP_SHIFT;
-
-			//Assert( iBlockX <= W-BLOCK_SIZE_X );
-			//Assert( iBlockY <= H-BLOCK_SIZE_Y );
-
-			// Evaluate half-space functions in the 4 corners of the block
-
-			const UINT a00 = 1-INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX0 );
-			const UINT a10 = 1-INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY0 - DeltaY12 * FBlockX1 );
-			const UINT a01 = 1-INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX0 );
-			const UINT a11 = 1-INT32_SIGN_BIT_SET( C1 + DeltaX12 * FBlockY1 - DeltaY12 * FBlockX1 );
-			const UINT a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);	// compose 4-bit mask for all four corners
-			if( !a ) {
-				continue;// Skip block when outside an edge => outside the triangle
-			}
-			const UINT b00 = 1-INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX0 );
-			const UINT b10 = 1-INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY0 - DeltaY23 * FBlockX1 );
-			const UINT b01 = 1-INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX0 );
-			const UINT b11 = 1-INT32_SIGN_BIT_SET( C2 + DeltaX23 * FBlockY1 - DeltaY23 * FBlockX1 );
-			const UINT b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);	// compose 4-bit mask for all four corners
-			if( !b ) {
-				continue;// Skip block when outside an edge => outside the triangle
-			}
-			const UINT c00 = 1-INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX0 );
-			const UINT c10 = 1-INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY0 - DeltaY31 * FBlockX1 );
-			const UINT c01 = 1-INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX0 );
-			const UINT c11 = 1-INT32_SIGN_BIT_SET( C3 + DeltaX31 * FBlockY1 - DeltaY31 * FBlockX1 );
-			const UINT c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);	// compose 4-bit mask for all four corners
-			if( !c ) {
-				continue;// Skip block when outside an edge => outside the triangle
+				// shade pixels which passed the depth test
+				ShadeTileQuad_SSE( planes, mask, colorBufferStart + iX, context );
 			}
 
-			srTile& newTile = AllocateTile( renderer );
-			newTile.iFace = newFaceIndex;
-			newTile.SetX( iBlockX );
-			newTile.SetY( iBlockY );
+			planes.Add( stepX );
 
-			// check if whole block is totally covered
-			// (all four corners are inside triangle and their coverage masks are (1|2|4|8) = 15)
-
-			newTile.bFullyCovered = ( a + b + c == (0xF + 0xF + 0xF) );
+		}//for x
 
-		}//for each block on X axis
+		planesRow.Add( stepY );
 
-	}//for each block on Y axis
+		colorBufferStart += W;
+		depthBufferStart += W;
+	}//for y
 
-	//renderer->m_numFullyCoveredTiles += numFullyCoveredTiles;
+	//SoftRenderer::Dbg_BlockRasterizer_DrawFullyCoveredRect( context, iBlockX, iBlockY, TILE_SIZE_X, TILE_SIZE_Y );
 }
 
-srTileRenderer::srTileRenderer( UINT width, UINT height )
+// SSE version of ShadeFullyCoveredTile_FPU(), a quad at a time
+static
+void ShadeFullyCoveredTile_SSE( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
 {
-	m_worldMatrix = XMMatrixIdentity();
-	m_viewMatrix = XMMatrixIdentity();
-	m_projectionMatrix = XMMatrixIdentity();
-
-	m_vertexShader = nil;
-	m_pixelShader = nil;
+	const int W = context.W;	// viewport width
 
-	m_cullMode = ECullMode::Cull_CCW;
-	m_fillMode = EFillMode::Fill_Solid;
+	SoftPixel *	colorBufferStart = context.colorBuffer + iBlockY * W;	// color buffer
 
-	DBGOUT("srTileRenderer(): size of face buffer: %u KiB\n", sizeof m_transformedFaces /mxKIBIBYTE);
+	srPlanes_SSE	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iBlockX, iBlockY );
+	stepX.SetStep( face, SSE_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
 
-	m_nTransformedTris = 0;
+	for( UINT iY = iBlockY; iY < iBlockY + TILE_SIZE_Y; iY++ )
+	{
+		srPlanes_SSE	planes = planesRow;
 
-	m_maxTiles = 2048;
-	m_tiles = (srTile*) mxAlloc( m_maxTiles * sizeof m_tiles[0] );
-	m_sortedTiles = (srTile*) mxAlloc( m_maxTiles * sizeof m_sortedTiles[0] );
-	m_numTiles = 0;
-	//m_numFullyCoveredTiles = 0;
+		for( UINT iX = iBlockX; iX < iBlockX + TILE_SIZE_X; iX += SSE_REG_WIDTH )
+		{
+			ShadeTileQuad_SSE( planes, 0xF, colorBufferStart + iX, context );
 
-	//-----------------------------------------------------------------
+			planes.Add( stepX );
+		}//for x
 
-	ZERO_OUT(m_ftblProcessTriangles);
-	ZERO_OUT(m_ftblDrawTriangle);
+		planesRow.Add( stepY );
 
-#define INSTALL_PROCESS_TRIANGLES_FUNC( CULL, FILL )\
-	m_ftblProcessTriangles[CULL][FILL] = &Template_ProcessTriangles<CULL,FILL>
+		colorBufferStart += W;
+	}//for y
+}
 
-#define INSTALL_PROCESS_TRIANGLES_FUNC_CULL( CULL )\
-	m_ftblProcessTriangles[Fill_Solid][CULL] = &Template_ProcessTriangles<Fill_Solid,CULL>;\
-	m_ftblProcessTriangles[Fill_Wireframe][CULL] = &Template_ProcessTriangles<Fill_Wireframe,CULL>;\
+// rasterizes the pixels of the rectangle [iStartX, iEndX) x [iStartY, iEndY) inside the triangle;
+// iStartX must be a multiple of four
+template< EDepthFormat FORMAT >
+static FORCEINLINE
+void RasterizeTriangleRect_SSE( const XTriangle& face, UINT iStartX, UINT iStartY, UINT iEndX, UINT iEndY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
 
+	const int W = context.W;	// viewport width
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
 
+	// 28.4 fixed-point
+	const INT32 X1 = face.FPX[0];
+	const INT32 X2 = face.FPX[1];
+	const INT32 X3 = face.FPX[2];
 
-	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_None );
-	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_CW );
-	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_CCW );
+	const INT32 Y1 = face.FPY[0];
+	const INT32 Y2 = face.FPY[1];
+	const INT32 Y3 = face.FPY[2];
 
+	// deltas
+	const INT32 DeltaX12 = X1 - X2;
+	const INT32 DeltaX23 = X2 - X3;
+	const INT32 DeltaX31 = X3 - X1;
 
+	const INT32 DeltaY12 = Y1 - Y2;
+	const INT32 DeltaY23 = Y2 - Y3;
+	const INT32 DeltaY31 = Y3 - Y1;
 
-#undef INSTALL_PROCESS_TRIANGLES_FUNC_CULL
+	// 24.8 Fixed-point deltas
+	const INT32 FDX12 = DeltaX12 << FP_SHIFT;
+	const INT32 FDX23 = DeltaX23 << FP_SHIFT;
+	const INT32 FDX31 = DeltaX31 << FP_SHIFT;
+
+	const INT32 FDY12 = DeltaY12 << FP_SHIFT;
+	const INT32 FDY23 = DeltaY23 << FP_SHIFT;
+	const INT32 FDY31 = DeltaY31 << FP_SHIFT;
+
+	SoftPixel* pixels = context.colorBuffer + iStartY * W;	// color buffer
+	typename DEPTH::Elem* zbuffer = GetDepthAddress< FORMAT >( context, 0, iStartY );	// depth buffer
+
+	// top-left corner of the rectangle in 28.4 fixed-point
+	const UINT FStartX = (iStartX << FP_SHIFT);
+	const UINT FStartY = (iStartY << FP_SHIFT);
+
+	// half-edge constants in 28.4
+	INT32 CY1 = face.C1 + DeltaX12 * FStartY - DeltaY12 * FStartX;
+	INT32 CY2 = face.C2 + DeltaX23 * FStartY - DeltaY23 * FStartX;
+	INT32 CY3 = face.C3 + DeltaX31 * FStartY - DeltaY31 * FStartX;
+
+	const __m128i qiOffsetDY12 = _mm_set_epi32( FDY12 * 3, FDY12 * 2, FDY12 * 1, FDY12 * 0 );
+	const __m128i qiOffsetDY23 = _mm_set_epi32( FDY23 * 3, FDY23 * 2, FDY23 * 1, FDY23 * 0 );
+	const __m128i qiOffsetDY31 = _mm_set_epi32( FDY31 * 3, FDY31 * 2, FDY31 * 1, FDY31 * 0 );
+
+	const __m128i qiFDY12_4 = _mm_set1_epi32( FDY12 * SSE_REG_WIDTH );
+	const __m128i qiFDY23_4 = _mm_set1_epi32( FDY23 * SSE_REG_WIDTH );
+	const __m128i qiFDY31_4 = _mm_set1_epi32( FDY31 * SSE_REG_WIDTH );
+
+	// interpolants at the first quad of the rectangle and their increments from quad to quad and from row to row
+	srPlanes_SSE	planesRow, stepX, stepY;
+	planesRow.Evaluate( face, iStartX, iStartY );
+	stepX.SetStep( face, SSE_REG_WIDTH, 0 );
+	stepY.SetStep( face, 0, 1 );
+
+	for( UINT iY = iStartY; iY < iEndY; iY++ )
+	{
+		__m128i qiCX1 = _mm_sub_epi32( _mm_set1_epi32( CY1 ), qiOffsetDY12 );
+		__m128i qiCX2 = _mm_sub_epi32( _mm_set1_epi32( CY2 ), qiOffsetDY23 );
+		__m128i qiCX3 = _mm_sub_epi32( _mm_set1_epi32( CY3 ), qiOffsetDY31 );
+
+		srPlanes_SSE	planes = planesRow;
+
+		for( UINT iX = iStartX; iX < iEndX; iX += SSE_REG_WIDTH )
+		{
+			const __m128i qiCX1mask = _mm_cmpgt_epi32( qiCX1, _mm_setzero_si128() );
+			const __m128i qiCX2mask = _mm_cmpgt_epi32( qiCX2, _mm_setzero_si128() );
+			const __m128i qiCX3mask = _mm_cmpgt_epi32( qiCX3, _mm_setzero_si128() );
+			const __m128 qfEdgeMask = _mm_castsi128_ps( _mm_and_si128( qiCX1mask, _mm_and_si128( qiCX2mask, qiCX3mask ) ) );
+
+			// skip this quad if it's outside the triangle
+			if( _mm_movemask_ps( qfEdgeMask ) )
+			{
+				typename DEPTH::Elem* depth = (zbuffer + iX);
+				//Assert(IS_16_BYTE_ALIGNED(depth));
+
+				//#######[LOAD] load previous depth
+				const __m128 qfOldDepth = DEPTH::Load_SSE( depth );
+				const __m128 qfNewDepth = DEPTH::Encode_SSE( planes.z );
+
+				// perform depth testing of covered pixels
+				const __m128 qfColorMask = _mm_and_ps( DEPTH::LessEqual_SSE( qfNewDepth, qfOldDepth ), qfEdgeMask );
+				const UINT mask = _mm_movemask_ps( qfColorMask );
+
+				// skip this quad if it's occluded
+				if( mask )
+				{
+					//$$$@@@[STORE] write depth to framebuffer
+					DEPTH::Store_SSE( depth, _mm_or_ps( _mm_and_ps( qfColorMask, qfNewDepth ), _mm_andnot_ps( qfColorMask, qfOldDepth ) ) );
+
+					// shade covered pixels which passed the depth test
+					ShadeTileQuad_SSE( planes, mask, pixels + iX, context );
+				}
+			}
+
+			qiCX1 = _mm_sub_epi32( qiCX1, qiFDY12_4 );
+			qiCX2 = _mm_sub_epi32( qiCX2, qiFDY23_4 );
+			qiCX3 = _mm_sub_epi32( qiCX3, qiFDY31_4 );
+
+			planes.Add( stepX );
+
+		}//for x
+
+		CY1 += FDX12;
+		CY2 += FDX23;
+		CY3 += FDX31;
+
+		planesRow.Add( stepY );
+
+		pixels += W;
+		zbuffer += W;
+	}//for y
+}
+
+template< EDepthFormat FORMAT >
+static
+void RasterizePartiallyCoveredTile_SSE( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	//Assert( iBlockX <= W-TILE_SIZE_X );
+	//Assert( iBlockY <= H-TILE_SIZE_Y );
+
+	RasterizeTriangleRect_SSE< FORMAT >( face, iBlockX, iBlockY, iBlockX + TILE_SIZE_X, iBlockY + TILE_SIZE_Y, context );
+
+	//SoftRenderer::Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, iBlockX, iBlockY, TILE_SIZE_X, TILE_SIZE_Y );
+}
+
+// rasterizes a small triangle (see IsSmallTriangle()) inside its bounding rectangle:
+// only the quads of the tile which overlap the rectangle are visited
+template< EDepthFormat FORMAT >
+static
+void RasterizeSmallTriangle_SSE( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	// bounding rectangle in pixels (the tile contains it), starts at a quad boundary
+	const INT32 FP_ROUND = (1 << FP_SHIFT) - 1;
+	const UINT nStartX = largest( (Min3(face.FPX[0], face.FPX[1], face.FPX[2]) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockX ) & ~(SSE_REG_WIDTH - 1);
+	const UINT nStartY = largest( (Min3(face.FPY[0], face.FPY[1], face.FPY[2]) + FP_ROUND) >> FP_SHIFT, (INT32)iBlockY );
+	const UINT nEndX = face.maxX;
+	const UINT nEndY = face.maxY;
+	Assert( nEndX <= iBlockX + TILE_SIZE_X && nEndY <= iBlockY + TILE_SIZE_Y );
+
+	RasterizeTriangleRect_SSE< FORMAT >( face, nStartX, nStartY, nEndX, nEndY, context );
+}
+
+enum EBlockCoverage
+{
+	Block_Outside,
+	Block_PartiallyCovered,
+	Block_FullyCovered
+};
+
+// classifies a screen block against the three edges of a triangle;
+// qiE00 holds the values of the edge functions in the top-left corner of the block (one edge per lane, 4th lane is zero),
+// qiCorners holds the increments of the edge functions to the top-right, bottom-left and bottom-right corners
+static FORCEINLINE
+EBlockCoverage ClassifyBlock_SSE( const __m128i qiE00, const __m128i (&qiCorners)[3] )
+{
+	// sign bits are set for corners outside the edges
+	const int m00 = _mm_movemask_ps( _mm_castsi128_ps( qiE00 ) );
+	const int m10 = _mm_movemask_ps( _mm_castsi128_ps( _mm_add_epi32( qiE00, qiCorners[0] ) ) );
+	const int m01 = _mm_movemask_ps( _mm_castsi128_ps( _mm_add_epi32( qiE00, qiCorners[1] ) ) );
+	const int m11 = _mm_movemask_ps( _mm_castsi128_ps( _mm_add_epi32( qiE00, qiCorners[2] ) ) );
+
+	// skip block when all four corners are outside an edge => outside the triangle
+	if( m00 & m10 & m01 & m11 ) {
+		return Block_Outside;
+	}
+	// whole block is covered if all four corners are inside all edges
+	return (m00 | m10 | m01 | m11) ? Block_PartiallyCovered : Block_FullyCovered;
+}
+
+// hierarchical Z: returns true if the triangle is behind the farthest depth value stored in the given screen tile;
+// fNearestCornerZ is the depth increment from the top-left corner of a tile to the corner where the depth plane is lowest
+static FORCEINLINE
+bool IsTileOccluded( const XTriangle& face, INT32 iBlockX, INT32 iBlockY, F4 fNearestCornerZ, const SoftRenderContext& context )
+{
+	if( !context.tileMaxDepth ) {
+		return false;
+	}
+
+	// relative tolerance for rounding errors: the tile rasterizers interpolate depth in a slightly different order
+	const F4 HIZ_EPSILON = 1e-5f;
+
+	const F4 fZ1 = face.v1.P.z;
+	const F4 fZx = face.vZ.x * ((F4)iBlockX - face.v1.P.x);
+	const F4 fZy = face.vZ.y * ((F4)iBlockY - face.v1.P.y);
+	const F4 fTileMinZ = fZ1 + fZx + fZy + fNearestCornerZ;
+	const F4 fTolerance = HIZ_EPSILON * (Abs(fZ1) + Abs(fZx) + Abs(fZy) + Abs(fNearestCornerZ));
+
+	const UINT iDepthTile = (iBlockY / SoftFrameBuffer::HIZ_TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / SoftFrameBuffer::HIZ_TILE_SIZE_X);
+	if( fTileMinZ - fTolerance > context.tileMaxDepth[ iDepthTile ] )
+	{
+		context.stats->numOccludedTiles++;
+		return true;
+	}
+	return false;
+}
+
+// bins a triangle which has already been set up into the screen tiles it overlaps;
+// BLOCK_SIZE_X=16 and BLOCK_SIZE_Y=8 are good values
+template< UINT BLOCK_SIZE_X, UINT BLOCK_SIZE_Y >
+static inline
+void BinTriangle( const XTriangle& face, UINT faceIndex, srFrontEndChunk* chunk, const SoftRenderContext& context )
+{
+	mxSTATIC_ASSERT_ISPOW2( BLOCK_SIZE_X );
+	mxSTATIC_ASSERT_ISPOW2( BLOCK_SIZE_Y );
+
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	// 28.4 fixed-point
+	const INT32 X1 = face.FPX[0];
+	const INT32 X2 = face.FPX[1];
+	const INT32 X3 = face.FPX[2];
+
+	const INT32 Y1 = face.FPY[0];
+	const INT32 Y2 = face.FPY[1];
+	const INT32 Y3 = face.FPY[2];
+
+	// deltas
+	const INT32 DeltaX12 = X1 - X2;
+	const INT32 DeltaX23 = X2 - X3;
+	const INT32 DeltaX31 = X3 - X1;
+
+	const INT32 DeltaY12 = Y1 - Y2;
+	const INT32 DeltaY23 = Y2 - Y3;
+	const INT32 DeltaY31 = Y3 - Y1;
+
+	// half-edge constants in 28.4 (corrected for top-left fill convention)
+	const INT32 C1 = face.C1;
+	const INT32 C2 = face.C2;
+	const INT32 C3 = face.C3;
+
+	// bounding rectangle of this triangle in screen space
+	const INT32 nMinX = face.minX;
+	const INT32 nMaxX = face.maxX;
+	const INT32 nMinY = face.minY;
+	const INT32 nMaxY = face.maxY;
+
+	Assert( nMinX % BLOCK_SIZE_X == 0 );
+	Assert( nMinY % BLOCK_SIZE_Y == 0 );
+
+	// hierarchical Z: the nearest depth of the triangle in a tile is found at the tile corner where the depth plane is lowest
+	mxSTATIC_ASSERT( BLOCK_SIZE_X == SoftFrameBuffer::HIZ_TILE_SIZE_X );
+	mxSTATIC_ASSERT( BLOCK_SIZE_Y == SoftFrameBuffer::HIZ_TILE_SIZE_Y );
+
+	const F4 fNearestCornerZ = smallest( face.vZ.x * (BLOCK_SIZE_X - 1), 0.0f ) + smallest( face.vZ.y * (BLOCK_SIZE_Y - 1), 0.0f );
+
+	// a small triangle overlaps only one tile, the tile rasterizer will find the covered pixels;
+	// the tile is binned like any other tile, so triangles in each screen tile stay in submission order
+	mxSTATIC_ASSERT( BLOCK_SIZE_X == TILE_SIZE_X && BLOCK_SIZE_Y == TILE_SIZE_Y );
+	if( IsSmallTriangle( face ) )
+	{
+		if( nMinX < nMaxX && nMinY < nMaxY && !IsTileOccluded( face, nMinX, nMinY, fNearestCornerZ, context ) )
+		{
+			srTile& newTile = AllocateTile( chunk );
+			newTile.iFace = faceIndex;
+			newTile.SetX( nMinX );
+			newTile.SetY( nMinY );
+			newTile.bFullyCovered = 0;
+		}
+		context.stats->numSmallTriangles++;
+		return;
+	}
+
+	mxSTATIC_ASSERT( SUPER_TILE_SIZE % BLOCK_SIZE_X == 0 );
+	mxSTATIC_ASSERT( SUPER_TILE_SIZE % BLOCK_SIZE_Y == 0 );
+
+	// increments of the edge functions for the given offset in 28.4 fixed-point, one edge per lane
+#define EDGE_OFFSETS( FX, FY )\
+	_mm_set_epi32( 0,\
+		DeltaX31 * (FY) - DeltaY31 * (FX),\
+		DeltaX23 * (FY) - DeltaY23 * (FX),\
+		DeltaX12 * (FY) - DeltaY12 * (FX) )
+
+	// from the top-left corner of a block to its other corners
+	const __m128i qiSuperTileCorners[3] = {
+		EDGE_OFFSETS( (SUPER_TILE_SIZE - 1) << FP_SHIFT, 0 ),
+		EDGE_OFFSETS( 0, (SUPER_TILE_SIZE - 1) << FP_SHIFT ),
+		EDGE_OFFSETS( (SUPER_TILE_SIZE - 1) << FP_SHIFT, (SUPER_TILE_SIZE - 1) << FP_SHIFT )
+	};
+	const __m128i qiTileCorners[3] = {
+		EDGE_OFFSETS( (BLOCK_SIZE_X - 1) << FP_SHIFT, 0 ),
+		EDGE_OFFSETS( 0, (BLOCK_SIZE_Y - 1) << FP_SHIFT ),
+		EDGE_OFFSETS( (BLOCK_SIZE_X - 1) << FP_SHIFT, (BLOCK_SIZE_Y - 1) << FP_SHIFT )
+	};
+
+	// from one block to the next one
+	const __m128i qiSuperTileStepX = EDGE_OFFSETS( SUPER_TILE_SIZE << FP_SHIFT, 0 );
+	const __m128i qiSuperTileStepY = EDGE_OFFSETS( 0, SUPER_TILE_SIZE << FP_SHIFT );
+	const __m128i qiTileStepX = EDGE_OFFSETS( BLOCK_SIZE_X << FP_SHIFT, 0 );
+	const __m128i qiTileStepY = EDGE_OFFSETS( 0, BLOCK_SIZE_Y << FP_SHIFT );
+
+	// start in the corner of a super tile
+	const INT32 nSuperMinX = nMinX & ~(SUPER_TILE_SIZE - 1);
+	const INT32 nSuperMinY = nMinY & ~(SUPER_TILE_SIZE - 1);
+
+	// edge functions in the top-left corner of the first super tile
+	__m128i qiSuperTileRow = _mm_add_epi32(
+		_mm_set_epi32( 0, C3, C2, C1 ),
+		EDGE_OFFSETS( nSuperMinX << FP_SHIFT, nSuperMinY << FP_SHIFT )
+	);
+
+	for( INT32 iSuperY = nSuperMinY; iSuperY < nMaxY; iSuperY += SUPER_TILE_SIZE )
+	{
+		__m128i qiSuperTile = qiSuperTileRow;
+
+		for( INT32 iSuperX = nSuperMinX; iSuperX < nMaxX; iSuperX += SUPER_TILE_SIZE )
+		{
+			const EBlockCoverage superTileCoverage = ClassifyBlock_SSE( qiSuperTile, qiSuperTileCorners );
+
+			if( superTileCoverage != Block_Outside )
+			{
+				// tiles of this super tile inside the bounding rectangle
+				const INT32 nTileMinX = largest( iSuperX, nMinX );
+				const INT32 nTileMaxX = smallest( iSuperX + SUPER_TILE_SIZE, nMaxX );
+				const INT32 nTileMinY = largest( iSuperY, nMinY );
+				const INT32 nTileMaxY = smallest( iSuperY + SUPER_TILE_SIZE, nMaxY );
+
+				__m128i qiTileRow = _mm_add_epi32(
+					qiSuperTile,
+					EDGE_OFFSETS( (nTileMinX - iSuperX) << FP_SHIFT, (nTileMinY - iSuperY) << FP_SHIFT )
+				);
+
+				for( INT32 iBlockY = nTileMinY; iBlockY < nTileMaxY; iBlockY += BLOCK_SIZE_Y )
+				{
+					__m128i qiTile = qiTileRow;
+
+					for( INT32 iBlockX = nTileMinX; iBlockX < nTileMaxX; iBlockX += BLOCK_SIZE_X )
+					{
+						// all tiles of a fully covered super tile are fully covered
+						const EBlockCoverage tileCoverage = (superTileCoverage == Block_FullyCovered)
+							? Block_FullyCovered : ClassifyBlock_SSE( qiTile, qiTileCorners );
+
+						if( tileCoverage != Block_Outside && !IsTileOccluded( face, iBlockX, iBlockY, fNearestCornerZ, context ) )
+						{
+							srTile& newTile = AllocateTile( chunk );
+							newTile.iFace = faceIndex;
+							newTile.SetX( iBlockX );
+							newTile.SetY( iBlockY );
+							newTile.bFullyCovered = (tileCoverage == Block_FullyCovered);
+						}
+
+						qiTile = _mm_add_epi32( qiTile, qiTileStepX );
+
+					}//for each tile on X axis
+
+					qiTileRow = _mm_add_epi32( qiTileRow, qiTileStepY );
+
+				}//for each tile on Y axis
+			}
+
+			qiSuperTile = _mm_add_epi32( qiSuperTile, qiSuperTileStepX );
+
+		}//for each super tile on X axis
+
+		qiSuperTileRow = _mm_add_epi32( qiSuperTileRow, qiSuperTileStepY );
+
+	}//for each super tile on Y axis
+
+#undef EDGE_OFFSETS
+}
+
+// sets up the triangles added to the face buffer since the last call (in batches, with SIMD code)
+// and bins them in submission order
+template< UINT BLOCK_SIZE_X, UINT BLOCK_SIZE_Y >
+static inline
+void SetupAndBinTriangles( srFrontEndChunk* chunk )
+{
+	const UINT numFaces = chunk->numFaces - chunk->numSetupFaces;
+	if( !numFaces ) {
+		return;
+	}
+
+	mxPROFILE_SCOPE("Setup Triangles");
+
+	srTileRenderer* renderer = chunk->renderer;
+
+	const UINT firstFace = chunk->firstFace + chunk->numSetupFaces;
+	XTriangle* faces = renderer->m_transformedFaces + firstFace;
+
+	(*renderer->m_setupTriangles)( faces, numFaces, chunk->context );
+
+	for( UINT i = 0; i < numFaces; i++ )
+	{
+		BinTriangle< BLOCK_SIZE_X, BLOCK_SIZE_Y >( faces[i], firstFace + i, chunk, chunk->context );
+	}
+
+	chunk->numSetupFaces = chunk->numFaces;
+}
+
+// adds a projected triangle to the face buffer; triangles are set up and binned in batches
+template< UINT BLOCK_SIZE_X, UINT BLOCK_SIZE_Y >
+static inline
+void F_ProcessTriangle(
+								 //NOTABUG: swap v2 and v3 because of triangle winding order and our edge functions sign calculation
+								 const XVertex& v1, const XVertex& v3, const XVertex& v2,
+								 const SoftRenderContext& context
+						   )
+{
+	mxPROFILE_SCOPE("Process Triangle (Insert Transformed Triangle)");
+
+	srFrontEndChunk* chunk = c_cast(srFrontEndChunk*) context.userPointer;
+	srTileRenderer* renderer = chunk->renderer;
+
+	// the slice of the face buffer owned by this chunk is sized for the worst case of clipping
+	Assert( chunk->numFaces < chunk->maxFaces );
+
+	const UINT newFaceIndex = chunk->firstFace + chunk->numFaces++;
+	Assert( newFaceIndex < NUM_FACE_BUFFERS * FACE_BUFFER_SIZE );
+
+	XTriangle & face = renderer->m_transformedFaces[ newFaceIndex ];
+
+	face.v1 = v1;
+	face.v2 = v2;
+	face.v3 = v3;
+
+	Assert( renderer->m_numDrawCalls > 0 );
+	face.iDrawCall = renderer->m_numDrawCalls - 1;
+
+	if( chunk->numFaces - chunk->numSetupFaces == SETUP_BATCH_SIZE )
+	{
+		SetupAndBinTriangles< BLOCK_SIZE_X, BLOCK_SIZE_Y >( chunk );
+	}
+}
+
+srTileRenderer::srTileRenderer( UINT width, UINT height )
+{
+	m_worldMatrix = XMMatrixIdentity();
+	m_viewMatrix = XMMatrixIdentity();
+	m_projectionMatrix = XMMatrixIdentity();
+
+	m_vertexShader = nil;
+	m_vertexShader4 = nil;
+#if SOFT_RENDER_USE_AVX
+	m_vertexShader8 = nil;
+#endif // SOFT_RENDER_USE_AVX
+	m_pixelShader = nil;
+	m_pixelShader4 = nil;
+#if SOFT_RENDER_USE_AVX
+	m_pixelShader8 = nil;
+#endif // SOFT_RENDER_USE_AVX
+
+	m_cullMode = ECullMode::Cull_CCW;
+	m_fillMode = EFillMode::Fill_Solid;
+
+	DBGOUT("srTileRenderer(): size of face buffer: %u KiB\n", sizeof m_transformedFaces /mxKIBIBYTE);
+
+	for( UINT iFaceBuffer = 0; iFaceBuffer < NUM_FACE_BUFFERS; iFaceBuffer++ )
+	{
+		srFaceBuffer & faces = m_faceBuffers[ iFaceBuffer ];
+		faces.firstFace = iFaceBuffer * FACE_BUFFER_SIZE;
+		faces.numFaces = 0;
+		faces.tiles.Clear();
+	}
+	m_iCurrentFaceBuffer = 0;
+	m_numPendingFaceBuffers = 0;
+
+	m_numDrawCalls = 0;
+	m_deferRasterization = true;
+
+	m_setupTriangles = &SetupTriangles_SSE;
+	m_cpuMode = CpuMode_Use_SSE;
+	m_useCoverageMasks = false;
+	this->SelectTileKernels();
+	m_useNonTemporalStores = false;
+
+	//m_numFullyCoveredTiles = 0;
+	m_peakBinnedTiles = 0;
+
+	m_maxSortedTiles = 2048;
+	m_tiles = (srTile*) mxAlloc( m_maxSortedTiles * sizeof m_tiles[0] );
+	m_sortedTiles = (srTile*) mxAlloc( m_maxSortedTiles * sizeof m_sortedTiles[0] );
+
+	// each chunk starts with one block in its pool
+	srTileBlockList initialBlocks;
+	initialBlocks.Clear();
+	for( UINT iChunk = 0; iChunk < MAX_FRONT_END_JOBS; iChunk++ )
+	{
+		srFrontEndChunk & chunk = m_frontEndChunks[ iChunk ];
+		chunk.renderer = this;
+		chunk.iChunk = iChunk;
+		chunk.tiles.Clear();
+		chunk.freeBlocks = nil;
+		chunk.numBlocks = 0;
+
+		AllocateTileBlock( &chunk );
+		initialBlocks.Append( chunk.tiles );
+	}
+	this->RecycleTileBlocks( initialBlocks );
+
+	m_numTilesX = (width + TILE_SIZE_X - 1) / TILE_SIZE_X;
+	m_numTilesY = (height + TILE_SIZE_Y - 1) / TILE_SIZE_Y;
+	m_binOffsets = (UINT*) mxAlloc( (m_numTilesX * m_numTilesY + 1) * sizeof m_binOffsets[0] );
+
+	//-----------------------------------------------------------------
+
+	ZERO_OUT(m_ftblProcessTriangles);
+	ZERO_OUT(m_ftblDrawTriangle);
+
+#define INSTALL_PROCESS_TRIANGLES_FUNC( CULL, FILL )\
+	m_ftblProcessTriangles[CULL][FILL] = &Template_ProcessTriangles<CULL,FILL>
+
+#define INSTALL_PROCESS_TRIANGLES_FUNC_CULL( CULL )\
+	m_ftblProcessTriangles[Fill_Solid][CULL] = &Template_ProcessTriangles<Fill_Solid,CULL>;\
+	m_ftblProcessTriangles[Fill_Wireframe][CULL] = &Template_ProcessTriangles<Fill_Wireframe,CULL>;\
+
+
+
+	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_None );
+	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_CW );
+	INSTALL_PROCESS_TRIANGLES_FUNC_CULL( Cull_CCW );
+
+
+
+#undef INSTALL_PROCESS_TRIANGLES_FUNC_CULL
 #undef INSTALL_PROCESS_TRIANGLES_FUNC
 
 
@@ -639,15 +959,41 @@ srTileRenderer::srTileRenderer( UINT width, UINT height )
 
 srTileRenderer::~srTileRenderer()
 {
-	DBGOUT("~srTileRenderer(): %u tiles (%u KiB)\n",
-		m_maxTiles, m_maxTiles*sizeof m_tiles[0] /mxKIBIBYTE);
+	// return blocks of tiles which have not been rasterized
+	for( UINT iFaceBuffer = 0; iFaceBuffer < NUM_FACE_BUFFERS; iFaceBuffer++ )
+	{
+		this->RecycleTileBlocks( m_faceBuffers[ iFaceBuffer ].tiles );
+	}
+
+	UINT numBlocks = 0;
+	for( UINT iChunk = 0; iChunk < MAX_FRONT_END_JOBS; iChunk++ )
+	{
+		srFrontEndChunk & chunk = m_frontEndChunks[ iChunk ];
+		numBlocks += chunk.numBlocks;
+
+		srTileBlock* block = chunk.freeBlocks;
+		while( block )
+		{
+			srTileBlock* next = block->next;
+			mxFree( block );
+			block = next;
+		}
+		chunk.freeBlocks = nil;
+		chunk.numBlocks = 0;
+	}
+
+	DBGOUT("~srTileRenderer(): %u tile blocks (%u KiB), max. %u binned tiles, sort buffers: %u tiles (%u KiB)\n",
+		numBlocks, numBlocks*sizeof srTileBlock /mxKIBIBYTE, m_peakBinnedTiles,
+		m_maxSortedTiles, 2*m_maxSortedTiles*sizeof m_tiles[0] /mxKIBIBYTE);
 
 	mxFree( m_tiles );
 	mxFree( m_sortedTiles );
+	mxFree( m_binOffsets );
 	m_tiles = nil;
-	m_numTiles = 0;
+	m_sortedTiles = nil;
+	m_binOffsets = nil;
 	//m_numFullyCoveredTiles = 0;
-	m_maxTiles = 0;
+	m_maxSortedTiles = 0;
 }
 
 void srTileRenderer::SetWorldMatrix( const float4x4& newWorldMatrix )
@@ -665,268 +1011,1048 @@ void srTileRenderer::SetProjectionMatrix( const float4x4& newProjectionMatrix )
 	m_projectionMatrix = newProjectionMatrix;
 }
 
-void srTileRenderer::SetCullMode( ECullMode newCullMode )
+void srTileRenderer::SetCullMode( ECullMode newCullMode )
+{
+	m_cullMode = newCullMode;
+}
+
+void srTileRenderer::SetFillMode( EFillMode newFillMode )
+{
+	m_fillMode = newFillMode;
+}
+
+void srTileRenderer::SetVertexShader( F_VertexShader* newVertexShader )
+{
+	m_vertexShader = newVertexShader;
+}
+
+void srTileRenderer::SetVertexShader4( F_VertexShader4* newVertexShader )
+{
+	m_vertexShader4 = newVertexShader;
+}
+
+#if SOFT_RENDER_USE_AVX
+void srTileRenderer::SetVertexShader8( F_VertexShader8* newVertexShader )
+{
+	m_vertexShader8 = newVertexShader;
+}
+#endif // SOFT_RENDER_USE_AVX
+
+void srTileRenderer::SetPixelShader( F_PixelShader* newPixelShader )
+{
+	m_pixelShader = newPixelShader;
+}
+
+void srTileRenderer::SetPixelShader4( F_PixelShader4* newPixelShader )
+{
+	m_pixelShader4 = newPixelShader;
+}
+
+#if SOFT_RENDER_USE_AVX
+void srTileRenderer::SetPixelShader8( F_PixelShader8* newPixelShader )
+{
+	m_pixelShader8 = newPixelShader;
+}
+#endif // SOFT_RENDER_USE_AVX
+
+void srTileRenderer::SetTexture( SoftTexture2D* newTexture2D )
+{
+	m_texture = newTexture2D;
+}
+
+void srTileRenderer::ModifySettings( const Settings& newSettings )
+{
+	m_useNonTemporalStores = newSettings.bNonTemporalStores;
+
+	if( m_deferRasterization != newSettings.bDeferredRasterization )
+	{
+		this->Flush();
+		m_deferRasterization = newSettings.bDeferredRasterization;
+	}
+
+	// select tile rasterization kernels
+	// (the mode has already been clamped to the ones supported by the CPU)
+	if( m_cpuMode != newSettings.mode || m_useCoverageMasks != newSettings.bCoverageMasks )
+	{
+		// binned tiles must be rasterized with the kernels they were binned for
+		this->Flush();
+
+		switch( newSettings.mode )
+		{
+		case CpuMode_Use_FPU :
+			m_setupTriangles = &SetupTriangles_FPU;
+			m_cpuMode = CpuMode_Use_FPU;
+			break;
+#if SOFT_RENDER_USE_AVX
+		case CpuMode_Use_AVX :
+			m_setupTriangles = &SetupTriangles_AVX2;
+			m_cpuMode = CpuMode_Use_AVX;
+			break;
+#endif // SOFT_RENDER_USE_AVX
+#if SOFT_RENDER_USE_AVX512
+		case CpuMode_Use_AVX512 :
+			m_setupTriangles = &SetupTriangles_AVX2;
+			m_cpuMode = CpuMode_Use_AVX512;
+			break;
+#endif // SOFT_RENDER_USE_AVX512
+		default:
+			m_setupTriangles = &SetupTriangles_SSE;
+			m_cpuMode = CpuMode_Use_SSE;
+		}
+
+		m_useCoverageMasks = newSettings.bCoverageMasks;
+
+		this->SelectTileKernels();
+	}
+}
+
+// picks the tile rasterization kernels for the given instruction set and depth format
+template< EDepthFormat FORMAT >
+static
+void Template_SelectTileKernels( ECpuMode cpuMode, bool bCoverageMasks, srTileKernels & kernels )
+{
+	switch( cpuMode )
+	{
+	case CpuMode_Use_FPU :
+		kernels.rasterizeFullyCoveredTile = &RasterizeFullyCoveredTile_FPU< FORMAT >;
+		kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_FPU< FORMAT >;
+		kernels.rasterizeSmallTriangle = &RasterizeSmallTriangle_FPU< FORMAT >;
+		kernels.shadeFullyCoveredTile = &ShadeFullyCoveredTile_FPU;
+		break;
+#if SOFT_RENDER_USE_AVX
+	case CpuMode_Use_AVX :
+		kernels.rasterizeFullyCoveredTile = &RasterizeFullyCoveredTile_AVX2< FORMAT >;
+		kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_AVX2< FORMAT >;
+		kernels.rasterizeSmallTriangle = &RasterizeSmallTriangle_AVX2< FORMAT >;
+		kernels.shadeFullyCoveredTile = &ShadeFullyCoveredTile_AVX2;
+		break;
+#endif // SOFT_RENDER_USE_AVX
+#if SOFT_RENDER_USE_AVX512
+	case CpuMode_Use_AVX512 :
+		kernels.rasterizeFullyCoveredTile = &RasterizeFullyCoveredTile_AVX512< FORMAT >;
+		kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_AVX512< FORMAT >;
+		kernels.rasterizeSmallTriangle = &RasterizeSmallTriangle_AVX2< FORMAT >;
+		kernels.shadeFullyCoveredTile = &ShadeFullyCoveredTile_AVX2;
+		break;
+#endif // SOFT_RENDER_USE_AVX512
+	default:
+		kernels.rasterizeFullyCoveredTile = &RasterizeFullyCoveredTile_SSE< FORMAT >;
+		kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_SSE< FORMAT >;
+		kernels.rasterizeSmallTriangle = &RasterizeSmallTriangle_SSE< FORMAT >;
+		kernels.shadeFullyCoveredTile = &ShadeFullyCoveredTile_SSE;
+	}
+
+	if( bCoverageMasks )
+	{
+		switch( cpuMode )
+		{
+		case CpuMode_Use_FPU :
+			break;
+#if SOFT_RENDER_USE_AVX
+		case CpuMode_Use_AVX :
+		case CpuMode_Use_AVX512 :
+			kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_Masks_AVX2< FORMAT >;
+			break;
+#endif // SOFT_RENDER_USE_AVX
+		default:
+			kernels.rasterizePartiallyCoveredTile = &RasterizePartiallyCoveredTile_Masks_SSE< FORMAT >;
+		}
+	}
+}
+
+// fills the kernel table for all depth formats (the format is taken from the framebuffer of each draw call)
+void srTileRenderer::SelectTileKernels()
+{
+	Template_SelectTileKernels< DepthFormat_F32 >( m_cpuMode, m_useCoverageMasks, m_tileKernels[ DepthFormat_F32 ] );
+	Template_SelectTileKernels< DepthFormat_D24 >( m_cpuMode, m_useCoverageMasks, m_tileKernels[ DepthFormat_D24 ] );
+	Template_SelectTileKernels< DepthFormat_D16 >( m_cpuMode, m_useCoverageMasks, m_tileKernels[ DepthFormat_D16 ] );
+}
+
+ECpuMode srTileRenderer::GetCpuMode() const
+{
+	return m_cpuMode;
+}
+
+void srTileRenderer::Flush()
+{
+	// rasterize all slices in submission order
+	while( m_numPendingFaceBuffers )
+	{
+		this->RasterizePendingFaceBuffer();
+	}
+	this->RasterizeTiles( m_faceBuffers[ m_iCurrentFaceBuffer ] );
+	m_numDrawCalls = 0;
+}
+
+void srTileRenderer::DrawTriangles( SoftFrameBuffer& frameBuffer, const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numIndices )
+{
+	CHK_VRET_IF_NIL(m_vertexShader);
+	CHK_VRET_IF_NIL(m_pixelShader);
+
+	mxPROFILE_SCOPE("srTileRenderer :: Draw Triangles");
+
+	// render states of all binned triangles must stay alive until they are rasterized
+	if( m_numDrawCalls == MAX_DRAW_CALLS )
+	{
+		this->Flush();
+	}
+
+	srDrawCall & drawCall = m_drawCalls[ m_numDrawCalls++ ];
+
+
+	//const float4x4	worldViewMatrix = XMMatrixMultiply( m_worldMatrix, m_viewMatrix );
+	const float4x4  viewProjectionMatrix = XMMatrixMultiply( m_viewMatrix, m_projectionMatrix );
+	const float4x4	worldViewProjectionMatrix = XMMatrixMultiply( m_worldMatrix, viewProjectionMatrix );
+
+	ShaderGlobals &	shaderGlobals = drawCall.globals;
+	shaderGlobals.worldMatrix = m_worldMatrix;
+	//shaderGlobals.viewMatrix = m_viewMatrix;
+	//shaderGlobals.projectionMatrix = m_projectionMatrix;
+	shaderGlobals.WVP = worldViewProjectionMatrix;
+	shaderGlobals.texture = m_texture;
+
+	SoftRenderContext &	renderContext = drawCall.context;
+	renderContext.globals = &shaderGlobals;
+	renderContext.vertexShader = m_vertexShader;
+	// batch vertex shaders are only used with the selected instruction set
+	renderContext.vertexShader4 = (m_cpuMode >= CpuMode_Use_SSE) ? m_vertexShader4 : nil;
+#if SOFT_RENDER_USE_AVX
+	renderContext.vertexShader8 = (m_cpuMode >= CpuMode_Use_AVX) ? m_vertexShader8 : nil;
+#endif // SOFT_RENDER_USE_AVX
+	renderContext.pixelShader = m_pixelShader;
+	renderContext.pixelShader4 = m_pixelShader4;
+#if SOFT_RENDER_USE_AVX
+	renderContext.pixelShader8 = m_pixelShader8;
+#endif // SOFT_RENDER_USE_AVX
+	renderContext.colorBuffer = frameBuffer.m_tiledLayout ? frameBuffer.m_tiledColorBuffer : frameBuffer.m_colorBuffer;
+	renderContext.depthBuffer = frameBuffer.m_depthBuffer;
+	renderContext.depthFormat = frameBuffer.m_depthFormat;
+	renderContext.bTiledLayout = frameBuffer.m_tiledLayout;
+	renderContext.tileMaxDepth = frameBuffer.m_tileMaxDepth;
+	renderContext.numDepthTilesX = frameBuffer.m_numDepthTilesX;
+	renderContext.frameBuffer = &frameBuffer;
+	renderContext.userPointer = nil;	// points to the front-end chunk
+	renderContext.stats = nil;	// points to the statistics of the front-end chunk
+
+	renderContext.W = frameBuffer.m_viewportWidth;
+	renderContext.H = frameBuffer.m_viewportHeight;
+	renderContext.W2 = frameBuffer.m_viewportWidth * 0.5f;
+	renderContext.H2 = frameBuffer.m_viewportHeight * 0.5f;
+	renderContext.subPixelBits = frameBuffer.m_subPixelBits;
+
+	// shade all vertices in advance if a SIMD vertex shader is available
+	renderContext.transformedVertices = m_transformedVertices.TransformVertices( vertices, numVertices, renderContext );
+
+
+
+
+	const UINT numFaces = numIndices / 3;
+
+	//DBGOUT( "\nBEGIN: srTileRenderer::DrawTriangles: %u faces\n", numFaces );
+
+	// Break this up into batches which fit into the face buffer
+	UINT trianglesSoFar = 0;
+	while( trianglesSoFar < numFaces )
+	{
+		if( FACE_BUFFER_SIZE - m_faceBuffers[ m_iCurrentFaceBuffer ].numFaces < FACES_PER_INPUT_TRIANGLE )
+		{
+			this->SubmitFaceBuffer();
+		}
+
+		const UINT numFreeFaces = FACE_BUFFER_SIZE - m_faceBuffers[ m_iCurrentFaceBuffer ].numFaces;
+		const UINT trianglesLeft = numFaces - trianglesSoFar;
+		const UINT batchSize = smallest( trianglesLeft, numFreeFaces / FACES_PER_INPUT_TRIANGLE );
+
+		this->BinTriangles( vertices, numVertices, indices + trianglesSoFar*3, batchSize, renderContext );
+		trianglesSoFar += batchSize;
+	}
+
+	// the shaded vertices will be overwritten by the next draw call
+	renderContext.transformedVertices = nil;
+
+	// in deferred mode binned triangles are rasterized at the end of the frame
+	if( !m_deferRasterization )
+	{
+		this->Flush();
+	}
+
+	//DBGOUT( "\nEND: srTileRenderer::DrawTriangles: %u faces\n", numFaces );
+
+	SoftRenderer::stats.numTrianglesRendered += numFaces;
+}
+
+static const ARGB32 THREAD_COLORS[8] =
+{
+	ARGB8_RED,
+	ARGB8_GREEN,
+	ARGB8_BLUE,
+	ARGB8_YELLOW,
+	ARGB8_WHITE,
+	ARGB8_WHITE,
+	ARGB8_WHITE,
+	ARGB8_WHITE,
+};
+
+// rasterizes triangles of a contiguous range of screen tiles (bins);
+// each screen tile is owned by exactly one job, so that no two threads ever touch the same pixels
+// and triangles are drawn in submission order (the result is deterministic).
+enum { MAX_RASTERIZER_JOBS = 256 };
+
+struct RasterizeScreenTilesJob : AsyncJob
+{
+	srTileRenderer*	m_renderer;
+	UINT	m_firstBin;
+	UINT	m_numBins;
+
+public:
+	RasterizeScreenTilesJob()
+	{
+		m_renderer = nil;
+		m_firstBin = 0;
+		m_numBins = 0;
+	}
+	virtual void Run( const AsyncJob::Context& context ) override
+	{
+		this->Execute( context.threadNumber );
+	}
+	// also called directly when threading is disabled
+	void Execute( UINT threadNumber )
+	{
+		const srTile* sortedTiles = m_renderer->m_sortedTiles;
+		const UINT* binOffsets = m_renderer->m_binOffsets;
+
+		// the current screen tile, kept in L1 cache
+		srTileScratch	scratch;
+
+		const UINT lastBin = m_firstBin+m_numBins;
+		for( UINT iBin = m_firstBin; iBin < lastBin; iBin++ )
+		{
+			const UINT iFirstTile = binOffsets[ iBin ];
+			const UINT iLastTile = binOffsets[ iBin+1 ];
+
+			// copying is only worth it if the screen tile is drawn more than once
+			// (tiles of framebuffers with tiled layout are always rendered in place)
+			if( iLastTile - iFirstTile > 1 || (iFirstTile < iLastTile && m_renderer->GetDrawContext( sortedTiles[ iFirstTile ] ).bTiledLayout) )
+			{
+				m_renderer->RasterizeScreenTile( sortedTiles + iFirstTile, iLastTile - iFirstTile, scratch );
+				continue;
+			}
+
+			for( UINT iTile = iFirstTile; iTile < iLastTile; iTile++ )
+			{
+				const srTile& tile = sortedTiles[ iTile ];
+				m_renderer->RasterizeTile( tile );
+
+#if 0
+				const UINT colorIndex = smallest( threadNumber, NUMBER_OF(THREAD_COLORS)-1 );
+				const ARGB32 color = THREAD_COLORS[ colorIndex ];
+				DbgDrawRect( m_renderer->GetDrawContext( tile ), color, tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
+#endif
+			}
+
+			// all triangles of this screen tile have been drawn
+			if( iFirstTile < iLastTile )
+			{
+				m_renderer->UpdateTileMaxDepth( sortedTiles[ iFirstTile ] );
+			}
+		}
+
+		// make streaming stores visible to other threads
+		if( m_renderer->m_useNonTemporalStores ) {
+			_mm_sfence();
+		}
+	}
+};
+
+void srTileRenderer::RasterizeScreenTile( const srTile* tiles, UINT numTiles, srTileScratch & scratch ) const
+{
+	const UINT iBlockX = tiles[0].GetX();
+	const UINT iBlockY = tiles[0].GetY();
+
+	// the framebuffer the tile is rendered to
+	const SoftRenderContext* frameContext = &GetDrawContext( tiles[0] );
+	UINT iDrawCall = m_transformedFaces[ tiles[0].iFace ].iDrawCall;
+
+	// tiles of framebuffers with tiled layout are contiguous in memory and are rendered in place
+	if( !frameContext->bTiledLayout ) {
+		scratch.Load( *frameContext, iBlockX, iBlockY );
+	}
+
+	SoftRenderContext	tileContext = *frameContext;
+	this->BindScreenTile( tileContext, scratch, iBlockX, iBlockY );
+
+	for( UINT iTile = 0; iTile < numTiles; iTile++ )
+	{
+		const srTile& tile = tiles[ iTile ];
+		const XTriangle& face = m_transformedFaces[ tile.iFace ];
+		Assert( face.iDrawCall < m_numDrawCalls );
+
+		if( face.iDrawCall != iDrawCall )
+		{
+			iDrawCall = face.iDrawCall;
+
+			const SoftRenderContext& drawContext = m_drawCalls[ iDrawCall ].context;
+
+			// draw calls may render into different framebuffers
+			if( drawContext.colorBuffer != frameContext->colorBuffer || drawContext.depthBuffer != frameContext->depthBuffer )
+			{
+				if( !frameContext->bTiledLayout ) {
+					scratch.Store( *frameContext, iBlockX, iBlockY, m_useNonTemporalStores );
+				}
+				frameContext = &drawContext;
+				if( !frameContext->bTiledLayout ) {
+					scratch.Load( *frameContext, iBlockX, iBlockY );
+				}
+			}
+
+			tileContext = drawContext;
+			this->BindScreenTile( tileContext, scratch, iBlockX, iBlockY );
+		}
+
+		this->RasterizeTile( tile, tileContext );
+	}
+
+	// the hierarchical Z buffer is shared, only the depth values are taken from the tile memory
+	UpdateTileMaxDepth_SSE( iBlockX, iBlockY, tileContext );
+
+	if( !frameContext->bTiledLayout ) {
+		scratch.Store( *frameContext, iBlockX, iBlockY, m_useNonTemporalStores );
+	}
+}
+
+// points the color and depth buffers of the given draw call context at the memory of the screen tile
+void srTileRenderer::BindScreenTile( SoftRenderContext & context, srTileScratch & scratch, UINT iBlockX, UINT iBlockY ) const
 {
-	m_cullMode = newCullMode;
+	if( context.bTiledLayout ) {
+		PrepareScreenTile( context, iBlockX, iBlockY );
+		BindTiledFrameBuffer( context, iBlockX, iBlockY );
+	} else {
+		scratch.Bind( context, iBlockX, iBlockY );
+	}
 }
 
-void srTileRenderer::SetFillMode( EFillMode newFillMode )
+enum EDepthPlaneTest
 {
-	m_fillMode = newFillMode;
-}
+	DepthPlane_InFront,		// all pixels of the tile pass the depth test
+	DepthPlane_Behind,		// all pixels of the tile fail the depth test
+	DepthPlane_Intersects	// (or the planes are too close to tell)
+};
 
-void srTileRenderer::SetVertexShader( F_VertexShader* newVertexShader )
+// compares the depth of a triangle with the depth plane of a compressed tile;
+// the difference of two planes is a plane, so its extremes are at the corners of the tile;
+// the tolerance covers the rounding errors of the depth values interpolated by the tile kernels
+static FORCEINLINE
+EDepthPlaneTest TestDepthPlane( const SoftFrameBuffer::DepthPlane& newPlane, F4 newMagnitude, const SoftFrameBuffer::DepthPlane& oldPlane )
 {
-	m_vertexShader = newVertexShader;
-}
+	const F4 fDiffX = (newPlane.dzdx - oldPlane.dzdx) * (F4)(TILE_SIZE_X - 1);
+	const F4 fDiffY = (newPlane.dzdy - oldPlane.dzdy) * (F4)(TILE_SIZE_Y - 1);
+	const F4 fDiff0 = newPlane.z0 - oldPlane.z0;
 
-void srTileRenderer::SetPixelShader( F_PixelShader* newPixelShader )
-{
-	m_pixelShader = newPixelShader;
-}
+	const F4 fMinDiff = fDiff0 + smallest( fDiffX, 0.0f ) + smallest( fDiffY, 0.0f );
+	const F4 fMaxDiff = fDiff0 + largest( fDiffX, 0.0f ) + largest( fDiffY, 0.0f );
 
-void srTileRenderer::SetTexture( SoftTexture2D* newTexture2D )
-{
-	m_texture = newTexture2D;
+	const F4 oldMagnitude = Abs( oldPlane.z0 ) + Abs( oldPlane.dzdx ) * (F4)TILE_SIZE_X + Abs( oldPlane.dzdy ) * (F4)TILE_SIZE_Y;
+	const F4 fTolerance = (newMagnitude + oldMagnitude) * (1.0f / 65536.0f);
+
+	if( fMaxDiff < -fTolerance ) {
+		return DepthPlane_InFront;
+	}
+	if( fMinDiff > fTolerance ) {
+		return DepthPlane_Behind;
+	}
+	return DepthPlane_Intersects;
 }
 
-void srTileRenderer::DrawTriangles( SoftFrameBuffer& frameBuffer, const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numIndices )
+// rasterizes a triangle into a screen tile with compressed depth:
+// a fully covered tile in front of the depth plane is shaded without depth testing and its plane is replaced,
+// a tile behind the depth plane is skipped;
+// otherwise the depth plane is expanded into the depth buffer and false is returned (the triangle must be rasterized as usual)
+bool srTileRenderer::RasterizeDepthPlaneTile( const srTile& tile, UINT iTile, const SoftRenderContext& context ) const
 {
-	CHK_VRET_IF_NIL(m_vertexShader);
-	CHK_VRET_IF_NIL(m_pixelShader);
+	const XTriangle& face = m_transformedFaces[ tile.iFace ];
+	const UINT iBlockX = tile.GetX();
+	const UINT iBlockY = tile.GetY();
 
-	mxPROFILE_SCOPE("srTileRenderer :: Draw Triangles");
+	SoftFrameBuffer* frameBuffer = context.frameBuffer;
+	SoftFrameBuffer::DepthPlane & plane = frameBuffer->m_depthPlanes[ iTile ];
 
+	if( tile.bFullyCovered )
+	{
+		const F4 fX = (F4)iBlockX - face.v1.P.x;
+		const F4 fY = (F4)iBlockY - face.v1.P.y;
 
-	//const float4x4	worldViewMatrix = XMMatrixMultiply( m_worldMatrix, m_viewMatrix );
-	const float4x4  viewProjectionMatrix = XMMatrixMultiply( m_viewMatrix, m_projectionMatrix );
-	const float4x4	worldViewProjectionMatrix = XMMatrixMultiply( m_worldMatrix, viewProjectionMatrix );
+		SoftFrameBuffer::DepthPlane	newPlane;
+		newPlane.z0 = face.v1.P.z + face.vZ.x * fX + face.vZ.y * fY;
+		newPlane.dzdx = face.vZ.x;
+		newPlane.dzdy = face.vZ.y;
 
-	ShaderGlobals	shaderGlobals;
-	shaderGlobals.worldMatrix = m_worldMatrix;
-	//shaderGlobals.viewMatrix = m_viewMatrix;
-	//shaderGlobals.projectionMatrix = m_projectionMatrix;
-	shaderGlobals.WVP = worldViewProjectionMatrix;
-	shaderGlobals.texture = m_texture;
+		// the depth values of the kernels are interpolated from the first vertex
+		const F4 newMagnitude = Abs( face.v1.P.z ) + Abs( face.vZ.x * fX ) + Abs( face.vZ.y * fY )
+			+ Abs( face.vZ.x ) * (F4)TILE_SIZE_X + Abs( face.vZ.y ) * (F4)TILE_SIZE_Y;
 
-	SoftRenderContext	renderContext;
-	renderContext.globals = &shaderGlobals;
-	renderContext.vertexShader = m_vertexShader;
-	renderContext.pixelShader = m_pixelShader;
-	renderContext.colorBuffer = frameBuffer.m_colorBuffer;
-	renderContext.depthBuffer = frameBuffer.m_depthBuffer;
-	renderContext.userPointer = this;
+		switch( TestDepthPlane( newPlane, newMagnitude, plane ) )
+		{
+		case DepthPlane_InFront :
+			(*m_tileKernels[ context.depthFormat ].shadeFullyCoveredTile)( face, iBlockX, iBlockY, context );
+			plane = newPlane;
+			return true;
 
-	renderContext.W = frameBuffer.m_viewportWidth;
-	renderContext.H = frameBuffer.m_viewportHeight;
-	renderContext.W2 = frameBuffer.m_viewportWidth * 0.5f;
-	renderContext.H2 = frameBuffer.m_viewportHeight * 0.5f;
+		case DepthPlane_Behind :
+			return true;
+
+		default:
+			break;
+		}
+	}
+
+	// the triangle needs per-pixel depth testing
+	// (edge tiles are clipped to the viewport, except in tiled layout where each tile has memory for all its pixels)
+	UINT x = iBlockX, y = iBlockY, numColumns = TILE_SIZE_X, numRows = TILE_SIZE_Y;
+	if( !context.bTiledLayout ) {
+		frameBuffer->GetTileRect( iTile, x, y, numColumns, numRows );
+	}
+	frameBuffer->ExpandDepthPlane( iTile, GetDepthAddress< DepthFormat_F32 >( context, iBlockX, iBlockY ), context.W, numColumns, numRows );
+	frameBuffer->m_tileFlags[ iTile ] &= ~SoftFrameBuffer::TILE_DEPTH_PLANE;
 
+	return false;
+}
 
+// makes sure that the sort buffers can hold the given number of tiles;
+// called before sorting, so the old contents need not be preserved
+void srTileRenderer::ReserveSortBuffers( UINT numTiles )
+{
+	if( numTiles > m_maxSortedTiles )
+	{
+		const UINT oldMaxTiles = m_maxSortedTiles;
 
+		m_maxSortedTiles = NextPowerOfTwo( numTiles );
 
-	const UINT numFaces = numIndices / 3;
+		mxFree( m_tiles );
+		mxFree( m_sortedTiles );
 
-	//DBGOUT( "\nBEGIN: srTileRenderer::DrawTriangles: %u faces\n", numFaces );
+		m_tiles = (srTile*) mxAlloc( m_maxSortedTiles * sizeof m_tiles[0] );
+		m_sortedTiles = (srTile*) mxAlloc( m_maxSortedTiles * sizeof m_sortedTiles[0] );
 
-	// Break this up into batches
-	UINT trianglesSoFar = 0;
-	while( trianglesSoFar + FACE_BUFFER_SIZE < numFaces )
-	{
-		this->ProcessTriangles( vertices, numVertices, indices + trianglesSoFar*3, FACE_BUFFER_SIZE, renderContext );
-		trianglesSoFar += FACE_BUFFER_SIZE;
+		DBGOUT("!!! Resizing sort buffers from %u to %u tiles (%u KiB)\n",
+			oldMaxTiles,m_maxSortedTiles,2*m_maxSortedTiles*sizeof m_tiles[0] /mxKIBIBYTE);
 	}
+}
 
-	// Handle the last set of indices, if there are any
-	UINT trianglesLeft = numFaces - trianglesSoFar;
-	if( trianglesLeft )
+// returns all blocks of the given list to the pools of their chunks
+void srTileRenderer::RecycleTileBlocks( srTileBlockList & tiles )
+{
+	srTileBlock* block = tiles.head;
+	while( block )
 	{
-		this->ProcessTriangles( vertices, numVertices, indices + trianglesSoFar*3, trianglesLeft, renderContext );
-	}
+		srTileBlock* next = block->next;
 
-	//DBGOUT( "\nEND: srTileRenderer::DrawTriangles: %u faces\n", numFaces );
+		Assert( block->iOwner < MAX_FRONT_END_JOBS );
+		srFrontEndChunk & owner = m_frontEndChunks[ block->iOwner ];
+		block->numTiles = 0;
+		block->next = owner.freeBlocks;
+		owner.freeBlocks = block;
 
-	SoftRenderer::stats.numTrianglesRendered += numFaces;
+		block = next;
+	}
+	tiles.Clear();
 }
 
-static const ARGB32 THREAD_COLORS[8] =
+// processes a slice of tiles in one phase of the parallel radix sort
+struct SortTilesJob : AsyncJob
 {
-	ARGB8_RED,
-	ARGB8_GREEN,
-	ARGB8_BLUE,
-	ARGB8_YELLOW,
-	ARGB8_WHITE,
-	ARGB8_WHITE,
-	ARGB8_WHITE,
-	ARGB8_WHITE,
-};
+	enum EPhase
+	{
+		Phase_Gather,	// copy tiles from blocks into m_src and count radix digits (first pass)
+		Phase_Count,	// count radix digits
+		Phase_Scatter,	// move tiles from m_src into their places in m_dst
+		Phase_FindBinOffsets,	// find the start of each bin in the sorted tiles
+	};
 
-struct RasterizeTilesJob : AsyncJob
-{
-	const SoftRenderContext* m_context;
 	srTileRenderer*	m_renderer;
-	srTile*	m_tiles;
+	EPhase	m_phase;
+	UINT	m_iJob;	// row in m_radixCounts
+
+	// the slice of tiles processed by this job
+	const srTileBlock *	m_firstBlock;
+	const srTileBlock *	m_endBlock;	// one past the last block
 	UINT	m_firstTile;
 	UINT	m_numTiles;
 
+	srTile *	m_src;
+	srTile *	m_dst;
+	UINT		m_shift;	// position of the radix digit
+	UINT		m_mask;
+
 public:
-	RasterizeTilesJob()
+	SortTilesJob()
 	{
-		m_context = nil;
 		m_renderer = nil;
-		m_tiles = nil;
+		m_phase = Phase_Count;
+		m_iJob = 0;
+		m_firstBlock = nil;
+		m_endBlock = nil;
 		m_firstTile = 0;
 		m_numTiles = 0;
+		m_src = nil;
+		m_dst = nil;
+		m_shift = 0;
+		m_mask = 0;
 	}
 	virtual void Run( const AsyncJob::Context& context ) override
 	{
-		const SoftRenderContext& drawContext = *m_context;
-		const UINT lastTile = m_firstTile+m_numTiles;
-		for( UINT iTile = m_firstTile; iTile < lastTile; iTile++ )
+		this->Execute();
+	}
+	void Execute()
+	{
+		srTileRenderer* renderer = m_renderer;
+		UINT* counts = renderer->m_radixCounts[ m_iJob ];
+
+		const UINT firstTile = m_firstTile;
+		const UINT lastTile = m_firstTile + m_numTiles;
+
+		switch( m_phase )
 		{
-			const srTile& tile = m_tiles[ iTile ];
-			if( tile.bFullyCovered )
+		case Phase_Gather :
 			{
-				RasterizeFullyCoveredTile( tile, drawContext, m_renderer );
+				MemSet( counts, 0, (m_mask + 1) * sizeof counts[0] );
+
+				srTile* dst = m_src + firstTile;
+				for( const srTileBlock* block = m_firstBlock; block != m_endBlock; block = block->next )
+				{
+					for( UINT iTile = 0; iTile < block->numTiles; iTile++ )
+					{
+						const srTile& tile = block->tiles[ iTile ];
+						counts[ (renderer->GetScreenTileIndex( tile ) >> m_shift) & m_mask ]++;
+						*dst++ = tile;
+					}
+				}
+				Assert( dst == m_src + lastTile );
 			}
-			else
+			break;
+
+		case Phase_Count :
 			{
-				RasterizePartiallyCoveredTile( tile, drawContext, m_renderer );
+				MemSet( counts, 0, (m_mask + 1) * sizeof counts[0] );
+
+				for( UINT iTile = firstTile; iTile < lastTile; iTile++ )
+				{
+					counts[ (renderer->GetScreenTileIndex( m_src[ iTile ] ) >> m_shift) & m_mask ]++;
+				}
 			}
+			break;
 
-#if 0
-			const UINT threadNum = context.threadNumber;
-			const UINT colorIndex = smallest( threadNum, NUMBER_OF(THREAD_COLORS)-1 );
-			const ARGB32 color = THREAD_COLORS[ colorIndex ];
-			DbgDrawRect( drawContext, color, tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
-#endif
+		case Phase_Scatter :
+			{
+				// tiles of this slice go after the tiles of the preceding slices with the same digit,
+				// so the sort is stable
+				for( UINT iTile = firstTile; iTile < lastTile; iTile++ )
+				{
+					const srTile& tile = m_src[ iTile ];
+					m_dst[ counts[ (renderer->GetScreenTileIndex( tile ) >> m_shift) & m_mask ]++ ] = tile;
+				}
+			}
+			break;
+
+		case Phase_FindBinOffsets :
+			{
+				// each bin starts where the screen tile index changes,
+				// so each offset is written by exactly one job
+				UINT* binOffsets = renderer->m_binOffsets;
+
+				UINT iPrevBin = firstTile ? renderer->GetScreenTileIndex( m_src[ firstTile-1 ] ) + 1 : 0;
+				for( UINT iTile = firstTile; iTile < lastTile; iTile++ )
+				{
+					const UINT iBin = renderer->GetScreenTileIndex( m_src[ iTile ] );
+					while( iPrevBin <= iBin )
+					{
+						binOffsets[ iPrevBin++ ] = iTile;
+					}
+				}
+			}
+			break;
 		}
 	}
 };
 
-void srTileRenderer::ProcessTriangles( const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numTriangles, const SoftRenderContext& context )
+// runs one phase of the radix sort on worker threads,
+// or on this thread if threading is disabled
+static void RunSortJobs( SortTilesJob* jobs, UINT numJobs )
 {
-	mxPROFILE_SCOPE("srTileRenderer :: Process Triangles");
+	if( !bDbg_EnableThreading )
+	{
+		for( UINT iJob = 0; iJob < numJobs; iJob++ )
+		{
+			jobs[ iJob ].Execute();
+		}
+		return;
+	}
 
-	Assert(numTriangles <= FACE_BUFFER_SIZE);
+	ThreadPool& threads = GetThreadPool();
 
+	for( UINT iJob = 0; iJob < numJobs; iJob++ )
+	{
+		threads.EnqueueJob( &jobs[ iJob ] );
+	}
+	threads.RunAllJobs();
+}
 
-	F_RenderSingleTriangle* drawTriangleFunction = m_ftblDrawTriangle[m_fillMode];
+// sorts binned tiles by screen tile index (parallel LSD radix sort)
+// and finds the start of each bin in m_sortedTiles;
+// the sort is stable, so triangles in each bin stay in submission order.
+void srTileRenderer::SortTilesByScreenPosition( const srTileBlockList& tiles )
+{
+	mxPROFILE_SCOPE("srTileRenderer :: Sort Tiles");
+
+	const UINT numTiles = tiles.numTiles;
 
-	(*m_ftblProcessTriangles[m_fillMode][m_cullMode])( drawTriangleFunction, vertices, numVertices, indices, numTriangles*3, context );
+	const UINT numBins = m_numTilesX * m_numTilesY;
 
+	// the number of passes depends on the number of bits in screen tile indices
+	UINT numKeyBits = 1;
+	while( (1U << numKeyBits) < numBins ) {
+		numKeyBits++;
+	}
+	const UINT numPasses = (numKeyBits + MAX_RADIX_BITS - 1) / MAX_RADIX_BITS;
+	const UINT radixBits = (numKeyBits + numPasses - 1) / numPasses;
+	const UINT radixSize = 1 << radixBits;
 
-	const UINT oldMaxTiles = m_maxTiles;
-	const UINT totalNumTiles = smallest(m_numTiles,oldMaxTiles);
+	SortTilesJob	jobs[MAX_SORT_JOBS];
 
-	if( totalNumTiles )
+	// split the blocks into slices with roughly the same number of tiles,
+	// each job processes the same slice in every pass
+	const UINT tilesPerJob = largest( (UINT)TILES_PER_SORT_JOB, (numTiles + MAX_SORT_JOBS - 1) / MAX_SORT_JOBS );
+
+	UINT numJobs = 0;
+	UINT numSlicedTiles = 0;
+
+	const srTileBlock* block = tiles.head;
+	while( block )
 	{
-		mxPROFILE_SCOPE("srTileRenderer :: Rasterize Tiles");
+		Assert( numJobs < MAX_SORT_JOBS );
+		SortTilesJob& job = jobs[ numJobs ];
+
+		job.m_renderer = this;
+		job.m_iJob = numJobs;
+		job.m_firstBlock = block;
+		job.m_firstTile = numSlicedTiles;
+		job.m_numTiles = 0;
 
+		while( block && job.m_numTiles < tilesPerJob )
+		{
+			job.m_numTiles += block->numTiles;
+			block = block->next;
+		}
+		job.m_endBlock = block;
 
+		numSlicedTiles += job.m_numTiles;
+		numJobs++;
+	}
+	Assert( numSlicedTiles == numTiles );
 
-		if( bDbg_EnableThreading )
+	srTile* src = m_tiles;
+	srTile* dst = m_sortedTiles;
+
+	for( UINT iPass = 0; iPass < numPasses; iPass++ )
+	{
+		// count radix digits in each slice
+		for( UINT iJob = 0; iJob < numJobs; iJob++ )
+		{
+			SortTilesJob& job = jobs[ iJob ];
+			job.m_phase = iPass ? SortTilesJob::Phase_Count : SortTilesJob::Phase_Gather;
+			job.m_src = src;
+			job.m_dst = dst;
+			job.m_shift = iPass * radixBits;
+			job.m_mask = radixSize - 1;
+		}
+		RunSortJobs( jobs, numJobs );
+
+		// exclusive prefix sum over digits, then over slices => start of each slice's part of each digit
+		UINT sum = 0;
+		for( UINT iDigit = 0; iDigit < radixSize; iDigit++ )
+		{
+			for( UINT iJob = 0; iJob < numJobs; iJob++ )
+			{
+				const UINT count = m_radixCounts[ iJob ][ iDigit ];
+				m_radixCounts[ iJob ][ iDigit ] = sum;
+				sum += count;
+			}
+		}
+		Assert( sum == numTiles );
+
+		// move tiles into place
+		for( UINT iJob = 0; iJob < numJobs; iJob++ )
 		{
-			ThreadPool& threads = GetThreadPool();
+			jobs[ iJob ].m_phase = SortTilesJob::Phase_Scatter;
+		}
+		RunSortJobs( jobs, numJobs );
 
-			//const UINT numThreads = threads.NumThreads();
+		TSwap( src, dst );
+	}
+
+	// the sorted tiles are in 'src', the other buffer is free
+	m_sortedTiles = src;
+	m_tiles = dst;
 
+	// find bin boundaries
+	for( UINT iJob = 0; iJob < numJobs; iJob++ )
+	{
+		SortTilesJob& job = jobs[ iJob ];
+		job.m_phase = SortTilesJob::Phase_FindBinOffsets;
+		job.m_src = m_sortedTiles;
+	}
+	RunSortJobs( jobs, numJobs );
 
-			enum { MAX_RASTERIZER_JOBS = 256 };
+	// bins after the last binned tile are empty
+	for( UINT iBin = GetScreenTileIndex( m_sortedTiles[ numTiles-1 ] ) + 1; iBin <= numBins; iBin++ )
+	{
+		m_binOffsets[ iBin ] = numTiles;
+	}
+}
 
-			RasterizeTilesJob	rasterizeTilesJobs[MAX_RASTERIZER_JOBS];
+// runs the geometry front end on a chunk of triangles
+struct ProcessTrianglesJob : AsyncJob
+{
+	srFrontEndChunk*	m_chunk;
 
-			//enum { TILES_PER_JOB = 512 };
-			enum { TILES_PER_JOB = 128 };
-			//enum { TILES_PER_JOB = 64 };
+public:
+	ProcessTrianglesJob()
+	{
+		m_chunk = nil;
+	}
+	virtual void Run( const AsyncJob::Context& context ) override
+	{
+		m_chunk->renderer->ProcessTriangleChunk( *m_chunk );
+	}
+};
 
-			UINT numJobs = totalNumTiles/TILES_PER_JOB;
-			Assert(numJobs < MAX_RASTERIZER_JOBS);
-			numJobs = smallest(numJobs,MAX_RASTERIZER_JOBS);
+void srTileRenderer::ProcessTriangleChunk( srFrontEndChunk & chunk )
+{
+	mxPROFILE_SCOPE("srTileRenderer :: Process Triangles");
 
-			for( UINT iJob = 0; iJob < numJobs; iJob++ )
-			{
-				RasterizeTilesJob& job = rasterizeTilesJobs[ iJob ];
+	F_RenderSingleTriangle* drawTriangleFunction = m_ftblDrawTriangle[m_fillMode];
 
-				job.m_context = &context;
-				job.m_renderer = this;
-				job.m_tiles = m_tiles;
-				job.m_firstTile = iJob*TILES_PER_JOB;
-				job.m_numTiles = TILES_PER_JOB;
+	(*m_ftblProcessTriangles[m_fillMode][m_cullMode])( drawTriangleFunction, chunk.vertices, chunk.numVertices, chunk.indices, chunk.numTriangles*3, chunk.context );
 
-				threads.EnqueueJob( &job );
-			}
+	// set up and bin the last (incomplete) batch of triangles
+	SetupAndBinTriangles< TILE_SIZE_X, TILE_SIZE_Y >( &chunk );
+}
 
-			RasterizeTilesJob	lastJob;
+// transforms, clips and sets up triangles and bins them into screen tiles;
+// triangles are split into chunks which are processed by worker threads,
+// then the tiles of all chunks are appended to the current slice of the face buffer in chunk order (i.e. in submission order);
+// if a full slice is waiting for rasterization, its tiles are rasterized by the same worker threads while the chunks are binned
+void srTileRenderer::BinTriangles( const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numTriangles, const SoftRenderContext& context )
+{
+	mxPROFILE_SCOPE("srTileRenderer :: Bin Triangles");
 
-			const UINT tilesLeft = totalNumTiles - numJobs*TILES_PER_JOB;
-			if( tilesLeft )
-			{
-				lastJob.m_context = &context;
-				lastJob.m_renderer = this;
-				lastJob.m_tiles = m_tiles;
-				lastJob.m_firstTile = numJobs*TILES_PER_JOB;
-				lastJob.m_numTiles = tilesLeft;
+	srFaceBuffer & faces = m_faceBuffers[ m_iCurrentFaceBuffer ];
 
-				threads.EnqueueJob( &lastJob );
-			}
+	const UINT numFreeFaces = FACE_BUFFER_SIZE - faces.numFaces;
+	Assert( numTriangles > 0 );
+	Assert( numTriangles * FACES_PER_INPUT_TRIANGLE <= numFreeFaces );
 
-			threads.RunAllJobs();
+	// wireframe triangles are drawn immediately, so they are processed on this thread
+	const bool bUseThreads = bDbg_EnableThreading && (m_fillMode == Fill_Solid);
 
-			DBGOUT( "srTileRenderer::ProcessTriangles: %u faces, %u tiles (%u jobs)\n",
-				m_nTransformedTris, m_numTiles, numJobs );
+	// ...after all triangles submitted before them
+	if( !bUseThreads )
+	{
+		while( m_numPendingFaceBuffers )
+		{
+			this->RasterizePendingFaceBuffer();
 		}
-		else
+	}
+
+	const UINT numChunks = bUseThreads
+		? smallest( (numTriangles + TRIANGLES_PER_FRONT_END_JOB - 1) / TRIANGLES_PER_FRONT_END_JOB, (UINT)MAX_FRONT_END_JOBS )
+		: 1;
+
+	// each chunk gets a slice of the free part of the face buffer which can hold all faces its triangles can be clipped into
+	for( UINT iChunk = 0; iChunk < numChunks; iChunk++ )
+	{
+		srFrontEndChunk & chunk = m_frontEndChunks[ iChunk ];
+
+		const UINT iFirstTriangle = iChunk * numTriangles / numChunks;
+		const UINT iLastTriangle = (iChunk + 1) * numTriangles / numChunks;
+
+		chunk.context = context;
+		chunk.context.userPointer = &chunk;
+		chunk.context.stats = &chunk.stats;
+
+		chunk.vertices = vertices;
+		chunk.numVertices = numVertices;
+		chunk.indices = indices + iFirstTriangle * 3;
+		chunk.numTriangles = iLastTriangle - iFirstTriangle;
+
+		chunk.firstFace = faces.firstFace + faces.numFaces + iFirstTriangle * FACES_PER_INPUT_TRIANGLE;
+		chunk.numFaces = 0;
+		chunk.numSetupFaces = 0;
+		chunk.maxFaces = chunk.numTriangles * FACES_PER_INPUT_TRIANGLE;
+
+		Assert( chunk.tiles.IsEmpty() );
+
+		chunk.stats.Reset();
+	}
+
+	if( numChunks > 1 || m_numPendingFaceBuffers )
+	{
+		ThreadPool& threads = GetThreadPool();
+
+		// the oldest full slice is rasterized while this batch is being binned;
+		// the slices and the tile blocks of the front end and the rasterizer don't overlap,
+		// the tile blocks are returned to their pools after all jobs have finished
+		RasterizeScreenTilesJob	rasterizeTilesJobs[MAX_RASTERIZER_JOBS];
+
+		srFaceBuffer* rasterizedFaces = nil;
+		if( m_numPendingFaceBuffers )
 		{
-			UINT numFullyCovered = 0;
+			rasterizedFaces = &this->GetPendingFaceBuffer();
+			this->EnqueueRasterizeJobs( *rasterizedFaces, rasterizeTilesJobs );
+		}
 
-			for( UINT iTile = 0; iTile < totalNumTiles; iTile++ )
-			{
-				const srTile& tile = m_tiles[ iTile ];
+		ProcessTrianglesJob	jobs[MAX_FRONT_END_JOBS];
 
-				numFullyCovered += tile.bFullyCovered;	// increment or do nothing
-			}
+		for( UINT iChunk = 0; iChunk < numChunks; iChunk++ )
+		{
+			jobs[ iChunk ].m_chunk = &m_frontEndChunks[ iChunk ];
+			threads.EnqueueJob( &jobs[ iChunk ] );
+		}
 
-			const UINT numPartiallyCovered = totalNumTiles - numFullyCovered;
+		threads.RunAllJobs();
+
+		if( rasterizedFaces )
+		{
+			this->FinishRasterization( *rasterizedFaces );
+			m_numPendingFaceBuffers--;
+		}
+	}
+	else
+	{
+		this->ProcessTriangleChunk( m_frontEndChunks[0] );
+	}
 
-			DBGOUT( "srTileRenderer::ProcessTriangles: %u faces, %u tiles (%u fully covered, %u partially covered)\n",
-				m_nTransformedTris, m_numTiles, numFullyCovered, numPartiallyCovered );
+	// merge the results of all chunks
+	for( UINT iChunk = 0; iChunk < numChunks; iChunk++ )
+	{
+		srFrontEndChunk & chunk = m_frontEndChunks[ iChunk ];
 
-			struct cmp_tiles_predicate
-			{
-				mxSTATIC_ASSERT( sizeof srTile == sizeof UINT32 );
+		// tile blocks are linked, not copied
+		faces.tiles.Append( chunk.tiles );
 
-				FORCEINLINE UINT32 operator() ( const srTile& o ) const
-				{
-					//return *(UINT32*)&o;
-					return o.sort;
-				}
-			};
+		SoftRenderer::stats.numVertexCacheHits += chunk.stats.numVertexCacheHits;
+		SoftRenderer::stats.numVertexCacheMisses += chunk.stats.numVertexCacheMisses;
+		SoftRenderer::stats.numOccludedTiles += chunk.stats.numOccludedTiles;
+		SoftRenderer::stats.numSmallTriangles += chunk.stats.numSmallTriangles;
+	}
 
-			cmp_tiles_predicate	predicate;
-			radix_sort_3pass( m_tiles, m_sortedTiles, totalNumTiles, predicate );
-			//radix_sort_4pass( m_tiles, m_sortedTiles, totalNumTiles, predicate );
+	// slots left unused in the slices of the preceding chunks are skipped
+	const srFrontEndChunk & lastChunk = m_frontEndChunks[ numChunks-1 ];
+	faces.numFaces = lastChunk.firstFace + lastChunk.numFaces - faces.firstFace;
+}
 
-			for( UINT iTile = 0; iTile < numPartiallyCovered; iTile++ )
-			{
-				const srTile& tile = m_sortedTiles[ iTile ];
+// returns the oldest full slice of the face buffer
+srFaceBuffer& srTileRenderer::GetPendingFaceBuffer()
+{
+	Assert( m_numPendingFaceBuffers > 0 );
+	const UINT iPendingFaceBuffer = (m_iCurrentFaceBuffer + NUM_FACE_BUFFERS - m_numPendingFaceBuffers) % NUM_FACE_BUFFERS;
+	return m_faceBuffers[ iPendingFaceBuffer ];
+}
 
-				Assert( !tile.bFullyCovered );
-				RasterizePartiallyCoveredTile( tile, context, this );
-			}
-			for( UINT iTile = numPartiallyCovered; iTile < totalNumTiles; iTile++ )
+// queues the current (full) slice of the face buffer for rasterization
+// and continues binning into the next slice
+void srTileRenderer::SubmitFaceBuffer()
+{
+	// wait until the oldest slice has been rasterized
+	if( m_numPendingFaceBuffers == NUM_FACE_BUFFERS - 1 )
+	{
+		this->RasterizePendingFaceBuffer();
+	}
+
+	m_iCurrentFaceBuffer = (m_iCurrentFaceBuffer + 1) % NUM_FACE_BUFFERS;
+	m_numPendingFaceBuffers++;
+
+	Assert( m_faceBuffers[ m_iCurrentFaceBuffer ].numFaces == 0 );
+	Assert( m_faceBuffers[ m_iCurrentFaceBuffer ].tiles.IsEmpty() );
+
+	// without worker threads there is nothing to overlap with
+	if( !bDbg_EnableThreading )
+	{
+		this->RasterizePendingFaceBuffer();
+	}
+}
+
+// rasterizes the oldest full slice of the face buffer
+void srTileRenderer::RasterizePendingFaceBuffer()
+{
+	srFaceBuffer & faces = this->GetPendingFaceBuffer();
+	this->RasterizeTiles( faces );
+	m_numPendingFaceBuffers--;
+}
+
+// sorts the tiles of the given slice by screen position and enqueues jobs rasterizing them
+// (the jobs are run by the next call to ThreadPool::RunAllJobs()); returns the number of jobs
+UINT srTileRenderer::EnqueueRasterizeJobs( const srFaceBuffer& faces, RasterizeScreenTilesJob* jobs )
+{
+	const UINT totalNumTiles = faces.tiles.numTiles;
+	if( !totalNumTiles ) {
+		return 0;
+	}
+
+	ThreadPool& threads = GetThreadPool();
+
+	this->ReserveSortBuffers( totalNumTiles );
+	this->SortTilesByScreenPosition( faces.tiles );
+
+	//enum { TILES_PER_JOB = 512 };
+	enum { TILES_PER_JOB = 128 };
+	//enum { TILES_PER_JOB = 64 };
+
+	// split the screen into runs of bins with roughly the same number of tiles;
+	// a bin is never split between jobs
+	const UINT tilesPerJob = largest( (UINT)TILES_PER_JOB, (totalNumTiles + MAX_RASTERIZER_JOBS - 1) / MAX_RASTERIZER_JOBS );
+
+	const UINT numBins = m_numTilesX * m_numTilesY;
+
+	UINT numJobs = 0;
+	UINT iFirstBin = 0;
+	UINT numTilesInJob = 0;
+
+	for( UINT iBin = 0; iBin < numBins; iBin++ )
+	{
+		numTilesInJob += m_binOffsets[ iBin+1 ] - m_binOffsets[ iBin ];
+
+		if( numTilesInJob >= tilesPerJob || iBin == numBins-1 )
+		{
+			if( numTilesInJob )
 			{
-				const srTile& tile = m_sortedTiles[ iTile ];
+				Assert( numJobs < MAX_RASTERIZER_JOBS );
+				RasterizeScreenTilesJob& job = jobs[ numJobs++ ];
 
-				Assert( tile.bFullyCovered );
-				RasterizeFullyCoveredTile( tile, context, this );
-			}
-		}//serial
+				job.m_renderer = this;
+				job.m_firstBin = iFirstBin;
+				job.m_numBins = iBin + 1 - iFirstBin;
 
+				threads.EnqueueJob( &job );
+			}
+			iFirstBin = iBin + 1;
+			numTilesInJob = 0;
+		}
+	}
 
+	DBGOUT( "srTileRenderer::RasterizeTiles: %u faces, %u tiles (%u jobs)\n",
+		faces.numFaces, totalNumTiles, numJobs );
 
+	return numJobs;
+}
 
+// called after all tiles of the given slice have been rasterized;
+// recycles the tile blocks and empties the slice
+void srTileRenderer::FinishRasterization( srFaceBuffer & faces )
+{
+	const UINT totalNumTiles = faces.tiles.numTiles;
 
+	if( totalNumTiles )
+	{
 		if( SOFT_RENDER_DEBUG && SoftRenderer::bDbg_DrawBlockBounds )
 		{
 			//for( UINT iFace = 0; iFace < numTriangles; iFace++ )
@@ -936,44 +2062,76 @@ void srTileRenderer::ProcessTriangles( const SVertex* vertices, UINT numVertices
 			//	Dbg_BlockRasterizer_DrawBoundingRect( context, face.minX, face.minY, face.maxX-face.minX, face.maxY-face.minY );
 			//}
 
-			for( UINT iTile = 0; iTile < totalNumTiles; iTile++ )
+			for( const srTileBlock* block = faces.tiles.head; block; block = block->next )
 			{
-				const srTile& tile = m_tiles[ iTile ];
-
-				if( tile.bFullyCovered )
-				{
-					Dbg_BlockRasterizer_DrawFullyCoveredRect( context, tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
-				}
-				else
+				for( UINT iTile = 0; iTile < block->numTiles; iTile++ )
 				{
-					Dbg_BlockRasterizer_DrawPartiallyCoveredRect( context, tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
+					const srTile& tile = block->tiles[ iTile ];
+
+					if( tile.bFullyCovered )
+					{
+						Dbg_BlockRasterizer_DrawFullyCoveredRect( GetDrawContext( tile ), tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
+					}
+					else
+					{
+						Dbg_BlockRasterizer_DrawPartiallyCoveredRect( GetDrawContext( tile ), tile.GetX(), tile.GetY(), TILE_SIZE_X, TILE_SIZE_Y );
+					}
 				}
 			}
 		}
 
+		m_peakBinnedTiles = largest( m_peakBinnedTiles, totalNumTiles );
 
-		// resize buffers if needed
+		SoftRenderer::stats.numBinnedTiles += totalNumTiles;
+		SoftRenderer::stats.maxBinnedTiles = largest( SoftRenderer::stats.maxBinnedTiles, totalNumTiles );
 
-		if( m_numTiles > oldMaxTiles )
-		{
-			m_maxTiles = NextPowerOfTwo( totalNumTiles );
+		// the blocks will be reused by the next batch
+		this->RecycleTileBlocks( faces.tiles );
+	}//if( totalNumTiles )
+
+	UINT numTileBlocks = 0;
+	for( UINT iChunk = 0; iChunk < MAX_FRONT_END_JOBS; iChunk++ )
+	{
+		numTileBlocks += m_frontEndChunks[ iChunk ].numBlocks;
+	}
+	SoftRenderer::stats.numTileBlocks = numTileBlocks;
 
-			mxFree( m_tiles );
-			mxFree( m_sortedTiles );
+	faces.numFaces = 0;
+}
 
-			m_tiles = (srTile*) mxAlloc( m_maxTiles * sizeof m_tiles[0] );
-			m_sortedTiles = (srTile*) mxAlloc( m_maxTiles * sizeof m_sortedTiles[0] );
+// rasterizes all triangles binned into the given slice and empties it
+void srTileRenderer::RasterizeTiles( srFaceBuffer & faces )
+{
+	const UINT totalNumTiles = faces.tiles.numTiles;
 
-			//MemCopy( m_sortedTiles, m_tiles, totalNumTiles * sizeof m_tiles[0] );
+	if( totalNumTiles )
+	{
+		mxPROFILE_SCOPE("srTileRenderer :: Rasterize Tiles");
 
-			DBGOUT("!!! Resizing tile buffer from %u to %u (%u KiB)\n",
-				oldMaxTiles,m_maxTiles,m_maxTiles*sizeof m_tiles[0] /mxKIBIBYTE);
-		}
+		if( bDbg_EnableThreading )
+		{
+			RasterizeScreenTilesJob	rasterizeTilesJobs[MAX_RASTERIZER_JOBS];
 
-		m_numTiles = 0;
+			this->EnqueueRasterizeJobs( faces, rasterizeTilesJobs );
+
+			GetThreadPool().RunAllJobs();
+		}
+		else
+		{
+			// the same code as with threads, so that the image is the same:
+			// bins are rasterized in screen order, triangles in each bin in submission order
+			this->ReserveSortBuffers( totalNumTiles );
+			this->SortTilesByScreenPosition( faces.tiles );
+
+			RasterizeScreenTilesJob	job;
+			job.m_renderer = this;
+			job.m_firstBin = 0;
+			job.m_numBins = m_numTilesX * m_numTilesY;
+			job.Execute( 0 );
+		}//serial
 	}//if( totalNumTiles )
 
-	m_nTransformedTris = 0;
+	this->FinishRasterization( faces );
 }
 
 }//namespace SoftRenderer
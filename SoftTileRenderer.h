@@ -2,6 +2,7 @@
 
 #include <SoftRender/SoftRender.h>
 #include <SoftRender/SoftRender_Internal.h>
+#include <SoftRender/SoftFrameBuffer.h>
 
 namespace SoftRenderer
 {
@@ -17,21 +18,32 @@ enum { TILE_SIZE_Y = 8 };	//<= must be a power of two
 
 //enum { MAX_TILES = 1<<15 };
 
-// 28.4 fixed-point coordinates
-// (4 bits of sub-pixel precision, enough for a 2048x2048 color buffer)
-enum { FP_SHIFT = 4 };
+// triangles are binned hierarchically: first against SUPER_TILE_SIZE x SUPER_TILE_SIZE screen blocks,
+// then against tiles of partially covered blocks (tiles of fully covered blocks are accepted without tests)
+enum { SUPER_TILE_SIZE = 64 };	//<= must be a power of two
+mxSTATIC_ASSERT( SUPER_TILE_SIZE % TILE_SIZE_X == 0 );
+mxSTATIC_ASSERT( SUPER_TILE_SIZE % TILE_SIZE_Y == 0 );
+
+// screen coordinates are converted to fixed-point with SoftRenderContext::subPixelBits of sub-pixel precision
+// (28.4 fixed-point on viewports up to 2048x2048)
 
 #if 1
-	union srTile
-	{
-		UINT32		sort;
-		// NOTE: field order is important! (for radix sort)
-		struct {
-			// Visual C++, Win7-64, x86-64
-			BITFIELD	iFace : 12;	// triangle index
-			BITFIELD	iX : 9;		// realX = iX * TILE_SIZE_X
-			BITFIELD	iY : 10;	// realY = iY * TILE_SIZE_Y
-			BITFIELD	bFullyCovered : 1;	// 1 - fully covered, 0 - partially covered
+	// 64-bit tile record: the triangle index takes the low half,
+	// the sort key (screen position and coverage) takes the high half,
+	// so that tiles can be radix-sorted on 32-bit keys;
+	// the sort is stable, so triangles in each screen tile stay in submission order
+	struct srTile
+	{
+		UINT32		iFace;	// triangle index
+		union {
+			UINT32		sort;
+			// NOTE: field order is important! (for radix sort)
+			struct {
+				// Visual C++, Win7-64, x86-64
+				BITFIELD	iX : 15;	// realX = iX * TILE_SIZE_X
+				BITFIELD	iY : 16;	// realY = iY * TILE_SIZE_Y
+				BITFIELD	bFullyCovered : 1;	// 1 - fully covered, 0 - partially covered
+			};
 		};
 
 	public:
@@ -54,9 +66,9 @@ enum { FP_SHIFT = 4 };
 			return iY * TILE_SIZE_Y;
 		}
 	};
-	mxSTATIC_ASSERT( sizeof srTile == sizeof UINT32 );
-	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_WIDTH <= 2048 );
-	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_HEIGHT <= 1024 );
+	mxSTATIC_ASSERT( sizeof srTile == sizeof UINT64 );
+	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_WIDTH / TILE_SIZE_X <= (1<<15) );
+	mxSTATIC_ASSERT( SOFT_RENDER_MAX_WINDOW_HEIGHT / TILE_SIZE_Y <= (1<<16) );
 #else
 	struct srTile
 	{
@@ -89,6 +101,922 @@ enum { FP_SHIFT = 4 };
 #endif
 
 
+// rasterizes the part of the triangle inside the given screen tile
+typedef void F_RasterizeTile( const XTriangle& face, UINT iBlockX, UINT iBlockY, const SoftRenderContext& context );
+
+// tile rasterization kernels for one depth format
+struct srTileKernels
+{
+	F_RasterizeTile *	rasterizeFullyCoveredTile;
+	F_RasterizeTile *	rasterizePartiallyCoveredTile;
+	F_RasterizeTile *	rasterizeSmallTriangle;
+	F_RasterizeTile *	shadeFullyCoveredTile;	// shades all pixels without depth testing (see RasterizeDepthPlaneTile())
+};
+
+// small triangles have their bounding rectangle inside a single screen tile (most triangles of dense meshes);
+// they are binned into this tile without testing it against the edges
+// and rasterized only inside their bounding rectangle
+FORCEINLINE
+bool IsSmallTriangle( const XTriangle& face )
+{
+	return (face.maxX - face.minX <= TILE_SIZE_X) && (face.maxY - face.minY <= TILE_SIZE_Y);
+}
+
+// triangles are set up in batches of SETUP_BATCH_SIZE triangles (one triangle per SIMD lane)
+enum { SETUP_BATCH_SIZE = 8 };
+
+// computes edge functions, gradients and bounding rectangles of consecutive triangles in the face buffer
+// (numTriangles <= SETUP_BATCH_SIZE)
+typedef void F_SetupTriangles( XTriangle* faces, UINT numTriangles, const SoftRenderContext& context );
+
+// computes perspective-correct varyings at the given pixel and runs the pixel shader
+FORCEINLINE
+void ShadeTilePixel( const XTriangle& face, UINT iX, UINT iY, F4 fZ, SoftPixel* pixel, const SoftRenderContext& context )
+{
+	const F4 fX = (F4)iX - face.v1.P.x;
+	const F4 fY = (F4)iY - face.v1.P.y;
+
+	// compute inverse W
+	const F4 fInvW = face.v1.P.w + face.vInvW.x * fX + face.vInvW.y * fY;
+	const F4 fW = 1.0f / fInvW;
+
+	SPixelShaderParameters	pixelShaderArgs;
+	for( UINT i = 0; i < NUM_VARYINGS; i++ )
+	{
+		const F4 varOverW = face.vars1OverW1[i] + face.varsOverW[i].x * fX + face.varsOverW[i].y * fY;
+		pixelShaderArgs.vars[i] = varOverW * fW;	// <= perspective correction
+	}
+	pixelShaderArgs.depth = fZ;
+	pixelShaderArgs.globals = context.globals;
+	pixelShaderArgs.pixel = pixel;
+
+	// execute pixel shader
+	(*context.pixelShader)( pixelShaderArgs );
+}
+
+// plane equations of depth, inverse W and varyings (premultiplied by inverse W) of a triangle
+// evaluated at four horizontally adjacent pixels;
+// the tile kernels evaluate them once per tile and step them from quad to quad (and row to row) with vector additions
+struct srPlanes_SSE
+{
+	__m128	z;
+	__m128	invW;
+	__m128	varsOverW[ NUM_VARYINGS ];
+
+public:
+	// evaluates the planes at pixels [iX, iX+3] of row iY
+	FORCEINLINE void Evaluate( const XTriangle& face, UINT iX, UINT iY )
+	{
+		const F4 fX = (F4)iX - face.v1.P.x;
+		const F4 fY = (F4)iY - face.v1.P.y;
+
+		const __m128 qfX = _mm_add_ps( _mm_set1_ps( fX ), _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f ) );
+
+		z = _mm_add_ps( _mm_set1_ps( face.v1.P.z + face.vZ.y * fY ), _mm_mul_ps( _mm_set1_ps( face.vZ.x ), qfX ) );
+		invW = _mm_add_ps( _mm_set1_ps( face.v1.P.w + face.vInvW.y * fY ), _mm_mul_ps( _mm_set1_ps( face.vInvW.x ), qfX ) );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm_add_ps(
+				_mm_set1_ps( face.vars1OverW1[i] + face.varsOverW[i].y * fY ),
+				_mm_mul_ps( _mm_set1_ps( face.varsOverW[i].x ), qfX )
+			);
+		}
+	}
+	// sets the increments of the planes for a step of (dX, dY) pixels
+	FORCEINLINE void SetStep( const XTriangle& face, F4 dX, F4 dY )
+	{
+		z = _mm_set1_ps( face.vZ.x * dX + face.vZ.y * dY );
+		invW = _mm_set1_ps( face.vInvW.x * dX + face.vInvW.y * dY );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm_set1_ps( face.varsOverW[i].x * dX + face.varsOverW[i].y * dY );
+		}
+	}
+	FORCEINLINE void Add( const srPlanes_SSE& step )
+	{
+		z = _mm_add_ps( z, step.z );
+		invW = _mm_add_ps( invW, step.invW );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm_add_ps( varsOverW[i], step.varsOverW[i] );
+		}
+	}
+	// computes perspective-correct varyings
+	FORCEINLINE void GetVaryings( __m128 vars[ NUM_VARYINGS ] ) const
+	{
+		const __m128 qfW = _mm_div_ps( _mm_set_ps1( 1.0f ), invW );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			vars[i] = _mm_mul_ps( varsOverW[i], qfW );	// <= perspective correction
+		}
+	}
+};
+
+// shades four horizontally adjacent pixels selected by the 4-bit mask:
+// with a single call to the SIMD pixel shader if it's set,
+// otherwise by calling the scalar pixel shader for each selected pixel;
+// planes.z holds the new depth values of the selected pixels
+FORCEINLINE
+void ShadeTileQuad_SSE( const srPlanes_SSE& planes, UINT mask, SoftPixel* pixels, const SoftRenderContext& context )
+{
+	if( !mask ) {
+		return;
+	}
+
+	if( context.pixelShader4 )
+	{
+		SPixel4	inputs;
+		planes.GetVaryings( inputs.vars );
+		inputs.depth = planes.z;
+
+		// expand the mask bits into lanes
+		const __m128i qiBits = _mm_set_epi32( 8, 4, 2, 1 );
+		inputs.mask = _mm_cmpeq_epi32( _mm_and_si128( _mm_set1_epi32( mask ), qiBits ), qiBits );
+
+		// execute pixel shader
+		const __m128i qiNewColor = (*context.pixelShader4)( *context.globals, inputs );
+
+		//#######[LOAD] load previous color
+		__m128i* dest = (__m128i*) pixels;
+		const __m128i qiOldColor = _mm_loadu_si128( dest );
+
+		//$$$@@@[STORE] write color to framebuffer
+		_mm_storeu_si128( dest, _mm_or_si128(
+			_mm_and_si128( inputs.mask, qiNewColor ),
+			_mm_andnot_si128( inputs.mask, qiOldColor )
+		) );
+		return;
+	}
+
+	// calculate perspectively-correct varyings
+	__m128	qfVars[ NUM_VARYINGS ];
+	planes.GetVaryings( qfVars );
+
+	mxSIMDALIGNED F4	vars[ NUM_VARYINGS ][ SSE_REG_WIDTH ];
+	for( UINT i = 0; i < NUM_VARYINGS; i++ )
+	{
+		_mm_store_ps( vars[i], qfVars[i] );
+	}
+
+	mxSIMDALIGNED F4	depth[ SSE_REG_WIDTH ];
+	_mm_store_ps( depth, planes.z );
+
+	SPixelShaderParameters	pixelShaderArgs;
+	pixelShaderArgs.globals = context.globals;
+
+	for( UINT iPixel = 0; iPixel < SSE_REG_WIDTH; iPixel++ )
+	{
+		if( mask & (1 << iPixel) )
+		{
+			for( UINT i = 0; i < NUM_VARYINGS; i++ )
+			{
+				pixelShaderArgs.vars[i] = vars[i][iPixel];
+			}
+			pixelShaderArgs.depth = depth[iPixel];
+			pixelShaderArgs.pixel = pixels + iPixel;
+
+			// execute pixel shader
+			(*context.pixelShader)( pixelShaderArgs );
+		}
+	}
+}
+
+#if SOFT_RENDER_USE_AVX
+
+// plane equations of depth, inverse W and varyings evaluated at eight horizontally adjacent pixels (see srPlanes_SSE)
+struct srPlanes_AVX
+{
+	__m256	z;
+	__m256	invW;
+	__m256	varsOverW[ NUM_VARYINGS ];
+
+public:
+	// evaluates the planes at pixels [iX, iX+7] of row iY
+	FORCEINLINE void Evaluate( const XTriangle& face, UINT iX, UINT iY )
+	{
+		const F4 fX = (F4)iX - face.v1.P.x;
+		const F4 fY = (F4)iY - face.v1.P.y;
+
+		const __m256 qfX = _mm256_add_ps( _mm256_set1_ps( fX ), _mm256_set_ps( 7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f ) );
+
+		z = _mm256_add_ps( _mm256_set1_ps( face.v1.P.z + face.vZ.y * fY ), _mm256_mul_ps( _mm256_set1_ps( face.vZ.x ), qfX ) );
+		invW = _mm256_add_ps( _mm256_set1_ps( face.v1.P.w + face.vInvW.y * fY ), _mm256_mul_ps( _mm256_set1_ps( face.vInvW.x ), qfX ) );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm256_add_ps(
+				_mm256_set1_ps( face.vars1OverW1[i] + face.varsOverW[i].y * fY ),
+				_mm256_mul_ps( _mm256_set1_ps( face.varsOverW[i].x ), qfX )
+			);
+		}
+	}
+	// sets the increments of the planes for a step of (dX, dY) pixels
+	FORCEINLINE void SetStep( const XTriangle& face, F4 dX, F4 dY )
+	{
+		z = _mm256_set1_ps( face.vZ.x * dX + face.vZ.y * dY );
+		invW = _mm256_set1_ps( face.vInvW.x * dX + face.vInvW.y * dY );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm256_set1_ps( face.varsOverW[i].x * dX + face.varsOverW[i].y * dY );
+		}
+	}
+	FORCEINLINE void Add( const srPlanes_AVX& step )
+	{
+		z = _mm256_add_ps( z, step.z );
+		invW = _mm256_add_ps( invW, step.invW );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			varsOverW[i] = _mm256_add_ps( varsOverW[i], step.varsOverW[i] );
+		}
+	}
+	// computes perspective-correct varyings
+	FORCEINLINE void GetVaryings( __m256 vars[ NUM_VARYINGS ] ) const
+	{
+		const __m256 qfW = _mm256_div_ps( _mm256_set1_ps( 1.0f ), invW );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			vars[i] = _mm256_mul_ps( varsOverW[i], qfW );	// <= perspective correction
+		}
+	}
+	// splits the planes into the lower and the upper four pixels
+	FORCEINLINE void Split( srPlanes_SSE &lo, srPlanes_SSE &hi ) const
+	{
+		lo.z = _mm256_castps256_ps128( z );
+		hi.z = _mm256_extractf128_ps( z, 1 );
+		lo.invW = _mm256_castps256_ps128( invW );
+		hi.invW = _mm256_extractf128_ps( invW, 1 );
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			lo.varsOverW[i] = _mm256_castps256_ps128( varsOverW[i] );
+			hi.varsOverW[i] = _mm256_extractf128_ps( varsOverW[i], 1 );
+		}
+	}
+};
+
+// shades eight horizontally adjacent pixels selected by the 8-bit mask
+// with a single call to the 8-wide SIMD pixel shader if it's set, otherwise four pixels at a time;
+// planes.z holds the new depth values of the selected pixels
+FORCEINLINE
+void ShadeTileRow_AVX2( const srPlanes_AVX& planes, UINT mask, SoftPixel* pixels, const SoftRenderContext& context )
+{
+	if( !mask ) {
+		return;
+	}
+
+	if( !context.pixelShader8 )
+	{
+		srPlanes_SSE	lo, hi;
+		planes.Split( lo, hi );
+
+		// avoid AVX-SSE transition penalties in the pixel shader
+		_mm256_zeroupper();
+
+		// four pixels at a time
+		ShadeTileQuad_SSE( lo, mask & 0xF, pixels, context );
+		ShadeTileQuad_SSE( hi, mask >> SSE_REG_WIDTH, pixels + SSE_REG_WIDTH, context );
+		return;
+	}
+
+	SPixel8	inputs;
+	planes.GetVaryings( inputs.vars );
+	inputs.depth = planes.z;
+
+	// expand the mask bits into lanes
+	const __m256i qiBits = _mm256_set_epi32( 128, 64, 32, 16, 8, 4, 2, 1 );
+	inputs.mask = _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( mask ), qiBits ), qiBits );
+
+	// execute pixel shader
+	const __m256i qiNewColor = (*context.pixelShader8)( *context.globals, inputs );
+
+	//#######[LOAD] load previous color
+	__m256i* dest = (__m256i*) pixels;
+	const __m256i qiOldColor = _mm256_loadu_si256( dest );
+
+	//$$$@@@[STORE] write color to framebuffer
+	_mm256_storeu_si256( dest, _mm256_blendv_epi8( qiOldColor, qiNewColor, inputs.mask ) );
+}
+
+#endif // SOFT_RENDER_USE_AVX
+
+// depth buffer access of the tile kernels, specialized for each EDepthFormat;
+// the kernels interpolate floating-point depth, Encode*() converts it into stored values,
+// Load*() and Store*() read and write stored values (kept in float registers, integers as raw bits)
+// and LessEqual*() is the depth test
+template< EDepthFormat FORMAT >
+struct srDepthFormat;
+
+template<>
+struct srDepthFormat< DepthFormat_F32 >
+{
+	typedef F4 Elem;
+
+	static FORCEINLINE Elem Encode( F4 z )
+	{
+		return z;
+	}
+	// converts the largest stored value of a tile (see ToFloat_SSE()) into hierarchical Z
+	static FORCEINLINE F4 DecodeMax( F4 maxValue )
+	{
+		return maxValue;
+	}
+
+	static FORCEINLINE __m128 Encode_SSE( __m128 z )
+	{
+		return z;
+	}
+	static FORCEINLINE __m128 Load_SSE( const Elem* depth )
+	{
+		return _mm_load_ps( depth );
+	}
+	static FORCEINLINE void Store_SSE( Elem* depth, __m128 values )
+	{
+		_mm_store_ps( depth, values );
+	}
+	static FORCEINLINE __m128 LessEqual_SSE( __m128 a, __m128 b )
+	{
+		return _mm_cmple_ps( a, b );
+	}
+	static FORCEINLINE __m128 ToFloat_SSE( __m128 values )
+	{
+		return values;
+	}
+
+#if SOFT_RENDER_USE_AVX
+	static FORCEINLINE __m256 Encode_AVX2( __m256 z )
+	{
+		return z;
+	}
+	static FORCEINLINE __m256 Load_AVX2( const Elem* depth )
+	{
+		return _mm256_loadu_ps( depth );
+	}
+	static FORCEINLINE void Store_AVX2( Elem* depth, __m256 values )
+	{
+		_mm256_storeu_ps( depth, values );
+	}
+	static FORCEINLINE __m256 LessEqual_AVX2( __m256 a, __m256 b )
+	{
+		return _mm256_cmp_ps( a, b, _CMP_LE_OQ );
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+#if SOFT_RENDER_USE_AVX512
+	static FORCEINLINE __m512 Encode_AVX512( __m512 z )
+	{
+		return z;
+	}
+	// loads only the selected values, the others are zero
+	static FORCEINLINE __m512 Load_AVX512( __mmask16 mask, const Elem* depth )
+	{
+		return _mm512_maskz_loadu_ps( mask, depth );
+	}
+	static FORCEINLINE void Store_AVX512( Elem* depth, __mmask16 mask, __m512 values )
+	{
+		_mm512_mask_storeu_ps( depth, mask, values );
+	}
+	static FORCEINLINE __mmask16 LessEqual_AVX512( __mmask16 mask, __m512 a, __m512 b )
+	{
+		return _mm512_mask_cmp_ps_mask( mask, a, b, _CMP_LE_OQ );
+	}
+#endif // SOFT_RENDER_USE_AVX512
+};
+
+// unsigned normalized depth: [0..1] is mapped onto [0..MAX_VALUE] (with rounding to nearest),
+// stored values are compared as integers
+template< UINT MAX_VALUE >
+struct srDepthUNorm
+{
+	static FORCEINLINE __m128 Encode_SSE( __m128 z )
+	{
+		const __m128 qfSaturated = _mm_min_ps( _mm_max_ps( z, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+		return _mm_castsi128_ps( _mm_cvtps_epi32( _mm_mul_ps( qfSaturated, _mm_set1_ps( (F4)MAX_VALUE ) ) ) );
+	}
+	static FORCEINLINE __m128 LessEqual_SSE( __m128 a, __m128 b )
+	{
+		return _mm_castsi128_ps( _mm_xor_si128( _mm_cmpgt_epi32( _mm_castps_si128( a ), _mm_castps_si128( b ) ), _mm_set1_epi32( -1 ) ) );
+	}
+	static FORCEINLINE __m128 ToFloat_SSE( __m128 values )
+	{
+		return _mm_cvtepi32_ps( _mm_castps_si128( values ) );
+	}
+	// stays above all depth values which are rounded to the largest stored value
+	// (or at the clear depth if the tile contains untouched pixels)
+	static FORCEINLINE F4 DecodeMax( F4 maxValue )
+	{
+		return (maxValue >= (F4)MAX_VALUE) ? SOFT_MAX_DEPTH : (maxValue + 1.0f) * (1.0f / MAX_VALUE);
+	}
+
+#if SOFT_RENDER_USE_AVX
+	static FORCEINLINE __m256 Encode_AVX2( __m256 z )
+	{
+		const __m256 qfSaturated = _mm256_min_ps( _mm256_max_ps( z, _mm256_setzero_ps() ), _mm256_set1_ps( 1.0f ) );
+		return _mm256_castsi256_ps( _mm256_cvtps_epi32( _mm256_mul_ps( qfSaturated, _mm256_set1_ps( (F4)MAX_VALUE ) ) ) );
+	}
+	static FORCEINLINE __m256 LessEqual_AVX2( __m256 a, __m256 b )
+	{
+		return _mm256_castsi256_ps( _mm256_xor_si256( _mm256_cmpgt_epi32( _mm256_castps_si256( a ), _mm256_castps_si256( b ) ), _mm256_set1_epi32( -1 ) ) );
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+#if SOFT_RENDER_USE_AVX512
+	static FORCEINLINE __m512 Encode_AVX512( __m512 z )
+	{
+		const __m512 qfSaturated = _mm512_min_ps( _mm512_max_ps( z, _mm512_setzero_ps() ), _mm512_set1_ps( 1.0f ) );
+		return _mm512_castsi512_ps( _mm512_cvtps_epi32( _mm512_mul_ps( qfSaturated, _mm512_set1_ps( (F4)MAX_VALUE ) ) ) );
+	}
+	static FORCEINLINE __mmask16 LessEqual_AVX512( __mmask16 mask, __m512 a, __m512 b )
+	{
+		return _mm512_mask_cmple_epi32_mask( mask, _mm512_castps_si512( a ), _mm512_castps_si512( b ) );
+	}
+#endif // SOFT_RENDER_USE_AVX512
+};
+
+template<>
+struct srDepthFormat< DepthFormat_D24 > : srDepthUNorm< 0x00FFFFFF >
+{
+	typedef UINT32 Elem;
+
+	static FORCEINLINE Elem Encode( F4 z )
+	{
+		return _mm_cvtsi128_si32( _mm_castps_si128( Encode_SSE( _mm_set_ss( z ) ) ) );
+	}
+
+	static FORCEINLINE __m128 Load_SSE( const Elem* depth )
+	{
+		return _mm_load_ps( (const F4*) depth );
+	}
+	static FORCEINLINE void Store_SSE( Elem* depth, __m128 values )
+	{
+		_mm_store_ps( (F4*) depth, values );
+	}
+
+#if SOFT_RENDER_USE_AVX
+	static FORCEINLINE __m256 Load_AVX2( const Elem* depth )
+	{
+		return _mm256_loadu_ps( (const F4*) depth );
+	}
+	static FORCEINLINE void Store_AVX2( Elem* depth, __m256 values )
+	{
+		_mm256_storeu_ps( (F4*) depth, values );
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+#if SOFT_RENDER_USE_AVX512
+	static FORCEINLINE __m512 Load_AVX512( __mmask16 mask, const Elem* depth )
+	{
+		return _mm512_maskz_loadu_ps( mask, (const F4*) depth );
+	}
+	static FORCEINLINE void Store_AVX512( Elem* depth, __mmask16 mask, __m512 values )
+	{
+		_mm512_mask_storeu_ps( (F4*) depth, mask, values );
+	}
+#endif // SOFT_RENDER_USE_AVX512
+};
+
+template<>
+struct srDepthFormat< DepthFormat_D16 > : srDepthUNorm< 0xFFFF >
+{
+	typedef UINT16 Elem;
+
+	static FORCEINLINE Elem Encode( F4 z )
+	{
+		return (Elem) _mm_cvtsi128_si32( _mm_castps_si128( Encode_SSE( _mm_set_ss( z ) ) ) );
+	}
+
+	// 16-bit values are widened to 32 bits in registers
+	static FORCEINLINE __m128 Load_SSE( const Elem* depth )
+	{
+		return _mm_castsi128_ps( _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i*) depth ) ) );
+	}
+	static FORCEINLINE void Store_SSE( Elem* depth, __m128 values )
+	{
+		const __m128i qiValues = _mm_castps_si128( values );
+		_mm_storel_epi64( (__m128i*) depth, _mm_packus_epi32( qiValues, qiValues ) );
+	}
+
+#if SOFT_RENDER_USE_AVX
+	static FORCEINLINE __m256 Load_AVX2( const Elem* depth )
+	{
+		return _mm256_castsi256_ps( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*) depth ) ) );
+	}
+	static FORCEINLINE void Store_AVX2( Elem* depth, __m256 values )
+	{
+		const __m256i qiValues = _mm256_castps_si256( values );
+		_mm_storeu_si128( (__m128i*) depth, _mm_packus_epi32( _mm256_castsi256_si128( qiValues ), _mm256_extracti128_si256( qiValues, 1 ) ) );
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+#if SOFT_RENDER_USE_AVX512
+	static FORCEINLINE __m512 Load_AVX512( __mmask16 mask, const Elem* depth )
+	{
+		return _mm512_castsi512_ps( _mm512_maskz_cvtepu16_epi32( mask, _mm256_loadu_si256( (const __m256i*) depth ) ) );
+	}
+	static FORCEINLINE void Store_AVX512( Elem* depth, __mmask16 mask, __m512 values )
+	{
+		_mm512_mask_cvtepi32_storeu_epi16( depth, mask, _mm512_castps_si512( values ) );
+	}
+#endif // SOFT_RENDER_USE_AVX512
+};
+
+// returns the address of the given pixel in the depth buffer of the context
+template< EDepthFormat FORMAT >
+FORCEINLINE
+typename srDepthFormat< FORMAT >::Elem* GetDepthAddress( const SoftRenderContext& context, UINT iX, UINT iY )
+{
+	Assert( context.depthFormat == FORMAT );
+	return (typename srDepthFormat< FORMAT >::Elem*) context.depthBuffer + iY * context.W + iX;
+}
+
+// recomputes the farthest depth value of the given screen tile (hierarchical Z) after it has been rasterized;
+// a screen tile is only rasterized by one thread at a time, so no synchronization is needed
+template< EDepthFormat FORMAT >
+FORCEINLINE
+void Template_UpdateTileMaxDepth_SSE( UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	typedef srDepthFormat< FORMAT > DEPTH;
+
+	const typename DEPTH::Elem* depth = GetDepthAddress< FORMAT >( context, iBlockX, iBlockY );
+
+	__m128 qfMaxDepth = DEPTH::ToFloat_SSE( DEPTH::Load_SSE( depth ) );
+
+	for( UINT iY = 0; iY < TILE_SIZE_Y; iY++ )
+	{
+		for( UINT iX = 0; iX < TILE_SIZE_X; iX += SSE_REG_WIDTH )
+		{
+			qfMaxDepth = _mm_max_ps( qfMaxDepth, DEPTH::ToFloat_SSE( DEPTH::Load_SSE( depth + iX ) ) );
+		}
+		depth += context.W;
+	}
+
+	// horizontal maximum
+	qfMaxDepth = _mm_max_ps( qfMaxDepth, _mm_shuffle_ps( qfMaxDepth, qfMaxDepth, _MM_SHUFFLE(1,0,3,2) ) );
+	qfMaxDepth = _mm_max_ps( qfMaxDepth, _mm_shuffle_ps( qfMaxDepth, qfMaxDepth, _MM_SHUFFLE(2,3,0,1) ) );
+
+	const UINT iDepthTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+	context.tileMaxDepth[ iDepthTile ] = DEPTH::DecodeMax( _mm_cvtss_f32( qfMaxDepth ) );
+}
+
+FORCEINLINE
+void UpdateTileMaxDepth_SSE( UINT iBlockX, UINT iBlockY, const SoftRenderContext& context )
+{
+	if( !context.tileMaxDepth ) {
+		return;
+	}
+	// compressed depth is not in the depth buffer
+	if( context.frameBuffer != nil )
+	{
+		const UINT iTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+		if( context.frameBuffer->m_tileFlags[ iTile ] & SoftFrameBuffer::TILE_DEPTH_PLANE )
+		{
+			context.tileMaxDepth[ iTile ] = context.frameBuffer->GetDepthPlaneMax( iTile );
+			return;
+		}
+	}
+	switch( context.depthFormat )
+	{
+	case DepthFormat_D24 :
+		Template_UpdateTileMaxDepth_SSE< DepthFormat_D24 >( iBlockX, iBlockY, context );
+		break;
+	case DepthFormat_D16 :
+		Template_UpdateTileMaxDepth_SSE< DepthFormat_D16 >( iBlockX, iBlockY, context );
+		break;
+	default:
+		Template_UpdateTileMaxDepth_SSE< DepthFormat_F32 >( iBlockX, iBlockY, context );
+	}
+}
+
+// redirects the color and depth buffers of the given context into the memory of a single screen tile
+// (with a row pitch of TILE_SIZE_X); the kernels address pixels by screen coordinates,
+// so the pointers are biased to map the top-left pixel of the tile onto the first element
+FORCEINLINE
+void BindTileMemory( SoftRenderContext & context, SoftPixel* color, void* depth, UINT iBlockX, UINT iBlockY )
+{
+	const UINT bias = iBlockY * TILE_SIZE_X + iBlockX;
+	context.colorBuffer = color - bias;
+	context.depthBuffer = (BYTE*) depth - bias * SoftFrameBuffer::GetDepthElementSize( context.depthFormat );
+	context.W = TILE_SIZE_X;
+}
+
+// binds the context of a framebuffer with tiled layout to the memory of the given screen tile
+// (memory tiles are screen tiles, numDepthTilesX is the number of tiles per row)
+FORCEINLINE
+void BindTiledFrameBuffer( SoftRenderContext & context, UINT iBlockX, UINT iBlockY )
+{
+	Assert( context.bTiledLayout );
+	const UINT iTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+	const UINT offset = iTile * (TILE_SIZE_X * TILE_SIZE_Y);
+	BindTileMemory( context, context.colorBuffer + offset, (BYTE*) context.depthBuffer + offset * SoftFrameBuffer::GetDepthElementSize( context.depthFormat ), iBlockX, iBlockY );
+}
+
+// writes the pending clears of the framebuffer into the given screen tile before it's rendered to in place
+// (compressed depth is expanded by the rasterizer if needed)
+FORCEINLINE
+void PrepareScreenTile( const SoftRenderContext& context, UINT iBlockX, UINT iBlockY )
+{
+	if( context.frameBuffer != nil )
+	{
+		const UINT iTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+		context.frameBuffer->PrepareTileKeepDepthPlane( iTile );
+	}
+}
+
+// color and depth of one screen tile copied into a small block of memory which stays in L1 cache;
+// all triangles of the tile are rasterized into it and it's written back to the framebuffer once
+mxALIGN_BY_CACHE_LINE struct srTileScratch
+{
+	SoftPixel	color[ TILE_SIZE_X * TILE_SIZE_Y ];
+	F4			depth[ TILE_SIZE_X * TILE_SIZE_Y ];	// large enough for all depth formats
+
+public:
+	// cleared tiles are filled with the clear values instead of being read from the framebuffer,
+	// compressed depth stays in the framebuffer (see SoftFrameBuffer::TILE_DEPTH_PLANE);
+	// only the part of an edge tile inside the viewport is loaded or cleared
+	FORCEINLINE void Load( const SoftRenderContext& context, UINT iBlockX, UINT iBlockY )
+	{
+		UINT flags = 0;
+		UINT numColumns = TILE_SIZE_X, numRows = TILE_SIZE_Y;
+		if( context.frameBuffer != nil )
+		{
+			const UINT iTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+			flags = context.frameBuffer->m_tileFlags[ iTile ];
+			context.frameBuffer->m_tileFlags[ iTile ] = flags & SoftFrameBuffer::TILE_DEPTH_PLANE;
+
+			UINT x, y;
+			context.frameBuffer->GetTileRect( iTile, x, y, numColumns, numRows );
+		}
+		const bool bClearColor = (flags & SoftFrameBuffer::TILE_COLOR_CLEARED) != 0;
+		const bool bClearDepth = (flags & SoftFrameBuffer::TILE_DEPTH_CLEARED) != 0;
+		const bool bLoadDepth = (flags & SoftFrameBuffer::TILE_DEPTH_PLANE) == 0;
+
+		const UINT32 clearColor = bClearColor ? context.frameBuffer->m_clearColor : 0;
+		const UINT32 clearDepth = SoftFrameBuffer::GetDepthClearValue( context.depthFormat );
+		const __m128i qiClearColor = _mm_set1_epi32( clearColor );
+		const __m128i qiClearDepth = _mm_set1_epi32( clearDepth );
+
+		// the rest of an edge tile is never stored, but UpdateTileMaxDepth_SSE() reads all of it:
+		// it gets the farthest depth instead of the stale values of the previous tile
+		if( numColumns < TILE_SIZE_X || numRows < TILE_SIZE_Y )
+		{
+			for( UINT iByte = 0; iByte < sizeof depth; iByte += sizeof __m128i )
+			{
+				_mm_store_si128( (__m128i*) ((BYTE*) depth + iByte), qiClearDepth );
+			}
+		}
+
+		// depth values are copied as bytes
+		const UINT depthSize = SoftFrameBuffer::GetDepthElementSize( context.depthFormat );
+		const UINT depthRowSize = TILE_SIZE_X * depthSize;
+		const UINT depthCopySize = numColumns * depthSize;
+
+		const SoftPixel* srcColor = context.colorBuffer + iBlockY * context.W + iBlockX;
+		const BYTE* srcDepth = (const BYTE*) context.depthBuffer + (iBlockY * context.W + iBlockX) * depthSize;
+		BYTE* dstDepth = (BYTE*) depth;
+
+		for( UINT iY = 0; iY < numRows; iY++ )
+		{
+			UINT iX = 0;
+			for( ; iX + SSE_REG_WIDTH <= numColumns; iX += SSE_REG_WIDTH )
+			{
+				const UINT i = iY * TILE_SIZE_X + iX;
+				_mm_store_si128( (__m128i*) &color[i], bClearColor ? qiClearColor : _mm_loadu_si128( (const __m128i*) (srcColor + iX) ) );
+			}
+			for( ; iX < numColumns; iX++ )
+			{
+				color[ iY * TILE_SIZE_X + iX ] = bClearColor ? clearColor : srcColor[ iX ];
+			}
+			if( bLoadDepth )
+			{
+				UINT iByte = 0;
+				for( ; iByte + sizeof __m128i <= depthCopySize; iByte += sizeof __m128i )
+				{
+					_mm_store_si128( (__m128i*) (dstDepth + iByte), bClearDepth ? qiClearDepth : _mm_loadu_si128( (const __m128i*) (srcDepth + iByte) ) );
+				}
+				// 16-bit depth values are replicated in the clear value
+				for( ; iByte + 4 <= depthCopySize; iByte += 4 )
+				{
+					*(UINT32*) (dstDepth + iByte) = bClearDepth ? clearDepth : *(const UINT32*) (srcDepth + iByte);
+				}
+				if( iByte < depthCopySize )
+				{
+					*(UINT16*) (dstDepth + iByte) = bClearDepth ? (UINT16) clearDepth : *(const UINT16*) (srcDepth + iByte);
+				}
+			}
+			srcColor += context.W;
+			srcDepth += context.W * depthSize;
+			dstDepth += depthRowSize;
+		}
+	}
+	// non-temporal stores bypass the cache (the framebuffer won't be read until the next frame);
+	// only the part of an edge tile inside the viewport is written back
+	FORCEINLINE void Store( const SoftRenderContext& context, UINT iBlockX, UINT iBlockY, bool bNonTemporal ) const
+	{
+		const UINT depthSize = SoftFrameBuffer::GetDepthElementSize( context.depthFormat );
+		const UINT depthRowSize = TILE_SIZE_X * depthSize;
+
+		SoftPixel* dstColor = context.colorBuffer + iBlockY * context.W + iBlockX;
+		BYTE* dstDepth = (BYTE*) context.depthBuffer + (iBlockY * context.W + iBlockX) * depthSize;
+		const BYTE* srcDepth = (const BYTE*) depth;
+
+		// the color buffer is supplied by the user and may be unaligned,
+		// rows of 16-bit depth values are aligned only if the width is a multiple of 8
+		const bool bStreamColor = bNonTemporal && IS_16_BYTE_ALIGNED( dstColor ) && (context.W % SSE_REG_WIDTH == 0);
+		const bool bStreamDepth = bNonTemporal && IS_16_BYTE_ALIGNED( dstDepth ) && ((context.W * depthSize) % sizeof __m128i == 0);
+
+		// compressed depth has not been expanded into the tile
+		bool bStoreDepth = true;
+		UINT numColumns = TILE_SIZE_X, numRows = TILE_SIZE_Y;
+		if( context.frameBuffer != nil )
+		{
+			const UINT iTile = (iBlockY / TILE_SIZE_Y) * context.numDepthTilesX + (iBlockX / TILE_SIZE_X);
+			bStoreDepth = (context.frameBuffer->m_tileFlags[ iTile ] & SoftFrameBuffer::TILE_DEPTH_PLANE) == 0;
+
+			UINT x, y;
+			context.frameBuffer->GetTileRect( iTile, x, y, numColumns, numRows );
+		}
+		const UINT depthCopySize = numColumns * depthSize;
+
+		for( UINT iY = 0; iY < numRows; iY++ )
+		{
+			UINT iX = 0;
+			for( ; iX + SSE_REG_WIDTH <= numColumns; iX += SSE_REG_WIDTH )
+			{
+				const UINT i = iY * TILE_SIZE_X + iX;
+				const __m128i qiColor = _mm_load_si128( (const __m128i*) &color[i] );
+
+				if( bStreamColor ) {
+					_mm_stream_si128( (__m128i*) (dstColor + iX), qiColor );
+				} else {
+					_mm_storeu_si128( (__m128i*) (dstColor + iX), qiColor );
+				}
+			}
+			for( ; iX < numColumns; iX++ )
+			{
+				dstColor[ iX ] = color[ iY * TILE_SIZE_X + iX ];
+			}
+			if( bStoreDepth )
+			{
+				UINT iByte = 0;
+				for( ; iByte + sizeof __m128i <= depthCopySize; iByte += sizeof __m128i )
+				{
+					const __m128i qiDepth = _mm_load_si128( (const __m128i*) (srcDepth + iByte) );
+
+					if( bStreamDepth ) {
+						_mm_stream_si128( (__m128i*) (dstDepth + iByte), qiDepth );
+					} else {
+						_mm_storeu_si128( (__m128i*) (dstDepth + iByte), qiDepth );
+					}
+				}
+				for( ; iByte < depthCopySize; iByte += 2 )
+				{
+					*(UINT16*) (dstDepth + iByte) = *(const UINT16*) (srcDepth + iByte);
+				}
+			}
+			dstColor += context.W;
+			dstDepth += context.W * depthSize;
+			srcDepth += depthRowSize;
+		}
+	}
+	// redirects the color and depth buffers of the given context into this tile
+	FORCEINLINE void Bind( SoftRenderContext & context, UINT iBlockX, UINT iBlockY )
+	{
+		BindTileMemory( context, color, depth, iBlockX, iBlockY );
+	}
+};
+
+// render states captured by DrawTriangles(),
+// used when the binned triangles are rasterized later
+struct srDrawCall
+{
+	ShaderGlobals		globals;
+	SoftRenderContext	context;	// context.globals points to globals
+};
+
+// maximum number of geometry front-end jobs per batch of triangles
+enum { MAX_FRONT_END_JOBS = 16 };
+
+// minimum number of triangles worth processing in a separate job
+enum { TRIANGLES_PER_FRONT_END_JOB = 128 };
+
+// face buffer slots reserved per input triangle: clipping against NUM_CLIP_PLANES planes
+// turns a triangle into a convex polygon with up to 3 + NUM_CLIP_PLANES vertices, i.e. up to NUM_CLIP_PLANES + 1 triangles
+enum { FACES_PER_INPUT_TRIANGLE = NUM_CLIP_PLANES + 1 };
+
+// binned tiles are sorted by screen position with a parallel LSD radix sort
+enum { MAX_RADIX_BITS = 11 };	// max. size of a radix digit, in bits
+enum { MAX_SORT_JOBS = 16 };	// max. number of jobs per radix sort pass
+enum { TILES_PER_SORT_JOB = 4096 };	// minimum number of tiles worth sorting in a separate job
+
+class srTileRenderer;
+
+// number of tiles in a tile block (8 KiB)
+enum { TILES_PER_BLOCK = 1024 };
+
+// tiles are allocated from fixed-size blocks which are never resized, so binned tiles are never moved or overwritten;
+// each front-end chunk has its own pool of blocks, blocks are returned to the pool of their owner after rasterization
+struct srTileBlock
+{
+	srTileBlock *	next;		// next block in the list
+	UINT			numTiles;	// number of used tiles
+	UINT			iOwner;		// index of the front-end chunk owning this block
+	srTile			tiles[TILES_PER_BLOCK];
+};
+
+// singly linked list of tile blocks, tiles are stored in submission order
+struct srTileBlockList
+{
+	srTileBlock *	head;
+	srTileBlock *	tail;
+	UINT			numTiles;	// total number of tiles in all blocks
+
+public:
+	FORCEINLINE void Clear()
+	{
+		head = nil;
+		tail = nil;
+		numTiles = 0;
+	}
+	FORCEINLINE bool IsEmpty() const
+	{
+		return head == nil;
+	}
+	FORCEINLINE void AddBlock( srTileBlock* block )
+	{
+		block->next = nil;
+		if( tail ) {
+			tail->next = block;
+		} else {
+			head = block;
+		}
+		tail = block;
+		numTiles += block->numTiles;
+	}
+	// moves all blocks of the other list to the end of this list
+	FORCEINLINE void Append( srTileBlockList & other )
+	{
+		if( other.IsEmpty() ) {
+			return;
+		}
+		if( tail ) {
+			tail->next = other.head;
+		} else {
+			head = other.head;
+		}
+		tail = other.tail;
+		numTiles += other.numTiles;
+		other.Clear();
+	}
+};
+
+// a contiguous range of triangles of a draw call
+// which is transformed, clipped, set up and binned by a single front-end job;
+// each chunk writes only into its own slice of the face buffer and its own tile list,
+// so that chunks can be processed in parallel without any synchronization
+struct srFrontEndChunk
+{
+	srTileRenderer *	renderer;
+	SoftRenderContext	context;	// copy of the draw call context, context.userPointer points to this chunk
+
+	const SVertex *		vertices;
+	UINT				numVertices;
+	const SIndex *		indices;
+	UINT				numTriangles;
+
+	UINT		firstFace;	// start of this chunk's slice in the face buffer
+	UINT		numFaces;	// number of triangles added to the face buffer by this chunk
+	UINT		numSetupFaces;	// number of those triangles which have been set up and binned
+	UINT		maxFaces;	// size of the slice (enough for the worst case of clipping)
+
+	srTileBlockList	tiles;		// binned tiles in submission order
+	srTileBlock *	freeBlocks;	// pool of unused tile blocks owned by this chunk
+	UINT			numBlocks;	// total number of tile blocks allocated by this chunk
+	UINT			iChunk;		// index of this chunk
+
+	Stats		stats;
+};
+
+// the face buffer is split into a ring of slices:
+// while the tiles of one slice are being rasterized by worker threads,
+// triangles of the next batch are transformed and binned into the next slice
+enum { NUM_FACE_BUFFERS = 2 };
+
+// a slice of the face buffer with the tiles binned for its triangles
+struct srFaceBuffer
+{
+	UINT			firstFace;	// start of this slice in the face buffer
+	UINT			numFaces;	// number of used slots (including slots left unused by front-end chunks)
+	srTileBlockList	tiles;		// tiles of all chunks in submission order
+};
+
+struct RasterizeScreenTilesJob;
+
 struct Fragment
 {
 	UINT16		iFace;	// triangle index
@@ -110,7 +1038,15 @@ public_internal:
 	float4x4	m_projectionMatrix;
 
 	F_VertexShader *	m_vertexShader;
+	F_VertexShader4 *	m_vertexShader4;
+#if SOFT_RENDER_USE_AVX
+	F_VertexShader8 *	m_vertexShader8;
+#endif // SOFT_RENDER_USE_AVX
 	F_PixelShader *		m_pixelShader;
+	F_PixelShader4 *	m_pixelShader4;
+#if SOFT_RENDER_USE_AVX
+	F_PixelShader8 *	m_pixelShader8;
+#endif // SOFT_RENDER_USE_AVX
 
 	ECullMode	m_cullMode;
 	EFillMode	m_fillMode;
@@ -120,17 +1056,53 @@ public_internal:
 	F_RenderTriangles *			m_ftblProcessTriangles[Fill_MAX][Cull_MAX];
 	F_RenderSingleTriangle *	m_ftblDrawTriangle[Fill_MAX];
 
+	// triangle setup and tile rasterization kernels for the selected instruction set
+	srTileKernels				m_tileKernels[DepthFormat_MAX];	// indexed by the depth format of the framebuffer
+	F_SetupTriangles *			m_setupTriangles;
+	ECpuMode					m_cpuMode;	// instruction set used by the tile kernels
+	bool						m_useCoverageMasks;	// partially covered tiles are rasterized with 8x8 coverage masks
+	bool						m_useNonTemporalStores;	// screen tiles are written back with streaming stores
+
+	// vertices of the current draw call shaded by SIMD vertex shaders
+	srTransformedVertexBuffer	m_transformedVertices;
+
+
+	// draw calls submitted since the last flush
+	srDrawCall				m_drawCalls[MAX_DRAW_CALLS];
+	UINT					m_numDrawCalls;
+
+	// true if triangles of all draw calls are binned and rasterized once, in Flush()
+	bool					m_deferRasterization;
+
+	// geometry front-end chunks of the current batch of triangles
+	srFrontEndChunk			m_frontEndChunks[MAX_FRONT_END_JOBS];
 
 	//TStaticList< XVertex, MAX_BATCHED_VERTICES >	m_batchedVertices;
-	mxSIMDALIGNED XTriangle	m_transformedFaces[FACE_BUFFER_SIZE];
-	UINT					m_nTransformedTris;
+	mxSIMDALIGNED XTriangle	m_transformedFaces[NUM_FACE_BUFFERS * FACE_BUFFER_SIZE];
+
+	// ring of face buffer slices; triangles are binned into the current slice,
+	// full slices wait for rasterization in submission order
+	srFaceBuffer			m_faceBuffers[NUM_FACE_BUFFERS];
+	UINT					m_iCurrentFaceBuffer;	// index of the slice being filled
+	UINT					m_numPendingFaceBuffers;	// number of full slices preceding the current one
 
-	srTile *				m_tiles;	// grows in powers of two
-	UINT					m_numTiles;	// current number of tiles
 	//UINT					m_numFullyCoveredTiles;	// number of trivially accepted tiles
-	UINT					m_maxTiles;	// number of dynamically allocated tiles
+	UINT					m_peakBinnedTiles;	// high-water mark of binned tiles per slice
+
+	// sort buffers, resized only before sorting when no tiles are stored in them
+	srTile *				m_tiles;	// binned tiles gathered into a contiguous array
+	srTile *				m_sortedTiles;
+	UINT					m_maxSortedTiles;	// size of both sort buffers, grows in powers of two
+
+	// screen is split into bins, one bin per TILE_SIZE_X x TILE_SIZE_Y screen tile;
+	// each bin holds a list of triangle tiles in submission order
+	UINT					m_numTilesX;	// number of screen tiles along X axis
+	UINT					m_numTilesY;	// number of screen tiles along Y axis
+	UINT *					m_binOffsets;	// [m_numTilesX * m_numTilesY + 1] start of each bin in m_sortedTiles
 
-	srTile *				m_sortedTiles;	// grows in powers of two
+	// digit counts of each sort job in the current radix sort pass,
+	// turned into scatter offsets by the prefix sum
+	UINT					m_radixCounts[MAX_SORT_JOBS][1 << MAX_RADIX_BITS];
 
 public:
 	srTileRenderer( UINT width, UINT height );
@@ -144,14 +1116,110 @@ public:
 	void SetFillMode( EFillMode newFillMode ) override;
 
 	void SetVertexShader( F_VertexShader* newVertexShader ) override;
+	void SetVertexShader4( F_VertexShader4* newVertexShader ) override;
+#if SOFT_RENDER_USE_AVX
+	void SetVertexShader8( F_VertexShader8* newVertexShader ) override;
+#endif // SOFT_RENDER_USE_AVX
 	void SetPixelShader( F_PixelShader* newPixelShader ) override;
+	void SetPixelShader4( F_PixelShader4* newPixelShader ) override;
+#if SOFT_RENDER_USE_AVX
+	void SetPixelShader8( F_PixelShader8* newPixelShader ) override;
+#endif // SOFT_RENDER_USE_AVX
 
 	void SetTexture( SoftTexture2D* newTexture2D ) override;
 
 	void DrawTriangles( SoftFrameBuffer& frameBuffer, const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numIndices ) override;
 
+	void Flush() override;
+
+	void ModifySettings( const Settings& newSettings ) override;
+	ECpuMode GetCpuMode() const override;
+
+	FORCEINLINE const SoftRenderContext& GetDrawContext( const srTile& tile ) const
+	{
+		const XTriangle& face = m_transformedFaces[ tile.iFace ];
+		Assert( face.iDrawCall < m_numDrawCalls );
+		return m_drawCalls[ face.iDrawCall ].context;
+	}
+
+	// returns the context for rasterizing the given screen tile: the context of the draw call or,
+	// if its framebuffer has tiled layout, a copy in the given storage bound to the memory of the tile
+	FORCEINLINE const SoftRenderContext& GetTileContext( const srTile& tile, SoftRenderContext & storage ) const
+	{
+		const SoftRenderContext& context = GetDrawContext( tile );
+		if( !context.bTiledLayout ) {
+			return context;
+		}
+		storage = context;
+		BindTiledFrameBuffer( storage, tile.GetX(), tile.GetY() );
+		return storage;
+	}
+
+	// rasterizes the tile in place
+	FORCEINLINE void RasterizeTile( const srTile& tile ) const
+	{
+		PrepareScreenTile( GetDrawContext( tile ), tile.GetX(), tile.GetY() );
+
+		SoftRenderContext	storage;
+		this->RasterizeTile( tile, GetTileContext( tile, storage ) );
+	}
+
+	// rasterizes the tile into the color and depth buffers of the given context
+	FORCEINLINE void RasterizeTile( const srTile& tile, const SoftRenderContext& context ) const
+	{
+		const XTriangle& face = m_transformedFaces[ tile.iFace ];
+
+		// compressed depth is tested against the plane of the triangle
+		if( context.frameBuffer != nil && context.frameBuffer->m_depthPlanes != nil )
+		{
+			const UINT iTile = (tile.GetY() / TILE_SIZE_Y) * context.numDepthTilesX + (tile.GetX() / TILE_SIZE_X);
+			if( (context.frameBuffer->m_tileFlags[ iTile ] & SoftFrameBuffer::TILE_DEPTH_PLANE)
+				&& this->RasterizeDepthPlaneTile( tile, iTile, context ) )
+			{
+				return;
+			}
+		}
+
+		const srTileKernels& kernels = m_tileKernels[ context.depthFormat ];
+
+		F_RasterizeTile* rasterizeTile = tile.bFullyCovered
+			? kernels.rasterizeFullyCoveredTile
+			: (IsSmallTriangle( face ) ? kernels.rasterizeSmallTriangle : kernels.rasterizePartiallyCoveredTile);
+		(*rasterizeTile)( face, tile.GetX(), tile.GetY(), context );
+	}
+
+	// lowers the farthest depth value of the screen tile after its triangles have been rasterized
+	FORCEINLINE void UpdateTileMaxDepth( const srTile& tile ) const
+	{
+		SoftRenderContext	storage;
+		UpdateTileMaxDepth_SSE( tile.GetX(), tile.GetY(), GetTileContext( tile, storage ) );
+	}
+
+	FORCEINLINE UINT GetScreenTileIndex( const srTile& tile ) const
+	{
+		return tile.iY * m_numTilesX + tile.iX;
+	}
+
+	// rasterizes all triangles of one screen tile (sorted in submission order) in the scratch block
+	void RasterizeScreenTile( const srTile* tiles, UINT numTiles, srTileScratch & scratch ) const;
+	void BindScreenTile( SoftRenderContext & context, srTileScratch & scratch, UINT iBlockX, UINT iBlockY ) const;
+	bool RasterizeDepthPlaneTile( const srTile& tile, UINT iTile, const SoftRenderContext& context ) const;
+
+	// runs the geometry front end on the triangles of the given chunk (called from worker threads)
+	void ProcessTriangleChunk( srFrontEndChunk & chunk );
+
 private:
-	void ProcessTriangles( const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numTriangles, const SoftRenderContext& context );
+	void SelectTileKernels();
+	void BinTriangles( const SVertex* vertices, UINT numVertices, const SIndex* indices, UINT numTriangles, const SoftRenderContext& context );
+	void ReserveSortBuffers( UINT numTiles );
+	void SortTilesByScreenPosition( const srTileBlockList& tiles );
+	void RecycleTileBlocks( srTileBlockList & tiles );
+	UINT EnqueueRasterizeJobs( const srFaceBuffer& faces, RasterizeScreenTilesJob* jobs );
+	void FinishRasterization( srFaceBuffer & faces );
+	void RasterizeTiles( srFaceBuffer & faces );
+	void SubmitFaceBuffer();
+	void RasterizePendingFaceBuffer();
+	srFaceBuffer& GetPendingFaceBuffer();
 };
 
 }//namespace SoftRenderer
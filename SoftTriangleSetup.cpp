@@ -5,7 +5,6 @@
 #include "TriangleClipping.inl"
 #include "Rasterizer_FPU.inl"
 #include "Rasterizer_SSE.inl"
-#include "Rasterizer_AVX.inl"
 
 #if 0
 namespace SoftRenderer
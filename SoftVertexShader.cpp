@@ -0,0 +1,271 @@
+#include "SoftRender_PCH.h"
+#pragma hdrstop
+#include "SoftRender.h"
+#include "SoftRender_Internal.h"
+
+namespace SoftRenderer
+{
+
+// vertices are converted between AoS and SoA layouts with 4x4 (or 8x8) transposes
+mxSTATIC_ASSERT( sizeof SVertex == 8 * sizeof F4 );
+mxSTATIC_ASSERT( sizeof XVertex == 8 * sizeof F4 );
+mxSTATIC_ASSERT( NUM_VARYINGS == 4 );
+
+// size of the largest vertex batch
+enum { MAX_VERTEX_BATCH_SIZE = 8 };
+
+//-------------------------------------------------------------------
+//	SSE
+//-------------------------------------------------------------------
+
+// loads 4 vertices and converts them into SoA layout
+static FORCEINLINE
+void LoadVertices_SSE( const SVertex& v0, const SVertex& v1, const SVertex& v2, const SVertex& v3, SVertex4 &outputs )
+{
+	// position.x, position.y, position.z, normal.x
+	__m128 r0 = _mm_load_ps( (const F4*) &v0 );
+	__m128 r1 = _mm_load_ps( (const F4*) &v1 );
+	__m128 r2 = _mm_load_ps( (const F4*) &v2 );
+	__m128 r3 = _mm_load_ps( (const F4*) &v3 );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	outputs.position[0] = r0;
+	outputs.position[1] = r1;
+	outputs.position[2] = r2;
+	outputs.normal[0] = r3;
+
+	// normal.y, normal.z, texCoord.x, texCoord.y
+	r0 = _mm_load_ps( (const F4*) &v0 + 4 );
+	r1 = _mm_load_ps( (const F4*) &v1 + 4 );
+	r2 = _mm_load_ps( (const F4*) &v2 + 4 );
+	r3 = _mm_load_ps( (const F4*) &v3 + 4 );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	outputs.normal[1] = r0;
+	outputs.normal[2] = r1;
+	outputs.texCoord[0] = r2;
+	outputs.texCoord[1] = r3;
+}
+
+// converts 4 transformed vertices into AoS layout and stores them
+static FORCEINLINE
+void StoreVertices_SSE( const XVertex4& inputs, XVertex* outputs )
+{
+	__m128 r0 = inputs.P[0];
+	__m128 r1 = inputs.P[1];
+	__m128 r2 = inputs.P[2];
+	__m128 r3 = inputs.P[3];
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	_mm_store_ps( (F4*) &outputs[0], r0 );
+	_mm_store_ps( (F4*) &outputs[1], r1 );
+	_mm_store_ps( (F4*) &outputs[2], r2 );
+	_mm_store_ps( (F4*) &outputs[3], r3 );
+
+	r0 = inputs.vars[0];
+	r1 = inputs.vars[1];
+	r2 = inputs.vars[2];
+	r3 = inputs.vars[3];
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	_mm_store_ps( (F4*) &outputs[0] + 4, r0 );
+	_mm_store_ps( (F4*) &outputs[1] + 4, r1 );
+	_mm_store_ps( (F4*) &outputs[2] + 4, r2 );
+	_mm_store_ps( (F4*) &outputs[3] + 4, r3 );
+}
+
+void VertexShader4_WVP_TexCoords( const ShaderGlobals& globals, const SVertex4& inputs, XVertex4 &outputs )
+{
+	// row-major matrix, row vectors: P = float4( position, 1 ) * WVP
+	const F4* M = (const F4*) &globals.WVP;
+
+	const __m128 x = inputs.position[0];
+	const __m128 y = inputs.position[1];
+	const __m128 z = inputs.position[2];
+
+	for( UINT i = 0; i < 4; i++ )
+	{
+		const __m128 xy = _mm_add_ps( _mm_mul_ps( x, _mm_load1_ps( &M[0*4+i] ) ), _mm_mul_ps( y, _mm_load1_ps( &M[1*4+i] ) ) );
+		const __m128 zw = _mm_add_ps( _mm_mul_ps( z, _mm_load1_ps( &M[2*4+i] ) ), _mm_load1_ps( &M[3*4+i] ) );
+		outputs.P[i] = _mm_add_ps( xy, zw );
+	}
+
+	outputs.vars[0] = inputs.texCoord[0];
+	outputs.vars[1] = inputs.texCoord[1];
+	outputs.vars[2] = _mm_setzero_ps();
+	outputs.vars[3] = _mm_setzero_ps();
+}
+
+//-------------------------------------------------------------------
+//	AVX
+//-------------------------------------------------------------------
+
+#if SOFT_RENDER_USE_AVX
+
+// loads 8 vertices and converts them into SoA layout
+static FORCEINLINE
+void LoadVertices_AVX( const SVertex* vertices, const UINT (&indices)[8], SVertex8 &outputs )
+{
+	__m256	r[8];
+	for( UINT i = 0; i < 8; i++ )
+	{
+		r[i] = _mm256_loadu_ps( (const F4*) &vertices[ indices[i] ] );
+	}
+
+	Transpose8x8_AVX( r );
+
+	outputs.position[0] = r[0];
+	outputs.position[1] = r[1];
+	outputs.position[2] = r[2];
+	outputs.normal[0] = r[3];
+	outputs.normal[1] = r[4];
+	outputs.normal[2] = r[5];
+	outputs.texCoord[0] = r[6];
+	outputs.texCoord[1] = r[7];
+}
+
+// converts 8 transformed vertices into AoS layout and stores them
+static FORCEINLINE
+void StoreVertices_AVX( const XVertex8& inputs, XVertex* outputs )
+{
+	__m256	r[8];
+	r[0] = inputs.P[0];
+	r[1] = inputs.P[1];
+	r[2] = inputs.P[2];
+	r[3] = inputs.P[3];
+	r[4] = inputs.vars[0];
+	r[5] = inputs.vars[1];
+	r[6] = inputs.vars[2];
+	r[7] = inputs.vars[3];
+
+	Transpose8x8_AVX( r );
+
+	for( UINT i = 0; i < 8; i++ )
+	{
+		_mm256_storeu_ps( (F4*) &outputs[i], r[i] );
+	}
+}
+
+void VertexShader8_WVP_TexCoords( const ShaderGlobals& globals, const SVertex8& inputs, XVertex8 &outputs )
+{
+	// row-major matrix, row vectors: P = float4( position, 1 ) * WVP
+	const F4* M = (const F4*) &globals.WVP;
+
+	const __m256 x = inputs.position[0];
+	const __m256 y = inputs.position[1];
+	const __m256 z = inputs.position[2];
+
+	for( UINT i = 0; i < 4; i++ )
+	{
+		const __m256 xy = _mm256_add_ps( _mm256_mul_ps( x, _mm256_broadcast_ss( &M[0*4+i] ) ), _mm256_mul_ps( y, _mm256_broadcast_ss( &M[1*4+i] ) ) );
+		const __m256 zw = _mm256_add_ps( _mm256_mul_ps( z, _mm256_broadcast_ss( &M[2*4+i] ) ), _mm256_broadcast_ss( &M[3*4+i] ) );
+		outputs.P[i] = _mm256_add_ps( xy, zw );
+	}
+
+	outputs.vars[0] = inputs.texCoord[0];
+	outputs.vars[1] = inputs.texCoord[1];
+	outputs.vars[2] = _mm256_setzero_ps();
+	outputs.vars[3] = _mm256_setzero_ps();
+}
+
+#endif // SOFT_RENDER_USE_AVX
+
+//-------------------------------------------------------------------
+//	srTransformedVertexBuffer
+//-------------------------------------------------------------------
+
+srTransformedVertexBuffer::srTransformedVertexBuffer()
+{
+	m_vertices = nil;
+	m_maxVertices = 0;
+}
+
+srTransformedVertexBuffer::~srTransformedVertexBuffer()
+{
+	mxFree( m_vertices );
+	m_vertices = nil;
+	m_maxVertices = 0;
+}
+
+const XVertex* srTransformedVertexBuffer::TransformVertices( const SVertex* vertices, UINT numVertices, const SoftRenderContext& context )
+{
+#if SOFT_RENDER_USE_AVX
+	// the renderer only passes the AVX shader if AVX is the selected (and supported) instruction set
+	const bool bUseAVX = (context.vertexShader8 != nil);
+#else
+	const bool bUseAVX = false;
+#endif // SOFT_RENDER_USE_AVX
+
+	if( !bUseAVX && !context.vertexShader4 ) {
+		return nil;
+	}
+	if( !numVertices ) {
+		return nil;
+	}
+
+	mxPROFILE_SCOPE("Transform Vertices (SIMD)");
+
+	// the last batch is padded (by repeating the last vertex) so that only whole batches are stored
+	const UINT numPaddedVertices = (numVertices + MAX_VERTEX_BATCH_SIZE-1) & ~(MAX_VERTEX_BATCH_SIZE-1);
+	if( numPaddedVertices > m_maxVertices )
+	{
+		mxFree( m_vertices );
+		m_maxVertices = NextPowerOfTwo( numPaddedVertices );
+		m_vertices = (XVertex*) mxAlloc( m_maxVertices * sizeof m_vertices[0] );
+	}
+
+	const UINT lastVertex = numVertices - 1;
+	const ShaderGlobals& globals = *context.globals;
+
+#if SOFT_RENDER_USE_AVX
+	if( bUseAVX )
+	{
+		F_VertexShader8* vertexShader = context.vertexShader8;
+
+		SVertex8	inputs;
+		XVertex8	outputs;
+
+		for( UINT iVertex = 0; iVertex < numVertices; iVertex += 8 )
+		{
+			UINT	indices[8];
+			for( UINT i = 0; i < 8; i++ ) {
+				indices[i] = smallest( iVertex + i, lastVertex );
+			}
+			LoadVertices_AVX( vertices, indices, inputs );
+
+			(*vertexShader)( globals, inputs, outputs );
+
+			StoreVertices_AVX( outputs, m_vertices + iVertex );
+		}
+
+		// avoid AVX-SSE transition penalties in the following code
+		_mm256_zeroupper();
+
+		return m_vertices;
+	}
+#endif // SOFT_RENDER_USE_AVX
+
+	F_VertexShader4* vertexShader = context.vertexShader4;
+
+	SVertex4	inputs;
+	XVertex4	outputs;
+
+	for( UINT iVertex = 0; iVertex < numVertices; iVertex += 4 )
+	{
+		LoadVertices_SSE(
+			vertices[ smallest( iVertex + 0, lastVertex ) ],
+			vertices[ smallest( iVertex + 1, lastVertex ) ],
+			vertices[ smallest( iVertex + 2, lastVertex ) ],
+			vertices[ smallest( iVertex + 3, lastVertex ) ],
+			inputs
+		);
+
+		(*vertexShader)( globals, inputs, outputs );
+
+		StoreVertices_SSE( outputs, m_vertices + iVertex );
+	}
+
+	return m_vertices;
+}
+
+}//namespace SoftRenderer
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -192,30 +192,30 @@ void SoftRenderer::DrawLine2D(
 	INT32 dx = iEndX - iStartX;
 	INT32 dy = iEndY - iStartY;
 
-	const UINT sizeOfPixel = sizeof ARGB32;
-	const UINT pitch = sizeOfPixel * viewportWidth;
-
 	// NOTE: we can only render lines
 	// that are mostly horizontal and go from left to right
 
 	// Divided drawing to x major DDA method and y major DDA method.
 
-	// step sizes in bytes
-	INT32 xInc = sizeOfPixel * Sign(dx);
-	INT32 yInc = pitch * Sign(dy);
+	// steps along the major and the minor axis, in pixels
+	// (pixels are addressed by coordinates, because the color buffer may have tiled layout)
+	INT32 majorStepX = Sign(dx), majorStepY = 0;
+	INT32 minorStepX = 0, minorStepY = Sign(dy);
 
 	dx = Abs(dx);	// NOTE: dx is positive
 	dy = Abs(dy);	// NOTE: dy is positive
 
 
 	// start with the first point
-	ARGB32* dst = (ARGB32*) ((BYTE*)GetColorBuffer() + (iStartX * sizeOfPixel) + (iStartY * pitch));
+	INT32 x = iStartX;
+	INT32 y = iStartY;
 
 	// if the line is mostly vertical
 	if ( dy > dx )
 	{
 		TSwap( dx, dy );
-		TSwap( xInc, yInc );
+		TSwap( majorStepX, minorStepX );
+		TSwap( majorStepY, minorStepY );
 	}
 
 	INT32 c = (UINT32)dx << 1;
@@ -228,15 +228,17 @@ void SoftRenderer::DrawLine2D(
 
 	while ( iStep-- )
 	{
-		*dst = color;
+		*(ARGB32*) GetPixelAddress( x, y ) = color;
 
-		dst = (ARGB32*) ( (BYTE*) dst + xInc );	// x += xInc
+		x += majorStepX;
+		y += majorStepY;
 		d += m;
 
 		// move to the next row
 		if ( d > dx )
 		{
-			dst = (ARGB32*) ( (BYTE*) dst + yInc );	// y += yInc
+			x += minorStepX;
+			y += minorStepY;
 			d -= c;
 		}
 	}
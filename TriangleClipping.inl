@@ -195,15 +195,37 @@ void Template_ProcessTriangles(
 {
 	XVertex	v[ CLIP_BUFFER_SIZE ];
 
+	// all vertices have already been shaded by a SIMD vertex shader
+	const XVertex* transformedVertices = context.transformedVertices;
+	if( transformedVertices != nil )
+	{
+		for( UINT i = 0; i < numIndices; i += 3 )
+		{
+			// NOTE: clipping modifies vertices so they are copied
+			v[0] = transformedVertices[ indices[i+0] ];
+			v[1] = transformedVertices[ indices[i+1] ];
+			v[2] = transformedVertices[ indices[i+2] ];
+
+			Template_ClipTriangle< CULL_MODE, FILL_MODE >( drawTriangleFunction, v, context );
+		}//for each triangle
+		return;
+	}
+
+	VertexCache	vertexCache;
+
 	for( UINT i = 0; i < numIndices; i += 3 )
 	{
-		// execute vertex shader, get clip-space vertex positions
-		TransformVertex( vertices[indices[i+0]], &v[0], context );
-		TransformVertex( vertices[indices[i+1]], &v[1], context );
-		TransformVertex( vertices[indices[i+2]], &v[2], context );
+		// execute vertex shader (only for vertices not found in the cache), get clip-space vertex positions
+		// NOTE: clipping modifies vertices so they are copied out of the cache
+		v[0] = vertexCache.TransformVertex( vertices, indices[i+0], context );
+		v[1] = vertexCache.TransformVertex( vertices, indices[i+1], context );
+		v[2] = vertexCache.TransformVertex( vertices, indices[i+2], context );
 
 		Template_ClipTriangle< CULL_MODE, FILL_MODE >( drawTriangleFunction, v, context );
 	}//for each triangle
+
+	context.stats->numVertexCacheHits += vertexCache.numHits;
+	context.stats->numVertexCacheMisses += vertexCache.numMisses;
 }
 
 }//namespace SoftRenderer
@@ -0,0 +1,682 @@
+// triangle setup for the tile renderer: converts projected triangles into fixed-point edge functions,
+// computes gradients of interpolated parameters and screen-space bounding rectangles;
+// SIMD versions set up 4 (SSE) or 8 (AVX2) triangles at once, one triangle per lane;
+// must be included after SoftTileRenderer.h
+#include "SoftMath.h"
+
+namespace SoftRenderer
+{
+
+//-------------------------------------------------------------------
+//	FPU
+//-------------------------------------------------------------------
+
+// sets up triangles one by one
+static
+void SetupTriangles_FPU( XTriangle* faces, UINT numTriangles, const SoftRenderContext& context )
+{
+	const int W = context.W;	// viewport width
+	const int H = context.H;	// viewport height
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	for( UINT iFace = 0; iFace < numTriangles; iFace++ )
+	{
+		XTriangle & face = faces[ iFace ];
+
+		const XVertex& v1 = face.v1;
+		const XVertex& v2 = face.v2;
+		const XVertex& v3 = face.v3;
+
+		const F4 fX1 = v1.P.x;
+		const F4 fX2 = v2.P.x;
+		const F4 fX3 = v3.P.x;
+
+		const F4 fY1 = v1.P.y;
+		const F4 fY2 = v2.P.y;
+		const F4 fY3 = v3.P.y;
+
+		const F4 fZ1 = v1.P.z;
+		const F4 fZ2 = v2.P.z;
+		const F4 fZ3 = v3.P.z;
+
+
+		const INT32 X1 = iround( F4(1<<FP_SHIFT) * fX1 );
+		const INT32 X2 = iround( F4(1<<FP_SHIFT) * fX2 );
+		const INT32 X3 = iround( F4(1<<FP_SHIFT) * fX3 );
+
+		const INT32 Y1 = iround( F4(1<<FP_SHIFT) * fY1 );
+		const INT32 Y2 = iround( F4(1<<FP_SHIFT) * fY2 );
+		const INT32 Y3 = iround( F4(1<<FP_SHIFT) * fY3 );
+
+		//const INT32 Z1 = iround( 16.0f * fZ1 );
+		//const INT32 Z2 = iround( 16.0f * fZ2 );
+		//const INT32 Z3 = iround( 16.0f * fZ3 );
+
+		//const INT32 W1 = iround( 16.0f * fInvW1 );
+		//const INT32 W2 = iround( 16.0f * fInvW2 );
+		//const INT32 W3 = iround( 16.0f * fInvW3 );
+
+
+		face.FPX[0] = X1;
+		face.FPX[1] = X2;
+		face.FPX[2] = X3;
+			
+		face.FPY[0] = Y1;
+		face.FPY[1] = Y2;
+		face.FPY[2] = Y3;
+
+
+
+		// deltas
+		const INT32 DeltaX12 = X1 - X2;
+		const INT32 DeltaX23 = X2 - X3;
+		const INT32 DeltaX31 = X3 - X1;
+
+		const INT32 DeltaY12 = Y1 - Y2;
+		const INT32 DeltaY23 = Y2 - Y3;
+		const INT32 DeltaY31 = Y3 - Y1;
+
+
+
+
+
+
+		// Compute interpolation data
+		//const F4 fDeltaX12 = fX1 - fX2;
+		//const F4 fDeltaX23 = fX2 - fX3;
+		const F4 fDeltaX31 = fX3 - fX1;
+
+		//const F4 fDeltaY12 = fY1 - fY2;
+		//const F4 fDeltaY23 = fY2 - fY3;
+		const F4 fDeltaY31 = fY3 - fY1;
+
+		const F4 fDeltaZ21 = fZ2 - fZ1;
+		const F4 fDeltaZ31 = fZ3 - fZ1;
+
+		const F4 fDeltaX21 = fX2 - fX1;
+		const F4 fDeltaY21 = fY2 - fY1;
+
+		const F4 INTERP_C = fDeltaX21 * fDeltaY31 - fDeltaX31 * fDeltaY21;
+
+
+		// compute gradient for interpolating depth (aka Z)
+
+		ComputeGradient_FPU(
+			INTERP_C,
+			fDeltaZ21, fDeltaZ31,
+			fDeltaX21, fDeltaX31,
+			fDeltaY21, fDeltaY31,
+			face.vZ.x, face.vZ.y
+			);
+
+		// NOTE: these are actually inverses of W (because of perspective division 1/w in ProjectVertex(), after vertex shader).
+		const F4 fInvW1 = v1.P.w;
+		const F4 fInvW2 = v2.P.w;
+		const F4 fInvW3 = v3.P.w;
+
+		// setup inverse W (for perspective-correct interpolation of varyings)
+		ComputeGradient_FPU(
+			INTERP_C,
+			fInvW2 - fInvW1, fInvW3 - fInvW1,
+			fDeltaX21, fDeltaX31,
+			fDeltaY21, fDeltaY31,
+			face.vInvW.x, face.vInvW.y
+			);
+
+		// setup varyings multiplied by inverse W (they can be linearly interpolated in screen space)
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			const F4 v1v = v1.vars[i] * fInvW1;
+			const F4 v2v = v2.vars[i] * fInvW2;
+			const F4 v3v = v3.vars[i] * fInvW3;
+
+			face.vars1OverW1[i] = v1v;
+
+			ComputeGradient_FPU(
+				INTERP_C,
+				v2v - v1v, v3v - v1v,
+				fDeltaX21, fDeltaX31,
+				fDeltaY21, fDeltaY31,
+				face.varsOverW[i].x, face.varsOverW[i].y
+				);
+		}
+
+
+
+
+		// Half-edge constants in 28.4
+		INT32 C1 = DeltaY12 * X1 - DeltaX12 * Y1;
+		INT32 C2 = DeltaY23 * X2 - DeltaX23 * Y2;
+		INT32 C3 = DeltaY31 * X3 - DeltaX31 * Y3;
+
+		// correct for top-left fill convention
+		if( DeltaY12 < 0 || (DeltaY12 == 0 && DeltaX12 > 0) ) {
+			++C1;
+		}
+		if( DeltaY23 < 0 || (DeltaY23 == 0 && DeltaX23 > 0) ) {
+			++C2;
+		}
+		if( DeltaY31 < 0 || (DeltaY31 == 0 && DeltaX31 > 0) ) {
+			++C3;
+		}
+
+
+		face.C1 = C1;
+		face.C2 = C2;
+		face.C3 = C3;
+
+
+		// Bounding rectangle of this triangle in screen space
+
+#if 0
+		const INT32 nMinX = ((Min3(X1, X2, X3) + 0xF) >> FP_SHIFT) & ~(TILE_SIZE_X - 1);	// start in block corner
+		const INT32 nMaxX = ((Max3(X1, X2, X3) + 0xF) >> FP_SHIFT);
+		const INT32 nMinY = ((Min3(Y1, Y2, Y3) + 0xF) >> FP_SHIFT) & ~(TILE_SIZE_Y - 1);	// start in block corner
+		const INT32 nMaxY = ((Max3(Y1, Y2, Y3) + 0xF) >> FP_SHIFT);
+#else
+		// adding (1 << FP_SHIFT) - 1 before shifting is the equivalent of a ceil() function
+		const INT32 FP_ROUND = (1 << FP_SHIFT) - 1;
+		const INT32 nMinX = Clamp( (Min3(X1, X2, X3) + FP_ROUND) >> FP_SHIFT, 0, W ) & ~(TILE_SIZE_X - 1);
+		const INT32 nMaxX = Clamp( (Max3(X1, X2, X3) + FP_ROUND) >> FP_SHIFT, 0, W );
+		const INT32 nMinY = Clamp( (Min3(Y1, Y2, Y3) + FP_ROUND) >> FP_SHIFT, 0, H ) & ~(TILE_SIZE_Y - 1);
+		const INT32 nMaxY = Clamp( (Max3(Y1, Y2, Y3) + FP_ROUND) >> FP_SHIFT, 0, H );
+#endif
+
+		Assert( nMinX % TILE_SIZE_X == 0 );
+		Assert( nMinY % TILE_SIZE_Y == 0 );
+
+		face.minX = nMinX;
+		face.maxX = nMaxX;
+		face.minY = nMinY;
+		face.maxY = nMaxY;
+	}//for each triangle
+}
+
+//-------------------------------------------------------------------
+//	SIMD
+//-------------------------------------------------------------------
+
+// vertices are converted from AoS into SoA layout with 4x4 (or 8x8) transposes
+mxSTATIC_ASSERT( sizeof XVertex == 8 * sizeof F4 );
+mxSTATIC_ASSERT( NUM_VARYINGS == 4 );
+
+// results of triangle setup in SoA layout, one lane per triangle;
+// they are copied into the face buffer, because the tile rasterizers read one triangle at a time
+mxALIGN_BY_CACHE_LINE struct srTriangleSetupSoA
+{
+	INT32	FPX[3][SETUP_BATCH_SIZE];
+	INT32	FPY[3][SETUP_BATCH_SIZE];
+	INT32	C[3][SETUP_BATCH_SIZE];
+
+	INT32	minX[SETUP_BATCH_SIZE];
+	INT32	maxX[SETUP_BATCH_SIZE];
+	INT32	minY[SETUP_BATCH_SIZE];
+	INT32	maxY[SETUP_BATCH_SIZE];
+
+	F4		vZ[2][SETUP_BATCH_SIZE];
+	F4		vInvW[2][SETUP_BATCH_SIZE];
+	F4		varsOverW[NUM_VARYINGS][2][SETUP_BATCH_SIZE];
+	F4		vars1OverW1[NUM_VARYINGS][SETUP_BATCH_SIZE];
+};
+
+// copies the setup results of the first numTriangles lanes into the face buffer
+static FORCEINLINE
+void StoreTriangleSetup( const srTriangleSetupSoA& setup, XTriangle* faces, UINT numTriangles )
+{
+	for( UINT iLane = 0; iLane < numTriangles; iLane++ )
+	{
+		XTriangle & face = faces[ iLane ];
+
+		for( UINT i = 0; i < 3; i++ )
+		{
+			face.FPX[i] = setup.FPX[i][iLane];
+			face.FPY[i] = setup.FPY[i][iLane];
+		}
+
+		face.C1 = setup.C[0][iLane];
+		face.C2 = setup.C[1][iLane];
+		face.C3 = setup.C[2][iLane];
+
+		face.minX = setup.minX[iLane];
+		face.maxX = setup.maxX[iLane];
+		face.minY = setup.minY[iLane];
+		face.maxY = setup.maxY[iLane];
+
+		face.vZ.x = setup.vZ[0][iLane];
+		face.vZ.y = setup.vZ[1][iLane];
+
+		face.vInvW.x = setup.vInvW[0][iLane];
+		face.vInvW.y = setup.vInvW[1][iLane];
+
+		for( UINT i = 0; i < NUM_VARYINGS; i++ )
+		{
+			face.vars1OverW1[i] = setup.vars1OverW1[i][iLane];
+			face.varsOverW[i].x = setup.varsOverW[i][0][iLane];
+			face.varsOverW[i].y = setup.varsOverW[i][1][iLane];
+		}
+	}
+}
+
+//-------------------------------------------------------------------
+//	SSE
+//-------------------------------------------------------------------
+
+// loads the given vertex of four triangles and converts it into SoA layout
+static FORCEINLINE
+void LoadTriangleVertices_SSE( const XTriangle* (&lanes)[SSE_REG_WIDTH], XVertex XTriangle::* vertex, XVertex4 & v )
+{
+	// position
+	__m128 r0 = _mm_load_ps( (const F4*) &(lanes[0]->*vertex) );
+	__m128 r1 = _mm_load_ps( (const F4*) &(lanes[1]->*vertex) );
+	__m128 r2 = _mm_load_ps( (const F4*) &(lanes[2]->*vertex) );
+	__m128 r3 = _mm_load_ps( (const F4*) &(lanes[3]->*vertex) );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	v.P[0] = r0;
+	v.P[1] = r1;
+	v.P[2] = r2;
+	v.P[3] = r3;
+
+	// varyings
+	r0 = _mm_load_ps( (const F4*) &(lanes[0]->*vertex) + 4 );
+	r1 = _mm_load_ps( (const F4*) &(lanes[1]->*vertex) + 4 );
+	r2 = _mm_load_ps( (const F4*) &(lanes[2]->*vertex) + 4 );
+	r3 = _mm_load_ps( (const F4*) &(lanes[3]->*vertex) + 4 );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	v.vars[0] = r0;
+	v.vars[1] = r1;
+	v.vars[2] = r2;
+	v.vars[3] = r3;
+}
+
+// returns all ones in lanes where the half-edge constant must be incremented (top-left fill convention)
+static FORCEINLINE
+__m128i TopLeftEdgeMask_SSE( const __m128i DeltaX, const __m128i DeltaY )
+{
+	const __m128i qiZero = _mm_setzero_si128();
+	return _mm_or_si128(
+		_mm_cmplt_epi32( DeltaY, qiZero ),
+		_mm_and_si128( _mm_cmpeq_epi32( DeltaY, qiZero ), _mm_cmpgt_epi32( DeltaX, qiZero ) )
+	);
+}
+
+// sets up four triangles and writes the results into the given lanes of the SoA buffer
+static FORCEINLINE
+void SetupTriangleLanes_SSE( const XTriangle* (&lanes)[SSE_REG_WIDTH], UINT iFirstLane, const SoftRenderContext& context, srTriangleSetupSoA & setup )
+{
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	XVertex4	v1, v2, v3;
+	LoadTriangleVertices_SSE( lanes, &XTriangle::v1, v1 );
+	LoadTriangleVertices_SSE( lanes, &XTriangle::v2, v2 );
+	LoadTriangleVertices_SSE( lanes, &XTriangle::v3, v3 );
+
+	const __m128 fX1 = v1.P[0];
+	const __m128 fX2 = v2.P[0];
+	const __m128 fX3 = v3.P[0];
+
+	const __m128 fY1 = v1.P[1];
+	const __m128 fY2 = v2.P[1];
+	const __m128 fY3 = v3.P[1];
+
+	// 28.4 fixed-point, rounded to nearest (like iround())
+	const __m128 qfScale = _mm_set1_ps( F4(1<<FP_SHIFT) );
+
+	const __m128i X1 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fX1 ) );
+	const __m128i X2 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fX2 ) );
+	const __m128i X3 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fX3 ) );
+
+	const __m128i Y1 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fY1 ) );
+	const __m128i Y2 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fY2 ) );
+	const __m128i Y3 = _mm_cvtps_epi32( _mm_mul_ps( qfScale, fY3 ) );
+
+	_mm_store_si128( (__m128i*) &setup.FPX[0][iFirstLane], X1 );
+	_mm_store_si128( (__m128i*) &setup.FPX[1][iFirstLane], X2 );
+	_mm_store_si128( (__m128i*) &setup.FPX[2][iFirstLane], X3 );
+
+	_mm_store_si128( (__m128i*) &setup.FPY[0][iFirstLane], Y1 );
+	_mm_store_si128( (__m128i*) &setup.FPY[1][iFirstLane], Y2 );
+	_mm_store_si128( (__m128i*) &setup.FPY[2][iFirstLane], Y3 );
+
+	// deltas
+	const __m128i DeltaX12 = _mm_sub_epi32( X1, X2 );
+	const __m128i DeltaX23 = _mm_sub_epi32( X2, X3 );
+	const __m128i DeltaX31 = _mm_sub_epi32( X3, X1 );
+
+	const __m128i DeltaY12 = _mm_sub_epi32( Y1, Y2 );
+	const __m128i DeltaY23 = _mm_sub_epi32( Y2, Y3 );
+	const __m128i DeltaY31 = _mm_sub_epi32( Y3, Y1 );
+
+	// half-edge constants in 28.4
+	__m128i C1 = _mm_sub_epi32( _mm_mullo_epi32( DeltaY12, X1 ), _mm_mullo_epi32( DeltaX12, Y1 ) );
+	__m128i C2 = _mm_sub_epi32( _mm_mullo_epi32( DeltaY23, X2 ), _mm_mullo_epi32( DeltaX23, Y2 ) );
+	__m128i C3 = _mm_sub_epi32( _mm_mullo_epi32( DeltaY31, X3 ), _mm_mullo_epi32( DeltaX31, Y3 ) );
+
+	// correct for top-left fill convention (subtracting -1 increments)
+	C1 = _mm_sub_epi32( C1, TopLeftEdgeMask_SSE( DeltaX12, DeltaY12 ) );
+	C2 = _mm_sub_epi32( C2, TopLeftEdgeMask_SSE( DeltaX23, DeltaY23 ) );
+	C3 = _mm_sub_epi32( C3, TopLeftEdgeMask_SSE( DeltaX31, DeltaY31 ) );
+
+	_mm_store_si128( (__m128i*) &setup.C[0][iFirstLane], C1 );
+	_mm_store_si128( (__m128i*) &setup.C[1][iFirstLane], C2 );
+	_mm_store_si128( (__m128i*) &setup.C[2][iFirstLane], C3 );
+
+	// bounding rectangle in screen space, clipped to the viewport; starts in tile corner
+	const __m128i qiRound = _mm_set1_epi32( (1 << FP_SHIFT) - 1 );	// ceil() before shifting
+	const __m128i qiShift = _mm_cvtsi32_si128( FP_SHIFT );
+	const __m128i qiZero = _mm_setzero_si128();
+	const __m128i qiW = _mm_set1_epi32( context.W );
+	const __m128i qiH = _mm_set1_epi32( context.H );
+
+	const __m128i qiMinX = _mm_min_epi32( X1, _mm_min_epi32( X2, X3 ) );
+	const __m128i qiMaxX = _mm_max_epi32( X1, _mm_max_epi32( X2, X3 ) );
+	const __m128i qiMinY = _mm_min_epi32( Y1, _mm_min_epi32( Y2, Y3 ) );
+	const __m128i qiMaxY = _mm_max_epi32( Y1, _mm_max_epi32( Y2, Y3 ) );
+
+	const __m128i nMinX = _mm_and_si128(
+		_mm_min_epi32( _mm_max_epi32( _mm_sra_epi32( _mm_add_epi32( qiMinX, qiRound ), qiShift ), qiZero ), qiW ),
+		_mm_set1_epi32( ~(TILE_SIZE_X - 1) )
+	);
+	const __m128i nMaxX = _mm_min_epi32( _mm_max_epi32( _mm_sra_epi32( _mm_add_epi32( qiMaxX, qiRound ), qiShift ), qiZero ), qiW );
+	const __m128i nMinY = _mm_and_si128(
+		_mm_min_epi32( _mm_max_epi32( _mm_sra_epi32( _mm_add_epi32( qiMinY, qiRound ), qiShift ), qiZero ), qiH ),
+		_mm_set1_epi32( ~(TILE_SIZE_Y - 1) )
+	);
+	const __m128i nMaxY = _mm_min_epi32( _mm_max_epi32( _mm_sra_epi32( _mm_add_epi32( qiMaxY, qiRound ), qiShift ), qiZero ), qiH );
+
+	_mm_store_si128( (__m128i*) &setup.minX[iFirstLane], nMinX );
+	_mm_store_si128( (__m128i*) &setup.maxX[iFirstLane], nMaxX );
+	_mm_store_si128( (__m128i*) &setup.minY[iFirstLane], nMinY );
+	_mm_store_si128( (__m128i*) &setup.maxY[iFirstLane], nMaxY );
+
+	// Compute interpolation data
+	const __m128 fDeltaX21 = _mm_sub_ps( fX2, fX1 );
+	const __m128 fDeltaX31 = _mm_sub_ps( fX3, fX1 );
+	const __m128 fDeltaY21 = _mm_sub_ps( fY2, fY1 );
+	const __m128 fDeltaY31 = _mm_sub_ps( fY3, fY1 );
+
+	const __m128 INTERP_C = _mm_sub_ps( _mm_mul_ps( fDeltaX21, fDeltaY31 ), _mm_mul_ps( fDeltaX31, fDeltaY21 ) );
+
+	__m128 dx, dy;
+
+	// gradient for interpolating depth (aka Z)
+	ComputeGradient_SSE(
+		INTERP_C,
+		_mm_sub_ps( v2.P[2], v1.P[2] ), _mm_sub_ps( v3.P[2], v1.P[2] ),
+		fDeltaX21, fDeltaX31,
+		fDeltaY21, fDeltaY31,
+		dx, dy
+		);
+	_mm_store_ps( &setup.vZ[0][iFirstLane], dx );
+	_mm_store_ps( &setup.vZ[1][iFirstLane], dy );
+
+	// NOTE: these are actually inverses of W (because of perspective division 1/w in ProjectVertex(), after vertex shader).
+	const __m128 fInvW1 = v1.P[3];
+	const __m128 fInvW2 = v2.P[3];
+	const __m128 fInvW3 = v3.P[3];
+
+	// inverse W (for perspective-correct interpolation of varyings)
+	ComputeGradient_SSE(
+		INTERP_C,
+		_mm_sub_ps( fInvW2, fInvW1 ), _mm_sub_ps( fInvW3, fInvW1 ),
+		fDeltaX21, fDeltaX31,
+		fDeltaY21, fDeltaY31,
+		dx, dy
+		);
+	_mm_store_ps( &setup.vInvW[0][iFirstLane], dx );
+	_mm_store_ps( &setup.vInvW[1][iFirstLane], dy );
+
+	// varyings multiplied by inverse W (they can be linearly interpolated in screen space)
+	for( UINT i = 0; i < NUM_VARYINGS; i++ )
+	{
+		const __m128 v1v = _mm_mul_ps( v1.vars[i], fInvW1 );
+		const __m128 v2v = _mm_mul_ps( v2.vars[i], fInvW2 );
+		const __m128 v3v = _mm_mul_ps( v3.vars[i], fInvW3 );
+
+		_mm_store_ps( &setup.vars1OverW1[i][iFirstLane], v1v );
+
+		ComputeGradient_SSE(
+			INTERP_C,
+			_mm_sub_ps( v2v, v1v ), _mm_sub_ps( v3v, v1v ),
+			fDeltaX21, fDeltaX31,
+			fDeltaY21, fDeltaY31,
+			dx, dy
+			);
+		_mm_store_ps( &setup.varsOverW[i][0][iFirstLane], dx );
+		_mm_store_ps( &setup.varsOverW[i][1][iFirstLane], dy );
+	}
+}
+
+// sets up triangles four at a time
+static
+void SetupTriangles_SSE( XTriangle* faces, UINT numTriangles, const SoftRenderContext& context )
+{
+	Assert( numTriangles > 0 && numTriangles <= SETUP_BATCH_SIZE );
+
+	srTriangleSetupSoA	setup;
+
+	for( UINT iFirstLane = 0; iFirstLane < numTriangles; iFirstLane += SSE_REG_WIDTH )
+	{
+		// unused lanes repeat the last triangle
+		const XTriangle* lanes[SSE_REG_WIDTH];
+		for( UINT i = 0; i < SSE_REG_WIDTH; i++ )
+		{
+			lanes[i] = &faces[ smallest( iFirstLane + i, numTriangles - 1 ) ];
+		}
+
+		SetupTriangleLanes_SSE( lanes, iFirstLane, context, setup );
+	}
+
+	StoreTriangleSetup( setup, faces, numTriangles );
+}
+
+//-------------------------------------------------------------------
+//	AVX
+//-------------------------------------------------------------------
+
+#if SOFT_RENDER_USE_AVX
+
+mxSTATIC_ASSERT( SETUP_BATCH_SIZE == AVX_REG_WIDTH );
+
+// loads the given vertex of eight triangles and converts it into SoA layout
+static FORCEINLINE
+void LoadTriangleVertices_AVX( const XTriangle* (&lanes)[AVX_REG_WIDTH], XVertex XTriangle::* vertex, XVertex8 & v )
+{
+	__m256	r[8];
+	for( UINT i = 0; i < AVX_REG_WIDTH; i++ )
+	{
+		r[i] = _mm256_loadu_ps( (const F4*) &(lanes[i]->*vertex) );
+	}
+
+	Transpose8x8_AVX( r );
+
+	v.P[0] = r[0];
+	v.P[1] = r[1];
+	v.P[2] = r[2];
+	v.P[3] = r[3];
+	v.vars[0] = r[4];
+	v.vars[1] = r[5];
+	v.vars[2] = r[6];
+	v.vars[3] = r[7];
+}
+
+// returns all ones in lanes where the half-edge constant must be incremented (top-left fill convention)
+static FORCEINLINE
+__m256i TopLeftEdgeMask_AVX2( const __m256i DeltaX, const __m256i DeltaY )
+{
+	const __m256i qiZero = _mm256_setzero_si256();
+	return _mm256_or_si256(
+		_mm256_cmpgt_epi32( qiZero, DeltaY ),
+		_mm256_and_si256( _mm256_cmpeq_epi32( DeltaY, qiZero ), _mm256_cmpgt_epi32( DeltaX, qiZero ) )
+	);
+}
+
+// sets up eight triangles at once
+static
+void SetupTriangles_AVX2( XTriangle* faces, UINT numTriangles, const SoftRenderContext& context )
+{
+	Assert( numTriangles > 0 && numTriangles <= SETUP_BATCH_SIZE );
+
+	const UINT FP_SHIFT = context.subPixelBits;	// sub-pixel precision
+
+	// unused lanes repeat the last triangle
+	const XTriangle* lanes[AVX_REG_WIDTH];
+	for( UINT i = 0; i < AVX_REG_WIDTH; i++ )
+	{
+		lanes[i] = &faces[ smallest( i, numTriangles - 1 ) ];
+	}
+
+	XVertex8	v1, v2, v3;
+	LoadTriangleVertices_AVX( lanes, &XTriangle::v1, v1 );
+	LoadTriangleVertices_AVX( lanes, &XTriangle::v2, v2 );
+	LoadTriangleVertices_AVX( lanes, &XTriangle::v3, v3 );
+
+	const __m256 fX1 = v1.P[0];
+	const __m256 fX2 = v2.P[0];
+	const __m256 fX3 = v3.P[0];
+
+	const __m256 fY1 = v1.P[1];
+	const __m256 fY2 = v2.P[1];
+	const __m256 fY3 = v3.P[1];
+
+	srTriangleSetupSoA	setup;
+
+	// 28.4 fixed-point, rounded to nearest (like iround())
+	const __m256 qfScale = _mm256_set1_ps( F4(1<<FP_SHIFT) );
+
+	const __m256i X1 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fX1 ) );
+	const __m256i X2 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fX2 ) );
+	const __m256i X3 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fX3 ) );
+
+	const __m256i Y1 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fY1 ) );
+	const __m256i Y2 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fY2 ) );
+	const __m256i Y3 = _mm256_cvtps_epi32( _mm256_mul_ps( qfScale, fY3 ) );
+
+	_mm256_store_si256( (__m256i*) setup.FPX[0], X1 );
+	_mm256_store_si256( (__m256i*) setup.FPX[1], X2 );
+	_mm256_store_si256( (__m256i*) setup.FPX[2], X3 );
+
+	_mm256_store_si256( (__m256i*) setup.FPY[0], Y1 );
+	_mm256_store_si256( (__m256i*) setup.FPY[1], Y2 );
+	_mm256_store_si256( (__m256i*) setup.FPY[2], Y3 );
+
+	// deltas
+	const __m256i DeltaX12 = _mm256_sub_epi32( X1, X2 );
+	const __m256i DeltaX23 = _mm256_sub_epi32( X2, X3 );
+	const __m256i DeltaX31 = _mm256_sub_epi32( X3, X1 );
+
+	const __m256i DeltaY12 = _mm256_sub_epi32( Y1, Y2 );
+	const __m256i DeltaY23 = _mm256_sub_epi32( Y2, Y3 );
+	const __m256i DeltaY31 = _mm256_sub_epi32( Y3, Y1 );
+
+	// half-edge constants in 28.4
+	__m256i C1 = _mm256_sub_epi32( _mm256_mullo_epi32( DeltaY12, X1 ), _mm256_mullo_epi32( DeltaX12, Y1 ) );
+	__m256i C2 = _mm256_sub_epi32( _mm256_mullo_epi32( DeltaY23, X2 ), _mm256_mullo_epi32( DeltaX23, Y2 ) );
+	__m256i C3 = _mm256_sub_epi32( _mm256_mullo_epi32( DeltaY31, X3 ), _mm256_mullo_epi32( DeltaX31, Y3 ) );
+
+	// correct for top-left fill convention (subtracting -1 increments)
+	C1 = _mm256_sub_epi32( C1, TopLeftEdgeMask_AVX2( DeltaX12, DeltaY12 ) );
+	C2 = _mm256_sub_epi32( C2, TopLeftEdgeMask_AVX2( DeltaX23, DeltaY23 ) );
+	C3 = _mm256_sub_epi32( C3, TopLeftEdgeMask_AVX2( DeltaX31, DeltaY31 ) );
+
+	_mm256_store_si256( (__m256i*) setup.C[0], C1 );
+	_mm256_store_si256( (__m256i*) setup.C[1], C2 );
+	_mm256_store_si256( (__m256i*) setup.C[2], C3 );
+
+	// bounding rectangle in screen space, clipped to the viewport; starts in tile corner
+	const __m256i qiRound = _mm256_set1_epi32( (1 << FP_SHIFT) - 1 );	// ceil() before shifting
+	const __m128i qiShift = _mm_cvtsi32_si128( FP_SHIFT );
+	const __m256i qiZero = _mm256_setzero_si256();
+	const __m256i qiW = _mm256_set1_epi32( context.W );
+	const __m256i qiH = _mm256_set1_epi32( context.H );
+
+	const __m256i qiMinX = _mm256_min_epi32( X1, _mm256_min_epi32( X2, X3 ) );
+	const __m256i qiMaxX = _mm256_max_epi32( X1, _mm256_max_epi32( X2, X3 ) );
+	const __m256i qiMinY = _mm256_min_epi32( Y1, _mm256_min_epi32( Y2, Y3 ) );
+	const __m256i qiMaxY = _mm256_max_epi32( Y1, _mm256_max_epi32( Y2, Y3 ) );
+
+	const __m256i nMinX = _mm256_and_si256(
+		_mm256_min_epi32( _mm256_max_epi32( _mm256_sra_epi32( _mm256_add_epi32( qiMinX, qiRound ), qiShift ), qiZero ), qiW ),
+		_mm256_set1_epi32( ~(TILE_SIZE_X - 1) )
+	);
+	const __m256i nMaxX = _mm256_min_epi32( _mm256_max_epi32( _mm256_sra_epi32( _mm256_add_epi32( qiMaxX, qiRound ), qiShift ), qiZero ), qiW );
+	const __m256i nMinY = _mm256_and_si256(
+		_mm256_min_epi32( _mm256_max_epi32( _mm256_sra_epi32( _mm256_add_epi32( qiMinY, qiRound ), qiShift ), qiZero ), qiH ),
+		_mm256_set1_epi32( ~(TILE_SIZE_Y - 1) )
+	);
+	const __m256i nMaxY = _mm256_min_epi32( _mm256_max_epi32( _mm256_sra_epi32( _mm256_add_epi32( qiMaxY, qiRound ), qiShift ), qiZero ), qiH );
+
+	_mm256_store_si256( (__m256i*) setup.minX, nMinX );
+	_mm256_store_si256( (__m256i*) setup.maxX, nMaxX );
+	_mm256_store_si256( (__m256i*) setup.minY, nMinY );
+	_mm256_store_si256( (__m256i*) setup.maxY, nMaxY );
+
+	// Compute interpolation data
+	const __m256 fDeltaX21 = _mm256_sub_ps( fX2, fX1 );
+	const __m256 fDeltaX31 = _mm256_sub_ps( fX3, fX1 );
+	const __m256 fDeltaY21 = _mm256_sub_ps( fY2, fY1 );
+	const __m256 fDeltaY31 = _mm256_sub_ps( fY3, fY1 );
+
+	const __m256 INTERP_C = _mm256_sub_ps( _mm256_mul_ps( fDeltaX21, fDeltaY31 ), _mm256_mul_ps( fDeltaX31, fDeltaY21 ) );
+
+	__m256 dx, dy;
+
+	// gradient for interpolating depth (aka Z)
+	ComputeGradient_AVX(
+		INTERP_C,
+		_mm256_sub_ps( v2.P[2], v1.P[2] ), _mm256_sub_ps( v3.P[2], v1.P[2] ),
+		fDeltaX21, fDeltaX31,
+		fDeltaY21, fDeltaY31,
+		dx, dy
+		);
+	_mm256_store_ps( setup.vZ[0], dx );
+	_mm256_store_ps( setup.vZ[1], dy );
+
+	// NOTE: these are actually inverses of W (because of perspective division 1/w in ProjectVertex(), after vertex shader).
+	const __m256 fInvW1 = v1.P[3];
+	const __m256 fInvW2 = v2.P[3];
+	const __m256 fInvW3 = v3.P[3];
+
+	// inverse W (for perspective-correct interpolation of varyings)
+	ComputeGradient_AVX(
+		INTERP_C,
+		_mm256_sub_ps( fInvW2, fInvW1 ), _mm256_sub_ps( fInvW3, fInvW1 ),
+		fDeltaX21, fDeltaX31,
+		fDeltaY21, fDeltaY31,
+		dx, dy
+		);
+	_mm256_store_ps( setup.vInvW[0], dx );
+	_mm256_store_ps( setup.vInvW[1], dy );
+
+	// varyings multiplied by inverse W (they can be linearly interpolated in screen space)
+	for( UINT i = 0; i < NUM_VARYINGS; i++ )
+	{
+		const __m256 v1v = _mm256_mul_ps( v1.vars[i], fInvW1 );
+		const __m256 v2v = _mm256_mul_ps( v2.vars[i], fInvW2 );
+		const __m256 v3v = _mm256_mul_ps( v3.vars[i], fInvW3 );
+
+		_mm256_store_ps( setup.vars1OverW1[i], v1v );
+
+		ComputeGradient_AVX(
+			INTERP_C,
+			_mm256_sub_ps( v2v, v1v ), _mm256_sub_ps( v3v, v1v ),
+			fDeltaX21, fDeltaX31,
+			fDeltaY21, fDeltaY31,
+			dx, dy
+			);
+		_mm256_store_ps( setup.varsOverW[i][0], dx );
+		_mm256_store_ps( setup.varsOverW[i][1], dy );
+	}
+
+	// avoid AVX-SSE transition penalties in the following code
+	_mm256_zeroupper();
+
+	StoreTriangleSetup( setup, faces, numTriangles );
+}
+
+#endif // SOFT_RENDER_USE_AVX
+
+}//namespace SoftRenderer
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -214,8 +214,15 @@ class MyApp : public AClientViewport
 
 	int		m_backFaceCulling;	// ECullMode
 	int		m_cpuMode;
+	bool	m_coverageMasks;
+	bool	m_nonTemporalStores;
+	bool	m_tiledFrameBuffer;
+	int		m_depthFormat;	// EDepthFormat
+	bool	m_depthCompression;
 
 	bool	m_solidFillMode;
+	bool	m_simdVertexShader;
+	bool	m_simdPixelShader;
 	bool	m_showStats;
 	bool	m_showHelp;
 
@@ -231,8 +238,15 @@ public:
 		m_angle = 0.0f;
 		m_animateScene = false;
 		m_backFaceCulling = Cull_CCW;
-		m_cpuMode = CpuMode_Use_SSE;
+		m_cpuMode = CpuMode_MAX;	// the best one supported by the CPU
+		m_coverageMasks = false;
+		m_nonTemporalStores = false;
+		m_tiledFrameBuffer = false;
+		m_depthFormat = DepthFormat_F32;
+		m_depthCompression = false;
 		m_solidFillMode = true;
+		m_simdVertexShader = true;
+		m_simdPixelShader = true;
 		m_showStats = true;
 		m_showHelp = true;
 		m_visibleModels = 0;
@@ -350,6 +364,14 @@ public:	//=-- AClientViewport
 		{
 			m_solidFillMode ^= 1;
 		}
+		if( key == EKeyCode::Key_X )
+		{
+			m_simdVertexShader ^= 1;
+		}
+		if( key == EKeyCode::Key_Z )
+		{
+			m_simdPixelShader ^= 1;
+		}
 		if( key == EKeyCode::Key_R )
 		{
 			this->ResetCamera();
@@ -378,10 +400,33 @@ public:	//=-- AClientViewport
 		if( key == EKeyCode::Key_U )
 		{
 			m_cpuMode++;
-			if( m_cpuMode >= CpuMode_MAX ) {
+			if( m_cpuMode > CpuMode_MAX ) {
 				m_cpuMode = CpuMode_Use_FPU;
 			}
 		}
+		if( key == EKeyCode::Key_M )
+		{
+			m_coverageMasks ^= 1;
+		}
+		if( key == EKeyCode::Key_N )
+		{
+			m_nonTemporalStores ^= 1;
+		}
+		if( key == EKeyCode::Key_L )
+		{
+			m_tiledFrameBuffer ^= 1;
+		}
+		if( key == EKeyCode::Key_O )
+		{
+			m_depthFormat++;
+			if( m_depthFormat >= DepthFormat_MAX ) {
+				m_depthFormat = DepthFormat_F32;
+			}
+		}
+		if( key == EKeyCode::Key_K )
+		{
+			m_depthCompression ^= 1;
+		}
 
 	}
 
@@ -412,6 +457,11 @@ public:	//=-- AClientViewport
 		{
 			SoftRenderer::Settings	settings;
 			settings.mode = (ECpuMode)m_cpuMode;
+			settings.bCoverageMasks = m_coverageMasks;
+			settings.bNonTemporalStores = m_nonTemporalStores;
+			settings.bTiledFrameBuffer = m_tiledFrameBuffer;
+			settings.depthFormat = (EDepthFormat)m_depthFormat;
+			settings.bDepthCompression = m_depthCompression;
 			SoftRenderer::ModifySettings(settings);
 		}
 
@@ -420,8 +470,18 @@ public:	//=-- AClientViewport
 
 		SoftRenderer::BeginFrame();
 		{
+			SoftRenderer::ClearColor( 0 );
+
 			SoftRenderer::SetVertexShader( &DefaultVertexShader );
+			SoftRenderer::SetVertexShader4( m_simdVertexShader ? &SoftRenderer::VertexShader4_WVP_TexCoords : nil );
+#if SOFT_RENDER_USE_AVX
+			SoftRenderer::SetVertexShader8( m_simdVertexShader ? &SoftRenderer::VertexShader8_WVP_TexCoords : nil );
+#endif // SOFT_RENDER_USE_AVX
 			SoftRenderer::SetPixelShader( &DefaultPixelShader );
+			SoftRenderer::SetPixelShader4( m_simdPixelShader ? &SoftRenderer::PixelShader4_Texture_Point : nil );
+#if SOFT_RENDER_USE_AVX
+			SoftRenderer::SetPixelShader8( m_simdPixelShader ? &SoftRenderer::PixelShader8_Texture_Point : nil );
+#endif // SOFT_RENDER_USE_AVX
 
 
 			SoftRenderer::SetFillMode( m_solidFillMode ? Fill_Solid : Fill_Wireframe );
@@ -531,6 +591,14 @@ public:	//=-- AClientViewport
 
 			mxSPRINTF_ANSI( text, "Indices: %u", SoftRenderer::stats.numIndices );
 			m_screen->DrawText(10,y+=15,text,FColor::BLUE.ToFloatPtr());
+
+			const UINT numVertexCacheLookups = SoftRenderer::stats.numVertexCacheHits + SoftRenderer::stats.numVertexCacheMisses;
+			const F4 vertexCacheHitRate = numVertexCacheLookups ? 100.0f * SoftRenderer::stats.numVertexCacheHits / numVertexCacheLookups : 0.0f;
+			mxSPRINTF_ANSI( text, "Vertex cache: %u hits, %u misses (%.1f%%)", SoftRenderer::stats.numVertexCacheHits, SoftRenderer::stats.numVertexCacheMisses, vertexCacheHitRate );
+			m_screen->DrawText(10,y+=15,text,FColor::BLUE.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "Tiles: %u (max. %u per batch, %u blocks, %u occluded), small triangles: %u", SoftRenderer::stats.numBinnedTiles, SoftRenderer::stats.maxBinnedTiles, SoftRenderer::stats.numTileBlocks, SoftRenderer::stats.numOccludedTiles, SoftRenderer::stats.numSmallTriangles );
+			m_screen->DrawText(10,y+=15,text,FColor::BLUE.ToFloatPtr());
 		}
 		if( m_showHelp && m_screen.IsValid() )
 		{
@@ -543,9 +611,30 @@ public:	//=-- AClientViewport
 			mxSPRINTF_ANSI( text, "V - polygon filling mode (%s)", (m_solidFillMode ? "Solid" : "Wireframe") );
 			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
 
+			mxSPRINTF_ANSI( text, "X - SIMD vertex shader (%s)", m_simdVertexShader ? "on" : "off" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "Z - SIMD pixel shader (%s)", m_simdPixelShader ? "on" : "off" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
 			mxSPRINTF_ANSI( text, "U - instruction set used (%s, real: %s)", ECpuMode_To_Chars((ECpuMode)m_cpuMode), ECpuMode_To_Chars(realSettings.mode) );
 			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
 
+			mxSPRINTF_ANSI( text, "M - coverage mask rasterizer (%s)", m_coverageMasks ? "on" : "off" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "N - non-temporal stores (%s)", m_nonTemporalStores ? "on" : "off" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "L - framebuffer layout (%s)", realSettings.bTiledFrameBuffer ? "tiled" : "linear" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "O - depth format (%s)", EDepthFormat_To_Chars(realSettings.depthFormat) );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
+			mxSPRINTF_ANSI( text, "K - depth compression (%s)", realSettings.bDepthCompression ? "on" : "off" );
+			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
+
 			mxSPRINTF_ANSI( text, "F1 - toggle help", fps );
 			m_screen->DrawText(10,y+=15,text,FColor::GREEN.ToFloatPtr());
 
@@ -632,7 +721,8 @@ int mxAppMain()
 
 		app.Tick( deltaSeconds );
 
-		screen.ClearWith(0);
+		// the screen is cleared by the renderer
+		//screen.ClearWith(0);
 		//screen.SetPixel(100,100,-1);
 
 		window.Draw();